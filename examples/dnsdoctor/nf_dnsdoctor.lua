@@ -7,6 +7,7 @@
 
 local nf = require("netfilter")
 local string = require("string")
+local inet = require("inet")
 local common = require("examples.dnsdoctor.common")
 local action = nf.action
 local family = nf.family
@@ -16,6 +17,10 @@ local pri = nf.ip_priority
 local udp = 0x11
 local eth_len = 14
 
+local target_dns = string.pack("s1s1", "lunatik", "com")
+local target_ip = inet.aton("10.1.2.3")
+local dst_ip = inet.aton("10.1.1.2")
+
 local function dnsdoctor_hook(skb)
 	local proto = skb:getuint8(eth_len + 9)
 	local ihl = skb:getuint8(eth_len) & 0x0F
@@ -26,15 +31,6 @@ local function dnsdoctor_hook(skb)
 		return action.ACCEPT
 	end
 
-	local target_dns = string.pack("s1s1", "lunatik", "com")
-	local dns_ip = "10.1.2.3"
-	local target_ip = 0
-	dns_ip:gsub("%d+", function(s) target_ip = target_ip * 256 + tonumber(s) end)
-
-	local dst = "10.1.1.2"
-	local dst_ip = 0
-	dst:gsub("%d+", function(s) dst_ip = dst_ip * 256 + tonumber(s) end)
-
 	return common.hook(skb, thoff, target_dns, target_ip, dst_ip, packet_dst)
 end
 
@@ -6,11 +6,12 @@
 local device = require("device")
 local socket = require("socket")
 local linux  = require("linux")
+local data   = require("data")
 
 local PACKET    = socket.af.PACKET
 local RAW       = socket.sock.RAW
 local ETH_P_ALL = 0x0003
-local MTU       = 1500
+local BLOCK     = 64 * 1024
 
 local function nop() end
 
@@ -20,10 +21,17 @@ local tap = {name = "tap", open = nop, release = nop, mode = s.IRUGO}
 local socket = socket.new(PACKET, RAW, ETH_P_ALL)
 socket:bind(string.pack(">I2", ETH_P_ALL))
 
+local block  = data.new(BLOCK)
+local frames = function () end
+
 function tap:read()
-	local frame = socket:receive(MTU)
-	local dst, src, ethtype = string.unpack(">I6I6I2", frame)
-	return string.format("%X\t%X\t%X\t%d\n", dst, src, ethtype, #frame)
+	local frame, len = frames()
+	if not frame then
+		frames = socket:frames(block)
+		frame, len = frames()
+	end
+	local dst, src, ethtype = string.unpack(">I6I6I2", frame:getstring(0, 14))
+	return string.format("%X\t%X\t%X\t%d\n", dst, src, ethtype, len)
 end
 
 device.new(tap)
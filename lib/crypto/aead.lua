@@ -10,7 +10,6 @@
 -- @module crypto.aead
 
 local new = require("crypto_aead").new
-local sub = string.sub
 
 --- Prototype for AEAD instances.
 -- Objects of this type are created by `AeadModule.new()`.
@@ -19,8 +18,10 @@ local AEAD = {}
 
 --- Closes the cipher instance and releases underlying C resources.
 -- If not called explicitly, this will be called by the garbage collector.
+-- Per-CPU transforms might be shared with other runtimes; thus, they are
+-- only released once the last reference to them is collected.
 function AEAD:close()
-	if self.tfm then self.tfm:__close() end
+	if self.tfm and not self.percpu then self.tfm:__close() end
 	self.tfm = nil -- Allow the C object to be garbage collected by Lua
 end
 
@@ -31,14 +32,16 @@ AEAD.__index = AEAD
 --- Creates a new AEAD cipher instance.
 -- @function new
 -- @tparam string algname The algorithm name, e.g., "gcm(aes)".
+-- @tparam[opt] boolean percpu If `true`, uses a transform per CPU, without locking
+--  (see `crypto_aead.new`); the key and tag size must be set before sharing it.
 -- @treturn Aead An AEAD instance.
 -- @raise Error if C object creation fails.
 -- @usage
 --  local aead = require("crypto.aead")
 --  local gcm_aes = aead.new("gcm(aes)")
 -- @within aead
-function AEAD.new(algname)
-	return setmetatable({tfm = new(algname)}, AEAD)
+function AEAD.new(algname, percpu)
+	return setmetatable({tfm = new(algname, percpu), percpu = percpu and true or false}, AEAD)
 end
 
 --- Sets the encryption key.
@@ -75,9 +78,8 @@ end
 -- @treturn number tag_length The length of the authentication tag in bytes (equal to `self:authsize()`).
 -- @raise Error if encryption fails in C.
 function AEAD:encrypt(nonce, plaintext, aad)
-	aad = aad or ""
-	-- The C function c_tfm:encrypt returns (aad || ciphertext || tag).
-	return sub(self.tfm:encrypt(nonce, aad .. plaintext, #aad), #aad + 1), self.tfm:authsize()
+	-- The C function c_tfm:seal returns (ciphertext || tag), taking AAD apart.
+	return self.tfm:seal(nonce, plaintext, aad), self.tfm:authsize()
 end
 
 --- Decrypts ciphertext.
@@ -87,9 +89,53 @@ end
 -- @treturn string plaintext The decrypted data on success.
 -- @raise Error if decryption fails in C (e.g., tag mismatch).
 function AEAD:decrypt(nonce, ciphertext_with_tag, aad)
-	aad = aad or ""
-	-- The C function c_tfm:decrypt returns (aad || plaintext)
-	return sub(self.tfm:decrypt(nonce, aad .. ciphertext_with_tag, #aad), #aad + 1)
+	return self.tfm:open(nonce, ciphertext_with_tag, aad)
+end
+
+--- Encrypts a range of a data object in place, without allocating memory.
+-- The range holds the AAD, the plaintext and room for the tag (AAD || Plaintext || Tag).
+-- @tparam data data The data object.
+-- @tparam number offset The start of the range.
+-- @tparam number length The length of the range.
+-- @tparam string nonce The unique nonce. Its length should match `self:ivsize()`.
+-- @tparam[opt=0] number aadlen The length of the AAD at the start of the range.
+-- @raise Error if encryption fails in C.
+function AEAD:encrypt_into(data, offset, length, nonce, aadlen)
+	return self.tfm:encrypt_into(data, offset, length, nonce, aadlen)
+end
+
+--- Decrypts a range of a data object in place, without allocating memory.
+-- The range holds the AAD, the ciphertext and the tag (AAD || Ciphertext || Tag).
+-- @tparam data data The data object.
+-- @tparam number offset The start of the range.
+-- @tparam number length The length of the range.
+-- @tparam string nonce The nonce used on encryption.
+-- @tparam[opt=0] number aadlen The length of the AAD at the start of the range.
+-- @raise Error if decryption fails in C (e.g., tag mismatch).
+function AEAD:decrypt_into(data, offset, length, nonce, aadlen)
+	return self.tfm:decrypt_into(data, offset, length, nonce, aadlen)
+end
+
+--- Encrypts many plaintexts at once, processed in parallel by asynchronous implementations.
+-- @tparam table nonces An array of unique nonces, one per plaintext.
+-- @tparam table plaintexts An array of plaintexts to encrypt.
+-- @tparam[opt] table aads An array with the Additional Authenticated Data of each plaintext.
+-- @treturn table An array with the ciphertext including the tag of each plaintext or,
+--   if its encryption has failed, its error code.
+-- @raise Error if the arrays are malformed or the allocation fails in C.
+function AEAD:seal_batch(nonces, plaintexts, aads)
+	return self.tfm:seal_batch(nonces, plaintexts, aads)
+end
+
+--- Decrypts many ciphertexts at once; a ciphertext that fails authentication doesn't affect the others.
+-- @tparam table nonces An array of nonces, one per ciphertext.
+-- @tparam table ciphertexts An array of ciphertexts including their tags.
+-- @tparam[opt] table aads An array with the Additional Authenticated Data of each ciphertext.
+-- @treturn table An array with the plaintext of each ciphertext or, if its decryption has
+--   failed, its error code (e.g., EBADMSG).
+-- @raise Error if the arrays are malformed or the allocation fails in C.
+function AEAD:open_batch(nonces, ciphertexts, aads)
+	return self.tfm:open_batch(nonces, ciphertexts, aads)
 end
 
 return AEAD
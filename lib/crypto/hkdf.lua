@@ -5,11 +5,11 @@
 
 --- HMAC-based Extract-and-Expand Key Derivation Function (HKDF) based on RFC 5869.
 -- This module provides functions to perform HKDF operations, utilizing the
--- underlying `crypto_shash` C module for HMAC calculations.
+-- underlying `crypto_hkdf` C module, which caches the keyed HMAC state and
+-- expands keys in C.
 -- @classmod crypto.hkdf
 
-local shash = require("crypto.shash")
-local char, rep, sub = string.char, string.rep, string.sub
+local new = require("crypto_hkdf").new
 
 --- HKDF operations.
 -- This table provides the `new` method to create HKDF instances and also
@@ -41,61 +41,46 @@ end
 -- @treturn HKDF An HKDF instance table with methods for key derivation.
 -- @usage local hkdf_sha256 = require("crypto.hkdf").new("sha256")
 function HKDF.new(alg)
-	local hmac = setmetatable({}, HKDF)
-	hmac.tfm = shash.new("hmac(" .. alg .. ")")
-	hmac.salt = rep("\0", #hmac)
-
-	return hmac
+	return setmetatable({tfm = new("hmac(" .. alg .. ")")}, HKDF)
 end
 
 --- Performs an HMAC calculation using the instance's algorithm.
+-- The keyed state is cached; thus, reusing the same key doesn't rekey the transform.
 -- @tparam string key The HMAC key.
--- @tparam string data The data to hash.
+-- @tparam string|data|table data The data to hash (see `crypto_hkdf` for data ranges).
 -- @treturn string The HMAC digest.
 function HKDF:hmac(key, data)
-	self.tfm:setkey(key)
-	return self.tfm:digest(data)
+	return self.tfm:extract(key, data)
 end
 
 --- Performs the HKDF Extract step.
 -- @function HKDF:extract
 -- @tparam[opt] string salt Optional salt value. If nil or not provided, a salt of `hash_len` zeros is used.
--- @tparam string ikm Input Keying Material.
+-- @tparam string|data|table ikm Input Keying Material.
 -- @treturn string The Pseudorandom Key (PRK).
 function HKDF:extract(salt, ikm)
-	return self:hmac((salt or self.salt), ikm)
+	return self.tfm:extract(salt, ikm)
 end
 
 --- Performs the HKDF Expand step.
 -- @function HKDF:expand
 -- @tparam string prk Pseudorandom Key.
--- @tparam[opt] string info Optional context and application-specific information. Defaults to an empty string if nil.
+-- @tparam[opt] string|data|table info Optional context and application-specific information. Defaults to an empty string if nil.
 -- @tparam number length The desired length in bytes for the Output Keying Material (OKM).
 -- @treturn string The Output Keying Material of the specified `length`.
 function HKDF:expand(prk, info, length)
-	info = info or ""
-	local hash_len = #self
-	local n = length / hash_len
-	n = (n * hash_len == length) and n or n + 1
-
-	local okm, t = "", ""
-	for i = 1, n do
-		t = self:hmac(prk, t .. info .. char(i))
-		okm = okm .. t
-	end
-	return sub(okm, 1, length)
+	return self.tfm:expand(prk, info, length)
 end
 
 --- Performs the full HKDF (Extract and Expand) operation.
 -- @function HKDF:hkdf
 -- @tparam[opt] string salt Optional salt value.
--- @tparam string ikm Input Keying Material.
--- @tparam[opt] string info Optional context and application-specific information.
+-- @tparam string|data|table ikm Input Keying Material.
+-- @tparam[opt] string|data|table info Optional context and application-specific information.
 -- @tparam number length The desired length in bytes for the Output Keying Material.
 -- @treturn string The Output Keying Material.
 function HKDF:hkdf(salt, ikm, info, length)
-	return self:expand(self:extract(salt, ikm), info, length)
+	return self.tfm:derive(salt, ikm, info, length)
 end
 
 return HKDF
-
@@ -12,6 +12,8 @@
 * execution of multiple threads. It allows threads to wait for a specific
 * event to occur before proceeding, ensuring certain tasks are complete.
 *
+* Completions can also be waited on along with other sources through `poll.wait`.
+*
 * @module completion
 */
 
@@ -20,6 +22,7 @@
 #include <linux/module.h>
 #include <linux/completion.h>
 #include <linux/sched.h>
+#include <linux/wait.h>
 
 #include <lua.h>
 #include <lualib.h>
@@ -27,7 +30,12 @@
 
 #include <lunatik.h>
 
-LUNATIK_OBJECTCHECKER(luacompletion_check, struct completion *);
+typedef struct luacompletion_s {
+	struct completion completion;
+	wait_queue_head_t poll;
+} luacompletion_t;
+
+LUNATIK_OBJECTCHECKER(luacompletion_check, luacompletion_t *);
 
 /***
 * Signals a completion.
@@ -42,9 +50,11 @@ LUNATIK_OBJECTCHECKER(luacompletion_check, struct completion *);
 */
 static int luacompletion_complete(lua_State *L)
 {
-	struct completion *completion = luacompletion_check(L, 1);
+	luacompletion_t *completion = luacompletion_check(L, 1);
 
-	complete(completion);
+	complete(&completion->completion);
+	if (wq_has_sleeper(&completion->poll))
+		wake_up(&completion->poll);
 	return 0;
 }
 
@@ -75,13 +85,13 @@ static int luacompletion_complete(lua_State *L)
 */
 static int luacompletion_wait(lua_State *L)
 {
-	struct completion *completion = luacompletion_check(L, 1);
+	luacompletion_t *completion = luacompletion_check(L, 1);
 	lua_Integer timeout = luaL_optinteger(L, 2, MAX_SCHEDULE_TIMEOUT);
 	unsigned long timeout_jiffies = msecs_to_jiffies((unsigned long)timeout);
 	long ret;
 
 	lunatik_checkruntime(L, true);
-	ret = wait_for_completion_interruptible_timeout(completion, timeout_jiffies);
+	ret = wait_for_completion_interruptible_timeout(&completion->completion, timeout_jiffies);
 	if (ret > 0) {
 		lua_pushboolean(L, true);
 		return 1;		
@@ -102,6 +112,24 @@ static int luacompletion_wait(lua_State *L)
 	return 2;
 }
 
+/***
+* Consumes a signal of a completion, if any, without blocking.
+* Corresponds to the kernel's `try_wait_for_completion()`; thus, it can be
+* called on non-sleepable runtimes.
+* @function trywait
+* @treturn boolean `true` if a signal was consumed; `false` if the completion wasn't signaled.
+* @usage
+*   while c:trywait() do end -- discards pending signals
+* @see wait
+*/
+static int luacompletion_trywait(lua_State *L)
+{
+	luacompletion_t *completion = luacompletion_check(L, 1);
+
+	lua_pushboolean(L, try_wait_for_completion(&completion->completion));
+	return 1;
+}
+
 static int luacompletion_new(lua_State *L);
 
 static const luaL_Reg luacompletion_lib[] = {
@@ -113,12 +141,22 @@ static const luaL_Reg luacompletion_mt[] = {
 	{"__gc", lunatik_deleteobject},
 	{"complete", luacompletion_complete},
 	{"wait", luacompletion_wait},
+	{"trywait", luacompletion_trywait},
 	{NULL, NULL}
 };
 
+static __poll_t luacompletion_poll(void *private, lunatik_poll_t *poll)
+{
+	luacompletion_t *completion = (luacompletion_t *)private;
+
+	poll_wait(NULL, &completion->poll, &poll->table);
+	return completion_done(&completion->completion) ? EPOLLIN | EPOLLRDNORM : 0;
+}
+
 static const lunatik_class_t luacompletion_class = {
 	.name = "completion",
 	.methods = luacompletion_mt,
+	.poll = luacompletion_poll,
 	.sleep = false,
 };
 
@@ -134,10 +172,11 @@ static const lunatik_class_t luacompletion_class = {
 */
 static int luacompletion_new(lua_State *L)
 {
-	lunatik_object_t *object = lunatik_newobject(L, &luacompletion_class, sizeof(struct completion));
-	struct completion *completion = (struct completion *)object->private;
+	lunatik_object_t *object = lunatik_newobject(L, &luacompletion_class, sizeof(luacompletion_t));
+	luacompletion_t *completion = (luacompletion_t *)object->private;
 
-	init_completion(completion);
+	init_completion(&completion->completion);
+	init_waitqueue_head(&completion->poll);
 	return 1;
 }
 
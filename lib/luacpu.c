@@ -8,6 +8,10 @@
 *
 * This module provides access to Linux's CPU abstractions.
 *
+* Besides `stats`, which returns a table per call, the counters of all CPUs
+* can be written into a data object by `snapshot` and compared by `delta`;
+* thus, utilization can be sampled at high frequency without allocations.
+*
 * @module cpu
 */
 
@@ -16,6 +20,7 @@
 #include <linux/version.h>
 #include <linux/cpumask.h>
 #include <linux/kernel_stat.h>
+#include <linux/tick.h>
 
 #include <lua.h>
 #include <lualib.h>
@@ -23,6 +28,8 @@
 
 #include <lunatik.h>
 
+#include "luadata.h"
+
 #define LUACPU_NUM(name)					\
 static int luacpu_num_##name(lua_State *L) {			\
 	lua_pushinteger(L, (lua_Integer)num_##name##_cpus());	\
@@ -111,6 +118,124 @@ static int luacpu_stats(lua_State *L)
 	return 1;
 }
 
+#define LUACPU_STATSIZE		(NR_STATS * sizeof(u64))
+#define luacpu_snapshotsize()	(nr_cpu_ids * LUACPU_STATSIZE)
+
+/* accounts idle and iowait as /proc/stat does, as NO_HZ doesn't update them on kcpustat while idle */
+static inline void luacpu_fetchstats(struct kernel_cpustat *kcs, unsigned int cpu)
+{
+	u64 idle = get_cpu_idle_time_us(cpu, NULL);
+	u64 iowait = get_cpu_iowait_time_us(cpu, NULL);
+
+	kcpustat_cpu_fetch(kcs, cpu);
+	if (idle != -1ULL)
+		kcs->cpustat[CPUTIME_IDLE] = idle * NSEC_PER_USEC;
+	if (iowait != -1ULL)
+		kcs->cpustat[CPUTIME_IOWAIT] = iowait * NSEC_PER_USEC;
+}
+
+static inline u64 *luacpu_checksnapshot(lua_State *L, int ix, bool writable)
+{
+	size_t size;
+	u64 *stats = (u64 *)luadata_checkptr(L, ix, &size, writable);
+
+	luaL_argcheck(L, size >= luacpu_snapshotsize(), ix, "snapshot too short");
+	return stats;
+}
+
+/***
+* Writes the statistics of all CPUs into a data object.
+* The data holds one record of `cpu.stat.size` bytes per CPU, indexed by the
+* CPU number (i.e., the record of CPU `n` starts at `n * cpu.stat.size`).
+* Each record holds the same counters returned by `stats`, as native 64-bit
+* integers, at the offsets given by `cpu.stat` (e.g., `cpu.stat.idle`).
+* As in `/proc/stat`, `idle` and `iowait` include the time CPUs spent
+* tickless (NO_HZ). Records of offline CPUs are zeroed.
+* @function snapshot
+* @tparam data data The data object to write into; it must hold at least
+*   `cpu.stat.snapshot` bytes.
+* @tparam[opt=0] integer offset The start of the range.
+* @tparam[opt] integer length The length of the range (defaults to the rest of the data).
+* @treturn integer The number of CPU records written.
+* @raise Error if the range is too short.
+* @usage
+*   local snap = data.new(cpu.stat.snapshot)
+*   cpu.snapshot(snap)
+*   local idle0 = snap:getnumber(cpu.stat.idle) -- CPU 0
+* @see delta
+*/
+static int luacpu_snapshot(lua_State *L)
+{
+	size_t len;
+	u8 *records = (u8 *)luadata_checkrange(L, 1, &len, true);
+	unsigned int cpu;
+
+	luaL_argcheck(L, len >= luacpu_snapshotsize(), 1, "snapshot too short");
+	for (cpu = 0; cpu < nr_cpu_ids; cpu++) {
+		u8 *record = records + cpu * LUACPU_STATSIZE;
+		struct kernel_cpustat kcs;
+
+		if (!cpu_online(cpu)) {
+			memset(record, 0, LUACPU_STATSIZE);
+			continue;
+		}
+		luacpu_fetchstats(&kcs, cpu);
+		memcpy(record, kcs.cpustat, LUACPU_STATSIZE);
+	}
+	lua_pushinteger(L, (lua_Integer)nr_cpu_ids);
+	return 1;
+}
+
+/***
+* Compares two snapshots.
+* It sums, over all CPUs, how much the counters increased from `previous` to
+* `current` and, optionally, stores the per-counter increments into `out`
+* (with the same layout as the snapshots). The total time excludes guest time,
+* which is already accounted as user time (as in `/proc/stat`).
+* Counters of CPUs that went offline are accounted as zero.
+* @function delta
+* @tparam data current The most recent snapshot.
+* @tparam data previous The older snapshot.
+* @tparam[opt] data out The data object to write the increments into.
+* @treturn integer The total time elapsed, summed over all CPUs.
+* @treturn integer The idle time (i.e., `idle` plus `iowait`), summed over all CPUs.
+* @raise Error if a snapshot is too short.
+* @usage
+*   cpu.snapshot(current)
+*   local total, idle = cpu.delta(current, previous)
+*   local busy = total > 0 and (total - idle) * 100 // total or 0
+*   current, previous = previous, current
+* @see snapshot
+*/
+static int luacpu_delta(lua_State *L)
+{
+	const u64 *current = luacpu_checksnapshot(L, 1, false);
+	const u64 *previous = luacpu_checksnapshot(L, 2, false);
+	u64 *out = lua_isnoneornil(L, 3) ? NULL : luacpu_checksnapshot(L, 3, true);
+	u64 total = 0, idle = 0;
+	size_t i, n = nr_cpu_ids * NR_STATS;
+
+	for (i = 0; i < n; i++) {
+		unsigned int stat = i % NR_STATS;
+		u64 delta = current[i] > previous[i] ? current[i] - previous[i] : 0;
+
+		if (out)
+			out[i] = delta;
+		if (stat == CPUTIME_GUEST || stat == CPUTIME_GUEST_NICE)
+			continue;
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(6, 0, 0)) && defined(CONFIG_SCHED_CORE)
+		if (stat == CPUTIME_FORCEIDLE)
+			continue;
+#endif
+		total += delta;
+		if (stat == CPUTIME_IDLE || stat == CPUTIME_IOWAIT)
+			idle += delta;
+	}
+	lua_pushinteger(L, (lua_Integer)total);
+	lua_pushinteger(L, (lua_Integer)idle);
+	return 2;
+}
+
 #define LUACPU_FOREACH(name)				\
 static int luacpu_foreach_##name(lua_State *L) {	\
 	unsigned int cpu;				\
@@ -164,16 +289,63 @@ static const luaL_Reg luacpu_lib[] = {
 	{"num_present", luacpu_num_present},
 	{"num_online", luacpu_num_online},
 	{"stats", luacpu_stats},
+	{"snapshot", luacpu_snapshot},
+	{"delta", luacpu_delta},
 	{"foreach_possible", luacpu_foreach_possible},
 	{"foreach_present", luacpu_foreach_present},
 	{"foreach_online", luacpu_foreach_online},
 	{NULL, NULL}
 };
 
-LUNATIK_NEWLIB(cpu, luacpu_lib, NULL, NULL);
+#define LUACPU_STAT(name, NAME)	{#name, CPUTIME_##NAME * sizeof(u64)}
+
+/***
+* Layout of the `snapshot` records.
+* Byte offsets of the counters within a CPU record and the record size.
+* @table stat
+*   @tfield integer user
+*   @tfield integer nice
+*   @tfield integer system
+*   @tfield integer idle
+*   @tfield integer iowait
+*   @tfield integer irq
+*   @tfield integer softirq
+*   @tfield integer steal
+*   @tfield integer guest
+*   @tfield integer guest_nice
+*   @tfield integer forceidle (if CONFIG_SCHED_CORE is enabled)
+*   @tfield integer size The size of a CPU record, in bytes.
+*   @tfield integer snapshot The size of a snapshot (i.e., a record per CPU id), in bytes.
+*/
+static lunatik_reg_t luacpu_stat[] = {
+	LUACPU_STAT(user, USER),
+	LUACPU_STAT(nice, NICE),
+	LUACPU_STAT(system, SYSTEM),
+	LUACPU_STAT(idle, IDLE),
+	LUACPU_STAT(iowait, IOWAIT),
+	LUACPU_STAT(irq, IRQ),
+	LUACPU_STAT(softirq, SOFTIRQ),
+	LUACPU_STAT(steal, STEAL),
+	LUACPU_STAT(guest, GUEST),
+	LUACPU_STAT(guest_nice, GUEST_NICE),
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(6, 0, 0)) && defined(CONFIG_SCHED_CORE)
+	LUACPU_STAT(forceidle, FORCEIDLE),
+#endif
+	{"size", LUACPU_STATSIZE},
+	{"snapshot", 0}, /* set on init, as nr_cpu_ids isn't a constant */
+	{NULL, 0}
+};
+
+static const lunatik_namespace_t luacpu_flags[] = {
+	{"stat", luacpu_stat},
+	{NULL, NULL}
+};
+
+LUNATIK_NEWLIB(cpu, luacpu_lib, NULL, luacpu_flags);
 
 static int __init luacpu_init(void)
 {
+	luacpu_stat[ARRAY_SIZE(luacpu_stat) - 2].value = (lua_Integer)luacpu_snapshotsize();
 	return 0;
 }
 
@@ -7,6 +7,13 @@
 #define _LUACRYPTO_H
 
 #include <linux/err.h>
+#include <linux/overflow.h>
+#include <linux/smp.h>
+#include <linux/atomic.h>
+#include <linux/mm.h>
+#include <linux/completion.h>
+#include <linux/crypto.h>
+#include <linux/version.h>
 #include <lua.h>
 #include <lauxlib.h>
 #include <lunatik.h>
@@ -71,20 +78,215 @@ static void luacrypto_##name##_release(void *private)				\
 	}									\
 }
 
+/*
+ * Per-CPU objects hold one transform per CPU, all set with the same key, and
+ * their methods run without the object lock; each call uses the transform of
+ * the CPU it's running on. Thus, a shared key object doesn't serialize its
+ * users. Keys (and other parameters) must be set before sharing the object.
+ */
+typedef struct luacrypto_percpu_s {
+	unsigned int ntfms;
+	void *tfms[];
+} luacrypto_percpu_t;
+
+/* returns all the transforms of the object at ix: one per CPU, for per-CPU objects, or the only one */
+static inline void **luacrypto_tfms(lua_State *L, int ix, const lunatik_class_t *percpu, unsigned int *n)
+{
+	lunatik_object_t *object = lunatik_toobject(L, ix);
+
+	lunatik_argchecknull(L, object->private, ix);
+	if (object->class == percpu) {
+		luacrypto_percpu_t *tfms = (luacrypto_percpu_t *)object->private;
+		*n = tfms->ntfms;
+		return tfms->tfms;
+	}
+	*n = 1;
+	return &object->private;
+}
+
+#define luacrypto_local(tfms, n)	((tfms)[raw_smp_processor_id() % (n)])
+
+/*
+ * returns the transform of the object at ix for exclusive use (e.g., of its preallocated request);
+ * it disables preemption on per-CPU objects, so one must neither sleep nor raise errors until
+ * calling luacrypto_put()
+ */
+static inline void *luacrypto_get(lua_State *L, int ix, const lunatik_class_t *percpu, bool *local)
+{
+	lunatik_object_t *object = lunatik_toobject(L, ix);
+
+	lunatik_argchecknull(L, object->private, ix);
+	if ((*local = object->class == percpu))
+		return ((luacrypto_percpu_t *)object->private)->tfms[get_cpu()];
+	return object->private; /* serialized by the object lock */
+}
+
+static inline void luacrypto_put(bool local)
+{
+	if (local)
+		put_cpu();
+}
+
 /**
- * LUACRYPTO_FREEREQUEST - Macro to define a common request freeing function.
- * @name: The base name of the crypto module (e.g., aead, skcipher).
- * @request_T: The C struct type of the request (e.g., struct aead_request, struct skcipher_request).
- * @request_free: The kernel crypto request freeing function (e.g., aead_request_free, skcipher_request_free).
+ * LUACRYPTO_CHECKER - Macro to define the checkers of crypto objects that might be per-CPU.
+ * @name: The base name of the crypto module (e.g., aead, skcipher, shash).
+ * @T: The C struct type of each transform (e.g., struct crypto_aead).
  *
- * This macro generates the `luacrypto_<_name>_freerequest` function, which handles
- * freeing the crypto request and the associated IV buffer.
+ * This macro generates `luacrypto_<name>_tfms`, which returns all transforms of
+ * an object, `luacrypto_<name>_check`, which returns the transform to be used
+ * on the current CPU, and `luacrypto_<name>_get`, which returns the transform
+ * for exclusive use (see luacrypto_get()). The per-CPU class must be named
+ * `luacrypto_<name>_percpu_class`.
  */
-#define LUACRYPTO_FREEREQUEST(name, request_T, request_free)			\
-static inline void luacrypto_##name##_freerequest(request_T *request, u8 *iv)	\
-{										\
-	request_free(request);							\
-	lunatik_free(iv);							\
+#define LUACRYPTO_CHECKER(name, T)								\
+static const lunatik_class_t luacrypto_##name##_percpu_class;					\
+static inline void **luacrypto_##name##_tfms(lua_State *L, int ix, unsigned int *n)		\
+{												\
+	return luacrypto_tfms(L, ix, &luacrypto_##name##_percpu_class, n);			\
+}												\
+static inline T *luacrypto_##name##_check(lua_State *L, int ix)					\
+{												\
+	unsigned int n;										\
+	void **tfms = luacrypto_##name##_tfms(L, ix, &n);					\
+	return (T *)luacrypto_local(tfms, n);							\
+}												\
+static inline T *luacrypto_##name##_get(lua_State *L, int ix, bool *local)			\
+{												\
+	return (T *)luacrypto_get(L, ix, &luacrypto_##name##_percpu_class, local);		\
+}
+
+/**
+ * LUACRYPTO_NEWPERCPU - Macro to define the constructor of per-CPU crypto objects.
+ * @name: The base name of the crypto module (e.g., aead, skcipher, shash).
+ * @T: The C struct type of the crypto transform (e.g., struct crypto_aead).
+ * @alloc: The kernel crypto allocation function (e.g., crypto_alloc_aead).
+ * @new: Optional extra allocation and assignment logic (e.g., for shash_desc).
+ *
+ * This macro generates the `luacrypto_<name>_newpercpu` function, which allocates
+ * one transform per possible CPU.
+ */
+#define LUACRYPTO_NEWPERCPU(name, T, alloc, new)							\
+static int luacrypto_##name##_newpercpu(lua_State *L)							\
+{													\
+	const char *algname = luaL_checkstring(L, 1);							\
+	const lunatik_class_t *class = &luacrypto_##name##_percpu_class;				\
+	luacrypto_percpu_t *percpu;									\
+	size_t size = struct_size(percpu, tfms, nr_cpu_ids);						\
+	lunatik_object_t *object;									\
+	unsigned int cpu;										\
+													\
+	lunatik_require(L, class->name); /* registers the class */					\
+	object = lunatik_newobject(L, class, 0);							\
+	percpu = (luacrypto_percpu_t *)lunatik_checkalloc(L, size);					\
+	memset(percpu, 0, size);									\
+	object->private = percpu;									\
+													\
+	for (cpu = 0; cpu < nr_cpu_ids; cpu++) {							\
+		luacrypto_new_t _new = (luacrypto_new_t)new;						\
+		T *tfm = alloc(algname, 0, CRYPTO_ALG_ASYNC); /* used without sleeping */		\
+		if (IS_ERR(tfm)) {									\
+			long err = PTR_ERR(tfm);							\
+			luaL_error(L, "Failed to allocate " #name " transform for %s (err %ld)", algname, err);	\
+		}											\
+		percpu->tfms[cpu] = _new ? _new(L, tfm) : tfm;						\
+		percpu->ntfms++;									\
+	}												\
+	return 1;											\
+}
+
+/**
+ * LUACRYPTO_PERCPU_RELEASER - Macro to define the release function of per-CPU crypto objects.
+ * @name: The base name of the crypto module (e.g., aead, skcipher, shash).
+ *
+ * This macro generates the `luacrypto_<name>_releasepercpu` function, which releases
+ * each transform through `luacrypto_<name>_release` (see LUACRYPTO_RELEASER).
+ */
+#define LUACRYPTO_PERCPU_RELEASER(name)					\
+static void luacrypto_##name##_releasepercpu(void *private)		\
+{									\
+	luacrypto_percpu_t *percpu = (luacrypto_percpu_t *)private;	\
+	unsigned int i;							\
+									\
+	if (percpu) {							\
+		for (i = 0; i < percpu->ntfms; i++)			\
+			luacrypto_##name##_release(percpu->tfms[i]);	\
+		kvfree(percpu); /* lunatik_malloc() might vmalloc */	\
+	}								\
+}
+
+/*
+ * Batches submit many requests, with completion callbacks, and wait for all of them at once;
+ * thus, asynchronous transforms (e.g., cryptd or hardware engines) can process them in parallel.
+ * The submitter must neither raise errors nor return while requests are in flight.
+ */
+#define LUACRYPTO_MAXBATCH	(1024)
+
+typedef struct luacrypto_batch_s {
+	atomic_t pending;
+	struct completion done;
+} luacrypto_batch_t;
+
+typedef struct luacrypto_batchentry_s {
+	luacrypto_batch_t *batch;
+	int err;
+} luacrypto_batchentry_t;
+
+static inline void luacrypto_batch_init(luacrypto_batch_t *batch)
+{
+	atomic_set(&batch->pending, 1); /* held by the submitter */
+	init_completion(&batch->done);
+}
+
+static inline void luacrypto_batch_done(luacrypto_batchentry_t *entry, int err)
+{
+	if (err == -EINPROGRESS) /* left the backlog; it will be called again */
+		return;
+	entry->err = err;
+	if (atomic_dec_and_test(&entry->batch->pending))
+		complete(&entry->batch->done);
+}
+
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(6, 3, 0))
+static inline void luacrypto_batch_callback(void *data, int err)
+{
+	luacrypto_batch_done((luacrypto_batchentry_t *)data, err);
+}
+#else
+static inline void luacrypto_batch_callback(struct crypto_async_request *request, int err)
+{
+	luacrypto_batch_done((luacrypto_batchentry_t *)request->data, err);
+}
+#endif
+
+static inline void luacrypto_batch_add(luacrypto_batch_t *batch, luacrypto_batchentry_t *entry)
+{
+	entry->batch = batch;
+	entry->err = 0;
+	atomic_inc(&batch->pending);
+}
+
+/* ret is the result of the submission; -EINPROGRESS and -EBUSY (backlogged) complete later */
+static inline void luacrypto_batch_submitted(luacrypto_batchentry_t *entry, int ret)
+{
+	if (ret != -EINPROGRESS && ret != -EBUSY)
+		luacrypto_batch_done(entry, ret);
+}
+
+static inline void luacrypto_batch_wait(luacrypto_batch_t *batch)
+{
+	if (!atomic_dec_and_test(&batch->pending))
+		wait_for_completion(&batch->done);
+}
+
+/* pushes the output of each entry, or its error code, into the table at the top of the stack */
+static inline void luacrypto_batch_pushresult(lua_State *L, lua_Integer i, luacrypto_batchentry_t *entry,
+	const char *out, size_t len)
+{
+	if (entry->err < 0)
+		lua_pushinteger(L, -entry->err);
+	else
+		lua_pushlstring(L, out, len);
+	lua_rawseti(L, -2, i);
 }
 
 #endif /* _LUACRYPTO_H */
@@ -0,0 +1,418 @@
+/*
+* SPDX-FileCopyrightText: (c) 2025 Ring Zero Desenvolvimento de Software LTDA
+* SPDX-License-Identifier: MIT OR GPL-2.0-only
+*/
+
+/***
+* Low-level Lua interface to the Linux Kernel Crypto API for asynchronous
+* compression algorithms (ACOMP), which also wraps synchronous ones (SCOMP).
+*
+* Unlike `crypto.comp`, it sizes outputs automatically, takes data ranges as
+* input, can write its output straight into data objects and compresses
+* streams chunk by chunk (see `update` and `finish`), thus memory usage is
+* bounded by the chunk size rather than by the stream length.
+*
+* Kernel compression requests are stateless; thus, a stream is a sequence of
+* independently compressed frames, each one formatted as
+* `compressed length (4 bytes, big endian) || original length (4 bytes, big endian) || compressed data`,
+* which can be decoded by `decompress` on each frame (e.g., using `string.unpack(">I4I4", frames, pos)`).
+*
+* @module crypto.acomp
+*/
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <crypto/acompress.h>
+#include <linux/err.h>
+#include <linux/scatterlist.h>
+#include <linux/slab.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/limits.h>
+#include <linux/version.h>
+
+#include <lua.h>
+#include <lualib.h>
+#include <lauxlib.h>
+#include <lunatik.h>
+
+#include "luacrypto.h"
+#include "luadata.h"
+
+#define LUACRYPTO_ACOMP_CHUNKSIZE	(64 * 1024)
+#define LUACRYPTO_ACOMP_MAXSIZE		(4 * 1024 * 1024) /* the output scratch is physically contiguous */
+#define LUACRYPTO_ACOMP_EINVALMAX	(1024 * 1024)
+#define LUACRYPTO_ACOMP_FRAMEHEADER	(8)
+
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(6, 15, 0))
+#define luacrypto_acomp_request_alloc(tfm)	acomp_request_alloc((tfm), GFP_KERNEL)
+#else
+#define luacrypto_acomp_request_alloc(tfm)	acomp_request_alloc(tfm)
+#endif
+
+typedef struct luacrypto_acomp_s {
+	struct acomp_req *request;
+	struct crypto_wait wait;
+	u8 *out; /* output scratch, grown on demand */
+	size_t outsize;
+	u8 *chunk; /* stream data not yet compressed */
+	size_t chunksize;
+	size_t chunklen;
+} luacrypto_acomp_t;
+
+typedef int (*luacrypto_acomp_op_t)(struct acomp_req *);
+
+LUNATIK_PRIVATECHECKER(luacrypto_acomp_check, luacrypto_acomp_t *);
+
+static inline void luacrypto_acomp_release_request(luacrypto_acomp_t *acomp)
+{
+	struct crypto_acomp *tfm = crypto_acomp_reqtfm(acomp->request);
+
+	acomp_request_free(acomp->request);
+	crypto_free_acomp(tfm);
+	kfree(acomp->out);
+	kfree(acomp->chunk);
+}
+
+LUACRYPTO_RELEASER(acomp, luacrypto_acomp_t, lunatik_free, luacrypto_acomp_release_request);
+
+/* a string or a data range (i.e., data [, offset [, length]]) */
+static inline const u8 *luacrypto_acomp_checkbuffer(lua_State *L, int ix, size_t *len)
+{
+	const u8 *buffer = lua_type(L, ix) == LUA_TUSERDATA ? (const u8 *)luadata_checkrange(L, ix, len, false) :
+		(const u8 *)luaL_checklstring(L, ix, len);
+	lunatik_checkbounds(L, ix, *len, 1, UINT_MAX);
+	return buffer;
+}
+
+typedef struct luacrypto_acomp_sg_s {
+	struct scatterlist one;
+	struct sg_table table; /* of vmalloc'ed buffers (e.g., large Lua strings), page by page */
+} luacrypto_acomp_sg_t;
+
+static struct scatterlist *luacrypto_acomp_initsg(luacrypto_acomp_sg_t *sg, const u8 *buffer, size_t len)
+{
+	size_t offset = offset_in_page(buffer);
+	unsigned int npages = DIV_ROUND_UP(offset + len, PAGE_SIZE);
+	struct scatterlist *s;
+	unsigned int i;
+
+	if (!is_vmalloc_addr(buffer)) {
+		sg_init_one(&sg->one, buffer, len);
+		return &sg->one;
+	}
+
+	if (sg_alloc_table(&sg->table, npages, GFP_KERNEL) != 0)
+		return NULL;
+
+	for_each_sg(sg->table.sgl, s, npages, i) {
+		size_t n = min_t(size_t, len, PAGE_SIZE - offset);
+
+		sg_set_page(s, vmalloc_to_page(buffer), n, offset);
+		buffer += n;
+		len -= n;
+		offset = 0;
+	}
+	return sg->table.sgl;
+}
+
+#define luacrypto_acomp_freesg(sg)	sg_free_table(&(sg)->table)
+
+static int luacrypto_acomp_run(luacrypto_acomp_t *acomp, luacrypto_acomp_op_t op, const u8 *src, size_t slen,
+	u8 *dst, size_t *dlen)
+{
+	luacrypto_acomp_sg_t sgsrc = {0}, sgdst = {0};
+	struct scatterlist *src_sg = luacrypto_acomp_initsg(&sgsrc, src, slen);
+	struct scatterlist *dst_sg = luacrypto_acomp_initsg(&sgdst, dst, *dlen);
+	int ret = -ENOMEM;
+
+	if (src_sg != NULL && dst_sg != NULL) {
+		acomp_request_set_params(acomp->request, src_sg, dst_sg, slen, *dlen);
+		if ((ret = crypto_wait_req(op(acomp->request), &acomp->wait)) == 0)
+			*dlen = acomp->request->dlen;
+	}
+	luacrypto_acomp_freesg(&sgsrc);
+	luacrypto_acomp_freesg(&sgdst);
+	return ret;
+}
+
+static void luacrypto_acomp_reserve(lua_State *L, luacrypto_acomp_t *acomp, size_t size)
+{
+	if (size > acomp->outsize) {
+		u8 *out = krealloc(acomp->out, size, GFP_KERNEL);
+		if (out == NULL)
+			luaL_error(L, "not enough memory");
+		acomp->out = out;
+		acomp->outsize = size;
+	}
+}
+
+/* whether the output might not have fit in size bytes */
+static inline bool luacrypto_acomp_overflow(int ret, size_t size)
+{
+	/* some algorithms (e.g., lz4) report any failure, including a short output, as -EINVAL */
+	return ret == -ENOSPC || ret == -EOVERFLOW || (ret == -EINVAL && size < LUACRYPTO_ACOMP_EINVALMAX);
+}
+
+/* runs op into the output scratch, growing it while the output doesn't fit */
+static size_t luacrypto_acomp_auto(lua_State *L, luacrypto_acomp_t *acomp, luacrypto_acomp_op_t op,
+	const u8 *src, size_t slen, size_t size)
+{
+	size_t dlen;
+	int ret;
+
+	for (;;) {
+		size = min_t(size_t, size, LUACRYPTO_ACOMP_MAXSIZE);
+		luacrypto_acomp_reserve(L, acomp, size);
+		dlen = acomp->outsize;
+		ret = luacrypto_acomp_run(acomp, op, src, slen, acomp->out, &dlen);
+		if (!luacrypto_acomp_overflow(ret, acomp->outsize) || acomp->outsize >= LUACRYPTO_ACOMP_MAXSIZE)
+			break;
+		size = acomp->outsize * 2;
+	}
+	if (ret < 0) { /* doesn't keep a scratch that might have grown in vain */
+		kfree(acomp->out);
+		acomp->out = NULL;
+		acomp->outsize = 0;
+		luaL_error(L, "crypto operation failed with error code %d", -ret);
+	}
+	return dlen;
+}
+
+#define luacrypto_acomp_compressbound(len)	((len) + ((len) >> 3) + 64)
+#define luacrypto_acomp_decompressbound(len)	((len) * 4)
+
+/***
+* ACOMP object methods.
+* These methods are available on ACOMP objects created by `crypto.acomp.new()`.
+* @see new
+* @type ACOMP
+*/
+
+#define LUACRYPTO_ACOMP_OPERATION(name)									\
+static int luacrypto_acomp_##name(lua_State *L) {							\
+	luacrypto_acomp_t *acomp = luacrypto_acomp_check(L, 1);						\
+	size_t slen;											\
+	const u8 *src = luacrypto_acomp_checkbuffer(L, 2, &slen);					\
+	size_t dlen = luacrypto_acomp_auto(L, acomp, crypto_acomp_##name, src, slen,			\
+		luacrypto_acomp_##name##bound(slen));							\
+													\
+	lua_pushlstring(L, (const char *)acomp->out, dlen);						\
+	return 1;											\
+}
+
+#define LUACRYPTO_ACOMP_OPERATIONINTO(name)								\
+static int luacrypto_acomp_##name##_into(lua_State *L) {						\
+	luacrypto_acomp_t *acomp = luacrypto_acomp_check(L, 1);						\
+	size_t slen, dlen;										\
+	u8 *dst = (u8 *)luadata_checkrange(L, 2, &dlen, true);						\
+	const u8 *src = luacrypto_acomp_checkbuffer(L, 5, &slen);					\
+													\
+	lunatik_try(L, luacrypto_acomp_run, acomp, crypto_acomp_##name, src, slen, dst, &dlen);	\
+	lua_pushinteger(L, (lua_Integer)dlen);								\
+	return 1;											\
+}
+
+/***
+* Compresses the given data.
+* The output is sized automatically.
+* @function compress
+* @tparam string|data data The data to compress.
+* @tparam[opt=0] integer offset If `data` is a data object, the start of the range to compress.
+* @tparam[opt] integer length If `data` is a data object, the length of the range
+*   (defaults to the rest of the data).
+* @treturn string The compressed data.
+* @raise Error on failure (e.g., allocation error, crypto API error) or if the input is empty.
+*/
+LUACRYPTO_ACOMP_OPERATION(compress);
+
+/***
+* Decompresses the given data.
+* The output is sized automatically, up to 4 MiB (or up to 1 MiB for algorithms
+* that report a short output as invalid input, e.g., lz4).
+* @function decompress
+* @tparam string|data data The data to decompress.
+* @tparam[opt=0] integer offset If `data` is a data object, the start of the range to decompress.
+* @tparam[opt] integer length If `data` is a data object, the length of the range
+*   (defaults to the rest of the data).
+* @treturn string The decompressed data.
+* @raise Error on failure (e.g., allocation error, crypto API error, input data corrupted).
+*/
+LUACRYPTO_ACOMP_OPERATION(decompress);
+
+/***
+* Compresses the given data into a data object.
+* @function compress_into
+* @tparam data output The data object to write into.
+* @tparam[opt=0] integer offset The start of the output range.
+* @tparam[opt] integer length The length of the output range (defaults to the rest of the output).
+* @tparam string|data data The data to compress, optionally followed by its offset and length
+*   (if it's a data object).
+* @treturn integer The number of bytes written.
+* @raise Error on failure or if the output range is too short.
+* @usage
+*   local n = compressor:compress_into(frame, 8, nil, log, 0, loglen)
+*/
+LUACRYPTO_ACOMP_OPERATIONINTO(compress);
+
+/***
+* Decompresses the given data into a data object.
+* @function decompress_into
+* @tparam data output The data object to write into.
+* @tparam[opt=0] integer offset The start of the output range.
+* @tparam[opt] integer length The length of the output range (defaults to the rest of the output).
+* @tparam string|data data The data to decompress, optionally followed by its offset and length
+*   (if it's a data object).
+* @treturn integer The number of bytes written.
+* @raise Error on failure or if the output range is too short.
+*/
+LUACRYPTO_ACOMP_OPERATIONINTO(decompress);
+
+static void luacrypto_acomp_addframe(lua_State *L, luaL_Buffer *B, luacrypto_acomp_t *acomp)
+{
+	size_t dlen = luacrypto_acomp_auto(L, acomp, crypto_acomp_compress, acomp->chunk, acomp->chunklen,
+		luacrypto_acomp_compressbound(acomp->chunklen));
+	__be32 header[2] = {cpu_to_be32((u32)dlen), cpu_to_be32((u32)acomp->chunklen)};
+
+	luaL_addlstring(B, (const char *)header, sizeof(header));
+	luaL_addlstring(B, (const char *)acomp->out, dlen);
+	acomp->chunklen = 0;
+}
+
+/***
+* Adds data to the stream.
+* Data is buffered until it fills a chunk, which is then compressed as a frame.
+* @function update
+* @tparam string|data data The data to add.
+* @tparam[opt=0] integer offset If `data` is a data object, the start of the range to add.
+* @tparam[opt] integer length If `data` is a data object, the length of the range
+*   (defaults to the rest of the data).
+* @treturn string The frames of the chunks filled by this call (possibly empty).
+* @raise Error on failure.
+* @usage
+*   sock:send(compressor:update(log, 0, loglen))
+*/
+static int luacrypto_acomp_update(lua_State *L) {
+	luacrypto_acomp_t *acomp = luacrypto_acomp_check(L, 1);
+	size_t len;
+	const u8 *data = luacrypto_acomp_checkbuffer(L, 2, &len);
+	luaL_Buffer B;
+
+	luaL_buffinit(L, &B);
+	while (len > 0) {
+		size_t n = min_t(size_t, len, acomp->chunksize - acomp->chunklen);
+
+		memcpy(acomp->chunk + acomp->chunklen, data, n);
+		acomp->chunklen += n;
+		data += n;
+		len -= n;
+		if (acomp->chunklen == acomp->chunksize)
+			luacrypto_acomp_addframe(L, &B, acomp);
+	}
+	luaL_pushresult(&B);
+	return 1;
+}
+
+/***
+* Finishes the stream.
+* It compresses the data buffered since the last frame, if any, and resets the stream.
+* @function finish
+* @treturn string The last frame (possibly empty).
+* @raise Error on failure.
+*/
+static int luacrypto_acomp_finish(lua_State *L) {
+	luacrypto_acomp_t *acomp = luacrypto_acomp_check(L, 1);
+	luaL_Buffer B;
+
+	luaL_buffinit(L, &B);
+	if (acomp->chunklen > 0)
+		luacrypto_acomp_addframe(L, &B, acomp);
+	luaL_pushresult(&B);
+	return 1;
+}
+
+static const luaL_Reg luacrypto_acomp_mt[] = {
+	{"compress", luacrypto_acomp_compress},
+	{"decompress", luacrypto_acomp_decompress},
+	{"compress_into", luacrypto_acomp_compress_into},
+	{"decompress_into", luacrypto_acomp_decompress_into},
+	{"update", luacrypto_acomp_update},
+	{"finish", luacrypto_acomp_finish},
+	{"__gc", lunatik_deleteobject},
+	{"__close", lunatik_closeobject},
+	{"__index", lunatik_monitorobject},
+	{NULL, NULL}
+};
+
+static const lunatik_class_t luacrypto_acomp_class = {
+	.name = "crypto_acomp",
+	.methods = luacrypto_acomp_mt,
+	.release = luacrypto_acomp_release,
+	.sleep = true,
+	.pointer = true,
+};
+
+/***
+* Creates a new ACOMP transform (TFM) object.
+* This is the constructor function for the `crypto.acomp` module.
+* @function new
+* @tparam string algname The name of the compression algorithm (e.g., "lz4", "deflate").
+* @tparam[opt=65536] integer chunksize The size of the chunks compressed by `update`.
+* @treturn acomp The new ACOMP TFM object.
+* @raise Error if the TFM object cannot be allocated/initialized.
+* @usage
+*   local acomp = require("crypto.acomp")
+*   local compressor = acomp.new("lz4")
+* @within acomp
+*/
+static luacrypto_acomp_t *luacrypto_acomp_new_request(lua_State *L, struct crypto_acomp *tfm)
+{
+	lua_Integer chunksize = luaL_optinteger(L, 2, LUACRYPTO_ACOMP_CHUNKSIZE);
+	luacrypto_acomp_t *acomp;
+
+	if (chunksize < 1 || chunksize > LUACRYPTO_ACOMP_MAXSIZE / 2) {
+		crypto_free_acomp(tfm);
+		luaL_argerror(L, 2, "out of bounds");
+	}
+
+	acomp = kzalloc(sizeof(luacrypto_acomp_t), GFP_KERNEL);
+	if (acomp == NULL || (acomp->chunk = kmalloc(chunksize, GFP_KERNEL)) == NULL ||
+	    (acomp->request = luacrypto_acomp_request_alloc(tfm)) == NULL) {
+		if (acomp != NULL)
+			kfree(acomp->chunk);
+		kfree(acomp);
+		crypto_free_acomp(tfm);
+		luaL_error(L, "not enough memory");
+	}
+	acomp->chunksize = (size_t)chunksize;
+	crypto_init_wait(&acomp->wait);
+	acomp_request_set_callback(acomp->request, CRYPTO_TFM_REQ_MAY_BACKLOG, crypto_req_done, &acomp->wait);
+	return acomp;
+}
+
+LUACRYPTO_NEW(acomp, struct crypto_acomp, crypto_alloc_acomp, luacrypto_acomp_class, luacrypto_acomp_new_request);
+
+static const luaL_Reg luacrypto_acomp_lib[] = {
+	{"new", luacrypto_acomp_new},
+	{NULL, NULL}
+};
+
+LUNATIK_NEWLIB(crypto_acomp, luacrypto_acomp_lib, &luacrypto_acomp_class, NULL);
+
+static int __init luacrypto_acomp_init(void)
+{
+	return 0;
+}
+
+static void __exit luacrypto_acomp_exit(void)
+{
+}
+
+module_init(luacrypto_acomp_init);
+module_exit(luacrypto_acomp_exit);
+MODULE_LICENSE("Dual MIT/GPL");
+MODULE_AUTHOR("Lourival Vieira Neto <lourival.neto@ring-0.io>");
+MODULE_DESCRIPTION("Lunatik low-level Linux Crypto API interface (ACOMP)");
+
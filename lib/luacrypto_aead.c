@@ -21,6 +21,7 @@
 #include <linux/err.h>
 #include <linux/scatterlist.h>
 #include <linux/slab.h>
+#include <linux/overflow.h>
 
 #include <lua.h>
 #include <lualib.h>
@@ -28,10 +29,29 @@
 #include <lunatik.h>
 
 #include "luacrypto.h"
+#include "luadata.h"
 
-LUNATIK_PRIVATECHECKER(luacrypto_aead_check, struct crypto_aead *);
+/* each transform has a preallocated request, used under the object lock (or on its own CPU) */
+typedef struct luacrypto_aead_s {
+	struct aead_request *request;
+	struct crypto_wait wait;
+	u8 iv[];
+} luacrypto_aead_t;
 
-LUACRYPTO_RELEASER(aead, struct crypto_aead, crypto_free_aead, NULL);
+#define luacrypto_aead_tfm(aead)	crypto_aead_reqtfm((aead)->request)
+
+LUACRYPTO_CHECKER(aead, luacrypto_aead_t);
+
+static inline void luacrypto_aead_release_request(luacrypto_aead_t *aead)
+{
+	struct crypto_aead *tfm = luacrypto_aead_tfm(aead);
+
+	aead_request_free(aead->request);
+	crypto_free_aead(tfm);
+}
+
+LUACRYPTO_RELEASER(aead, luacrypto_aead_t, lunatik_free, luacrypto_aead_release_request);
+LUACRYPTO_PERCPU_RELEASER(aead);
 
 /***
 * AEAD object methods.
@@ -47,10 +67,12 @@ LUACRYPTO_RELEASER(aead, struct crypto_aead, crypto_free_aead, NULL);
 * @raise Error if setting the key fails (e.g., invalid key length for the algorithm).
 */
 static int luacrypto_aead_setkey(lua_State *L) {
-	struct crypto_aead *tfm = luacrypto_aead_check(L, 1);
+	unsigned int i, n;
+	void **tfms = luacrypto_aead_tfms(L, 1, &n);
 	size_t keylen;
 	const char *key = luaL_checklstring(L, 2, &keylen);
-	lunatik_try(L, crypto_aead_setkey, tfm, key, keylen);
+	for (i = 0; i < n; i++)
+		lunatik_try(L, crypto_aead_setkey, luacrypto_aead_tfm((luacrypto_aead_t *)tfms[i]), key, keylen);
 	return 0;
 }
 
@@ -61,9 +83,11 @@ static int luacrypto_aead_setkey(lua_State *L) {
 * @raise Error if setting the authsize fails (e.g., unsupported size).
 */
 static int luacrypto_aead_setauthsize(lua_State *L) {
-	struct crypto_aead *tfm = luacrypto_aead_check(L, 1);
+	unsigned int i, n;
+	void **tfms = luacrypto_aead_tfms(L, 1, &n);
 	unsigned int tagsize = lunatik_checkuint(L, 2);
-	lunatik_try(L, crypto_aead_setauthsize, tfm, tagsize);
+	for (i = 0; i < n; i++)
+		lunatik_try(L, crypto_aead_setauthsize, luacrypto_aead_tfm((luacrypto_aead_t *)tfms[i]), tagsize);
 	return 0;
 }
 
@@ -73,7 +97,7 @@ static int luacrypto_aead_setauthsize(lua_State *L) {
 * @treturn integer The IV size in bytes.
 */
 static int luacrypto_aead_ivsize(lua_State *L) {
-	struct crypto_aead *tfm = luacrypto_aead_check(L, 1);
+	struct crypto_aead *tfm = luacrypto_aead_tfm(luacrypto_aead_check(L, 1));
 	lua_pushinteger(L, crypto_aead_ivsize(tfm));
 	return 1;
 }
@@ -85,51 +109,35 @@ static int luacrypto_aead_ivsize(lua_State *L) {
 * @treturn integer The authentication tag size in bytes.
 */
 static int luacrypto_aead_authsize(lua_State *L) {
-	struct crypto_aead *tfm = luacrypto_aead_check(L, 1);
+	struct crypto_aead *tfm = luacrypto_aead_tfm(luacrypto_aead_check(L, 1));
 	lua_pushinteger(L, crypto_aead_authsize(tfm));
 	return 1;
 }
 
-static inline struct aead_request *luacrypto_aead_newrequest(lua_State *L, const char **combined, u8 **iv,
-	size_t *combined_len, size_t *aad_len, size_t *crypt_len, unsigned int *authsize)
+static inline int luacrypto_aead_run(lua_State *L, int ix, int (*op)(struct aead_request *), const char *iv,
+	struct scatterlist *src, struct scatterlist *dst, size_t aad_len, size_t crypt_len)
 {
-	struct crypto_aead *tfm = luacrypto_aead_check(L, 1);
-
-	size_t iv_len;
-	const char *l_iv = luaL_checklstring(L, 2, &iv_len);
-	luaL_argcheck(L, iv_len == crypto_aead_ivsize(tfm), 2, "incorrect IV length");
-
-	*combined = luaL_checklstring(L, 3, combined_len);
-
-	*aad_len = (size_t)luaL_checkinteger(L, 4);
-	lunatik_checkbounds(L, 4, *aad_len, 0, *combined_len);
-
-	*crypt_len = *combined_len - *aad_len;
+	bool local;
+	luacrypto_aead_t *aead = luacrypto_aead_get(L, ix, &local);
+	struct aead_request *request = aead->request;
+	int ret;
 
-	gfp_t gfp = lunatik_gfp(lunatik_toruntime(L));
-	struct aead_request *request = lunatik_checknull(L, aead_request_alloc(tfm, gfp));
-	*iv = (u8 *)lunatik_checkalloc(L, iv_len);
-	memcpy(*iv, l_iv, iv_len);
-	*authsize = crypto_aead_authsize(tfm);
-
-	return request;
+	memcpy(aead->iv, iv, crypto_aead_ivsize(luacrypto_aead_tfm(aead)));
+	aead_request_set_ad(request, aad_len);
+	aead_request_set_crypt(request, src, dst, crypt_len, aead->iv);
+	ret = local ? op(request) : crypto_wait_req(op(request), &aead->wait); /* per-CPU transforms are synchronous */
+	luacrypto_put(local);
+	return ret;
 }
 
-static inline void luacrypto_aead_setrequest(lua_State *L, struct aead_request *request, const char *combined, u8 *iv,
-	size_t combined_len, size_t aad_len, size_t crypt_len, char *buffer, size_t buffer_len)
+static inline const char *luacrypto_aead_checkiv(lua_State *L, int ix, struct crypto_aead *tfm)
 {
-	memcpy(buffer, combined, combined_len);
-
-	struct scatterlist sg_work;
-	sg_init_one(&sg_work, buffer, buffer_len);
-
-	aead_request_set_ad(request, aad_len);
-	aead_request_set_crypt(request, &sg_work, &sg_work, crypt_len, iv);
-	aead_request_set_callback(request, 0, NULL, NULL);
+	size_t iv_len;
+	const char *iv = luaL_checklstring(L, ix, &iv_len);
+	luaL_argcheck(L, iv_len == crypto_aead_ivsize(tfm), ix, "incorrect IV length");
+	return iv;
 }
 
-LUACRYPTO_FREEREQUEST(aead, struct aead_request, aead_request_free);
-
 #define LUACRYPTO_AEAD_CHECK_ENCRYPT(L, ix, crypt_len, authsize)
 #define LUACRYPTO_AEAD_CHECK_DECRYPT(L, ix, crypt_len, authsize)	\
 	luaL_argcheck(L, crypt_len >= authsize, ix, "input data (ciphertext+tag) too short for tag")
@@ -137,28 +145,57 @@ LUACRYPTO_FREEREQUEST(aead, struct aead_request, aead_request_free);
 #define LUACRYPTO_AEAD_LEN_ENCRYPT(combined_len, authsize)	(combined_len + authsize)
 #define LUACRYPTO_AEAD_LEN_DECRYPT(combined_len, authsize)	(combined_len)
 
-#define LUACRYPTO_AEAD_NEWCRYPT(name, NAME, res_factor)									\
-static int luacrypto_aead_##name(lua_State *L) {									\
-	const char *combined;												\
-	u8 *iv;														\
-	unsigned int authsize;												\
-	size_t combined_len, aad_len, crypt_len;									\
-	struct aead_request *request = luacrypto_aead_newrequest(L, &combined, &iv, &combined_len,			\
-		&aad_len, &crypt_len, &authsize); 									\
-															\
-	LUACRYPTO_AEAD_CHECK_##NAME(L, 3, crypt_len, authsize);								\
-	size_t buffer_len = LUACRYPTO_AEAD_LEN_##NAME(combined_len, authsize);						\
-															\
-	luaL_Buffer B;													\
-	char *buffer = luaL_buffinitsize(L, &B, buffer_len);								\
-	luacrypto_aead_setrequest(L, request, combined, iv, combined_len, aad_len, crypt_len, buffer, buffer_len);	\
-	int ret = crypto_aead_##name(request);										\
-	luacrypto_aead_freerequest(request, iv);									\
-	if (ret < 0)													\
-		luaL_error(L, "crypto operation failed with error code %d", -ret);					\
-															\
-	luaL_pushresultsize(&B, combined_len + res_factor * (int)authsize);						\
-	return 1;													\
+#define LUACRYPTO_AEAD_CRYPTLEN_ENCRYPT(len, authsize)		(len - authsize)
+#define LUACRYPTO_AEAD_CRYPTLEN_DECRYPT(len, authsize)		(len)
+
+#define LUACRYPTO_AEAD_NEWCRYPT(name, NAME, res_factor)								\
+static int luacrypto_aead_##name(lua_State *L) {								\
+	struct crypto_aead *tfm = luacrypto_aead_tfm(luacrypto_aead_check(L, 1));				\
+	const char *iv = luacrypto_aead_checkiv(L, 2, tfm);							\
+	size_t combined_len;											\
+	const char *combined = luaL_checklstring(L, 3, &combined_len);						\
+	size_t aad_len = (size_t)luaL_checkinteger(L, 4);							\
+	lunatik_checkbounds(L, 4, aad_len, 0, combined_len);							\
+	size_t crypt_len = combined_len - aad_len;								\
+	unsigned int authsize = crypto_aead_authsize(tfm);							\
+														\
+	LUACRYPTO_AEAD_CHECK_##NAME(L, 3, crypt_len, authsize);							\
+	size_t buffer_len = LUACRYPTO_AEAD_LEN_##NAME(combined_len, authsize);					\
+														\
+	luaL_Buffer B;												\
+	char *buffer = luaL_buffinitsize(L, &B, buffer_len);							\
+	memcpy(buffer, combined, combined_len);									\
+														\
+	struct scatterlist sg;											\
+	sg_init_one(&sg, buffer, buffer_len);									\
+	int ret = luacrypto_aead_run(L, 1, crypto_aead_##name, iv, &sg, &sg, aad_len, crypt_len);			\
+	if (ret < 0)												\
+		luaL_error(L, "crypto operation failed with error code %d", -ret);				\
+														\
+	luaL_pushresultsize(&B, combined_len + res_factor * (int)authsize);					\
+	return 1;												\
+}
+
+#define LUACRYPTO_AEAD_NEWCRYPTINTO(name, NAME)									\
+static int luacrypto_aead_##name##_into(lua_State *L) {							\
+	struct crypto_aead *tfm = luacrypto_aead_tfm(luacrypto_aead_check(L, 1));				\
+	size_t len;												\
+	char *buffer = (char *)luadata_checkrange(L, 2, &len, true);						\
+	const char *iv = luacrypto_aead_checkiv(L, 5, tfm);							\
+	lua_Integer aad = luaL_optinteger(L, 6, 0);								\
+	unsigned int authsize = crypto_aead_authsize(tfm);							\
+														\
+	luaL_argcheck(L, len >= authsize, 4, "too short for tag");						\
+	lunatik_checkbounds(L, 6, aad, 0, (lua_Integer)(len - authsize));					\
+	size_t aad_len = (size_t)aad;										\
+	size_t crypt_len = LUACRYPTO_AEAD_CRYPTLEN_##NAME(len - aad_len, authsize);				\
+														\
+	struct scatterlist sg;											\
+	sg_init_one(&sg, buffer, len);										\
+	int ret = luacrypto_aead_run(L, 1, crypto_aead_##name, iv, &sg, &sg, aad_len, crypt_len);			\
+	if (ret < 0)												\
+		luaL_error(L, "crypto operation failed with error code %d", -ret);				\
+	return 0;												\
 }
 
 /***
@@ -169,7 +206,7 @@ static int luacrypto_aead_##name(lua_State *L) {									\
 * @tparam string combined_data A string containing AAD (Additional Authenticated Data) concatenated with the plaintext (format: AAD || Plaintext).
 * @tparam integer aad_len The length of the AAD part in `combined_data`.
 * @treturn string The encrypted data, formatted as (AAD || Ciphertext || Tag).
-* @raise Error on encryption failure, incorrect IV length, or allocation issues.
+* @raise Error on encryption failure or incorrect IV length.
 */
 LUACRYPTO_AEAD_NEWCRYPT(encrypt, ENCRYPT, 1);
 
@@ -181,10 +218,251 @@ LUACRYPTO_AEAD_NEWCRYPT(encrypt, ENCRYPT, 1);
 * @tparam string combined_data A string containing AAD (Additional Authenticated Data) concatenated with the ciphertext and tag (format: AAD || Ciphertext || Tag).
 * @tparam integer aad_len The length of the AAD part in `combined_data`.
 * @treturn string The decrypted data, formatted as (AAD || Plaintext).
-* @raise Error on decryption failure (e.g., authentication error - EBADMSG), incorrect IV length, input data too short, or allocation issues.
+* @raise Error on decryption failure (e.g., authentication error - EBADMSG), incorrect IV length or input data too short.
 */
 LUACRYPTO_AEAD_NEWCRYPT(decrypt, DECRYPT, -1);
 
+/***
+* Encrypts a range of a data object in place.
+* The range holds the AAD, the plaintext and room for the tag (format: AAD || Plaintext || Tag);
+* the plaintext is replaced by the ciphertext and the tag is written at the end of the range.
+* It doesn't allocate memory; thus, it suits per-packet encryption (e.g., of packet payloads).
+* @function encrypt_into
+* @tparam data data The data object.
+* @tparam[opt=0] integer offset The start of the range.
+* @tparam[opt] integer length The length of the range (defaults to the rest of the data).
+* @tparam string iv The Initialization Vector (nonce). Its length must match `ivsize()`.
+* @tparam[opt=0] integer aad_len The length of the AAD at the start of the range.
+* @raise Error on encryption failure, incorrect IV length, or if the range is out of bounds
+*   or too short for the AAD and tag.
+* @usage
+*   -- payload: AAD || plaintext || 16 bytes for the tag
+*   cipher:encrypt_into(payload, 0, #payload, nonce, 8)
+*/
+LUACRYPTO_AEAD_NEWCRYPTINTO(encrypt, ENCRYPT);
+
+/***
+* Decrypts a range of a data object in place.
+* The range holds the AAD, the ciphertext and the tag (format: AAD || Ciphertext || Tag);
+* the ciphertext is replaced by the plaintext, once the tag is verified.
+* @function decrypt_into
+* @tparam data data The data object.
+* @tparam[opt=0] integer offset The start of the range.
+* @tparam[opt] integer length The length of the range (defaults to the rest of the data).
+* @tparam string iv The Initialization Vector (nonce). Its length must match `ivsize()`.
+* @tparam[opt=0] integer aad_len The length of the AAD at the start of the range.
+* @raise Error on decryption failure (e.g., authentication error - EBADMSG), incorrect IV length,
+*   or if the range is out of bounds or too short for the AAD and tag.
+*/
+LUACRYPTO_AEAD_NEWCRYPTINTO(decrypt, DECRYPT);
+
+/* AAD || buffer, without concatenating them */
+static inline void luacrypto_aead_setsg(struct scatterlist *sg, const char *aad, size_t aad_len, char *buffer, size_t len)
+{
+	if (aad_len == 0) {
+		sg_init_one(sg, buffer, len);
+		return;
+	}
+	sg_init_table(sg, 2);
+	sg_set_buf(&sg[0], aad, aad_len);
+	sg_set_buf(&sg[1], buffer, len);
+}
+
+#define LUACRYPTO_AEAD_OUTLEN_SEAL(text_len, authsize)	(text_len + authsize)
+#define LUACRYPTO_AEAD_OUTLEN_OPEN(text_len, authsize)	(text_len - authsize)
+
+#define LUACRYPTO_AEAD_CHECK_SEAL(L, ix, text_len, authsize)
+#define LUACRYPTO_AEAD_CHECK_OPEN(L, ix, text_len, authsize)	LUACRYPTO_AEAD_CHECK_DECRYPT(L, ix, text_len, authsize)
+
+/*
+ * AAD entries of source and destination share the same memory; the (out-of-place)
+ * implementations that copy AAD to the destination thus rewrite the very same bytes
+ */
+#define LUACRYPTO_AEAD_NEWSEAL(name, NAME, op)									\
+static int luacrypto_aead_##name(lua_State *L) {								\
+	struct crypto_aead *tfm = luacrypto_aead_tfm(luacrypto_aead_check(L, 1));				\
+	const char *iv = luacrypto_aead_checkiv(L, 2, tfm);							\
+	size_t text_len, aad_len;										\
+	const char *text = luaL_checklstring(L, 3, &text_len);							\
+	const char *aad = luaL_optlstring(L, 4, "", &aad_len);							\
+	unsigned int authsize = crypto_aead_authsize(tfm);							\
+														\
+	LUACRYPTO_AEAD_CHECK_##NAME(L, 3, text_len, authsize);							\
+	size_t out_len = LUACRYPTO_AEAD_OUTLEN_##NAME(text_len, authsize);					\
+														\
+	luaL_Buffer B;												\
+	char *buffer = luaL_buffinitsize(L, &B, out_len);							\
+	struct scatterlist src[2], dst[2];									\
+	luacrypto_aead_setsg(src, aad, aad_len, (char *)text, text_len);					\
+	luacrypto_aead_setsg(dst, aad, aad_len, buffer, out_len);						\
+														\
+	int ret = luacrypto_aead_run(L, 1, op, iv, src, dst, aad_len, text_len);				\
+	if (ret < 0)												\
+		luaL_error(L, "crypto operation failed with error code %d", -ret);				\
+														\
+	luaL_pushresultsize(&B, out_len);									\
+	return 1;												\
+}
+
+/***
+* Encrypts and authenticates a plaintext, with optional AAD.
+* Unlike `encrypt`, the AAD and plaintext are passed separately and the AAD
+* isn't returned; thus, neither of them is copied beforehand.
+* @function seal
+* @tparam string iv The Initialization Vector (nonce). Its length must match `ivsize()`.
+* @tparam string plaintext The data to encrypt.
+* @tparam[opt] string aad The Additional Authenticated Data (defaults to empty).
+* @treturn string The ciphertext followed by the tag (format: Ciphertext || Tag).
+* @raise Error on encryption failure or incorrect IV length.
+* @usage
+*   local sealed = cipher:seal(nonce, payload, header)
+*/
+LUACRYPTO_AEAD_NEWSEAL(seal, SEAL, crypto_aead_encrypt);
+
+/***
+* Verifies and decrypts a ciphertext, with optional AAD.
+* It's the inverse of `seal`.
+* @function open
+* @tparam string iv The Initialization Vector (nonce). Its length must match `ivsize()`.
+* @tparam string ciphertext The ciphertext followed by the tag (format: Ciphertext || Tag).
+* @tparam[opt] string aad The Additional Authenticated Data (defaults to empty).
+* @treturn string The plaintext.
+* @raise Error on decryption failure (e.g., authentication error - EBADMSG), incorrect IV length or input data too short.
+*/
+LUACRYPTO_AEAD_NEWSEAL(open, OPEN, crypto_aead_decrypt);
+
+typedef struct luacrypto_aead_batchentry_s {
+	luacrypto_batchentry_t entry;
+	struct aead_request *request;
+	struct scatterlist src[2];
+	struct scatterlist dst[2];
+	const char *input;
+	const char *aad;
+	const char *iv;
+	size_t len;
+	size_t aad_len;
+	size_t out_len;
+	size_t offset; /* of its output (followed by its IV) */
+} luacrypto_aead_batchentry_t;
+
+static int luacrypto_aead_batch(lua_State *L, int (*op)(struct aead_request *), bool seal)
+{
+	struct crypto_aead *tfm = luacrypto_aead_tfm(luacrypto_aead_check(L, 1));
+	unsigned int ivsize = crypto_aead_ivsize(tfm);
+	unsigned int authsize = crypto_aead_authsize(tfm);
+	gfp_t gfp = lunatik_gfp(lunatik_toruntime(L));
+	bool hasaad = !lua_isnoneornil(L, 4);
+	luacrypto_aead_batchentry_t *entries;
+	luacrypto_batch_t batch;
+	size_t total = 0;
+	lua_Integer i, n;
+	char *out;
+
+	luaL_checktype(L, 2, LUA_TTABLE);
+	luaL_checktype(L, 3, LUA_TTABLE);
+	n = (lua_Integer)lua_rawlen(L, 3);
+	lunatik_checkbounds(L, 3, n, 1, LUACRYPTO_MAXBATCH);
+	luaL_argcheck(L, (lua_Integer)lua_rawlen(L, 2) == n, 2, "expected an IV per input");
+	if (hasaad)
+		luaL_argcheck(L, lua_istable(L, 4) && (lua_Integer)lua_rawlen(L, 4) == n, 4, "expected an AAD per input");
+	lua_settop(L, 4);
+
+	/* checks all arguments before submitting any request */
+	entries = (luacrypto_aead_batchentry_t *)lua_newuserdatauv(L, n * sizeof(luacrypto_aead_batchentry_t), 0);
+	for (i = 0; i < n; i++) {
+		luacrypto_aead_batchentry_t *e = &entries[i];
+
+		luaL_argcheck(L, lua_rawgeti(L, 2, i + 1) == LUA_TSTRING && lua_rawlen(L, -1) == ivsize, 2,
+			"incorrect IV length");
+		luaL_argcheck(L, lua_rawgeti(L, 3, i + 1) == LUA_TSTRING, 3, "expected an array of strings");
+		e->iv = lua_tostring(L, -2);
+		e->input = lua_tolstring(L, -1, &e->len);
+		luaL_argcheck(L, seal || e->len >= authsize, 3, "input data (ciphertext+tag) too short for tag");
+		e->out_len = seal ? e->len + authsize : e->len - authsize;
+		e->aad = "";
+		e->aad_len = 0;
+		if (hasaad) {
+			luaL_argcheck(L, lua_rawgeti(L, 4, i + 1) == LUA_TSTRING, 4, "expected an array of strings");
+			e->aad = lua_tolstring(L, -1, &e->aad_len);
+			lua_pop(L, 1);
+		}
+		e->offset = total;
+		total += e->out_len + ivsize;
+		lua_pop(L, 2); /* referenced by the argument tables */
+	}
+	out = (char *)lua_newuserdatauv(L, total, 0);
+
+	for (i = 0; i < n; i++) {
+		if ((entries[i].request = aead_request_alloc(tfm, gfp)) == NULL) {
+			while (i-- > 0)
+				aead_request_free(entries[i].request);
+			luaL_error(L, "not enough memory");
+		}
+	}
+
+	luacrypto_batch_init(&batch);
+	for (i = 0; i < n; i++) {
+		luacrypto_aead_batchentry_t *e = &entries[i];
+		char *buffer = out + e->offset;
+		u8 *iv = (u8 *)buffer + e->out_len;
+
+		memcpy(iv, e->iv, ivsize);
+		luacrypto_aead_setsg(e->src, e->aad, e->aad_len, (char *)e->input, e->len);
+		luacrypto_aead_setsg(e->dst, e->aad, e->aad_len, buffer, e->out_len);
+		aead_request_set_callback(e->request, CRYPTO_TFM_REQ_MAY_BACKLOG, luacrypto_batch_callback, &e->entry);
+		aead_request_set_ad(e->request, e->aad_len);
+		aead_request_set_crypt(e->request, e->src, e->dst, e->len, iv);
+		luacrypto_batch_add(&batch, &e->entry);
+		luacrypto_batch_submitted(&e->entry, op(e->request));
+	}
+	luacrypto_batch_wait(&batch);
+
+	for (i = 0; i < n; i++)
+		aead_request_free(entries[i].request);
+
+	lua_createtable(L, (int)n, 0);
+	for (i = 0; i < n; i++)
+		luacrypto_batch_pushresult(L, i + 1, &entries[i].entry, out + entries[i].offset, entries[i].out_len);
+	return 1;
+}
+
+/***
+* Seals many plaintexts in a single call.
+* All requests are submitted at once and then waited for; thus, asynchronous
+* implementations (e.g., `cryptd` or hardware engines) process them in parallel.
+* @function seal_batch
+* @tparam table ivs An array of Initialization Vectors (nonces), one per plaintext.
+* @tparam table plaintexts An array of strings to encrypt.
+* @tparam[opt] table aads An array with the Additional Authenticated Data of each plaintext.
+* @treturn table An array with the ciphertext and tag (format: Ciphertext || Tag) of each
+*   plaintext or, if its encryption has failed, its error code.
+* @raise Error on allocation failure, incorrect IV length or if the arrays are malformed.
+* @see seal
+*/
+static int luacrypto_aead_seal_batch(lua_State *L) {
+	return luacrypto_aead_batch(L, crypto_aead_encrypt, true);
+}
+
+/***
+* Opens many ciphertexts in a single call.
+* A ciphertext that fails authentication doesn't affect the others.
+* @function open_batch
+* @tparam table ivs An array of Initialization Vectors (nonces), one per ciphertext.
+* @tparam table ciphertexts An array of strings (format: Ciphertext || Tag) to decrypt.
+* @tparam[opt] table aads An array with the Additional Authenticated Data of each ciphertext.
+* @treturn table An array with the plaintext of each ciphertext or, if its decryption has
+*   failed, its error code (e.g., EBADMSG).
+* @raise Error on allocation failure, incorrect IV length or if the arrays are malformed.
+* @see open
+* @usage
+*   for i, plaintext in ipairs(cipher:open_batch(nonces, records)) do
+*     if type(plaintext) == "string" then deliver(plaintext) end
+*   end
+*/
+static int luacrypto_aead_open_batch(lua_State *L) {
+	return luacrypto_aead_batch(L, crypto_aead_decrypt, false);
+}
+
 /*** Lua C methods for the AEAD object.
 * Includes cryptographic operations and Lunatik metamethods.
 * The `__close` method is important for explicit resource cleanup.
@@ -198,12 +476,39 @@ static const luaL_Reg luacrypto_aead_mt[] = {
 	{"authsize", luacrypto_aead_authsize},
 	{"encrypt", luacrypto_aead_encrypt},
 	{"decrypt", luacrypto_aead_decrypt},
+	{"encrypt_into", luacrypto_aead_encrypt_into},
+	{"decrypt_into", luacrypto_aead_decrypt_into},
+	{"seal", luacrypto_aead_seal},
+	{"open", luacrypto_aead_open},
+	{"seal_batch", luacrypto_aead_seal_batch},
+	{"open_batch", luacrypto_aead_open_batch},
 	{"__gc", lunatik_deleteobject},
 	{"__close", lunatik_closeobject},
 	{"__index", lunatik_monitorobject},
 	{NULL, NULL}
 };
 
+/*** Lua C methods for per-CPU AEAD objects.
+* The same methods, but without the object lock and without `__close`, as
+* they are shared among runtimes; thus, they are released by their last reference.
+*/
+static const luaL_Reg luacrypto_aead_percpu_mt[] = {
+	{"setkey", luacrypto_aead_setkey},
+	{"setauthsize", luacrypto_aead_setauthsize},
+	{"ivsize", luacrypto_aead_ivsize},
+	{"authsize", luacrypto_aead_authsize},
+	{"encrypt", luacrypto_aead_encrypt},
+	{"decrypt", luacrypto_aead_decrypt},
+	{"encrypt_into", luacrypto_aead_encrypt_into},
+	{"decrypt_into", luacrypto_aead_decrypt_into},
+	{"seal", luacrypto_aead_seal},
+	{"open", luacrypto_aead_open},
+	{"seal_batch", luacrypto_aead_seal_batch},
+	{"open_batch", luacrypto_aead_open_batch},
+	{"__gc", lunatik_deleteobject},
+	{NULL, NULL}
+};
+
 /*** Lunatik class definition for AEAD TFM objects.
 * This structure binds the C implementation (luacrypto_aead_tfm_t, methods, release function)
 * to the Lua object system managed by Lunatik.
@@ -216,10 +521,21 @@ static const lunatik_class_t luacrypto_aead_class = {
 	.pointer = true,
 };
 
+static const lunatik_class_t luacrypto_aead_percpu_class = {
+	.name = "crypto_aead_percpu",
+	.methods = luacrypto_aead_percpu_mt,
+	.release = luacrypto_aead_releasepercpu,
+	.sleep = true,
+	.pointer = true,
+};
+
 /*** Creates a new AEAD object.
 * This is the constructor function for the `aead` module.
 * @function .new
 * @tparam string algname The name of the AEAD algorithm (e.g., "gcm(aes)", "ccm(aes)").
+* @tparam[opt] boolean percpu If `true`, creates a per-CPU object, holding a transform
+*   for each CPU, which can be used concurrently by multiple runtimes without locking.
+*   Its key and tag size must be set before sharing it.
 * @treturn aead The new AEAD object.
 * @raise Error if the TFM object or kernel request cannot be allocated/initialized.
 * @usage
@@ -227,14 +543,40 @@ static const lunatik_class_t luacrypto_aead_class = {
 *   local cipher = aead.new("gcm(aes)")
 * @within aead
 */
-LUACRYPTO_NEW(aead, struct crypto_aead, crypto_alloc_aead, luacrypto_aead_class, NULL);
+static luacrypto_aead_t *luacrypto_aead_new_request(lua_State *L, struct crypto_aead *tfm)
+{
+	luacrypto_aead_t *aead = lunatik_malloc(L, struct_size(aead, iv, crypto_aead_ivsize(tfm)));
+
+	if (aead == NULL || (aead->request = aead_request_alloc(tfm, GFP_KERNEL)) == NULL) {
+		lunatik_free(aead);
+		crypto_free_aead(tfm);
+		luaL_error(L, "not enough memory");
+	}
+	crypto_init_wait(&aead->wait);
+	aead_request_set_callback(aead->request, CRYPTO_TFM_REQ_MAY_BACKLOG, crypto_req_done, &aead->wait);
+	return aead;
+}
+
+LUACRYPTO_NEW(aead, struct crypto_aead, crypto_alloc_aead, luacrypto_aead_class, luacrypto_aead_new_request);
+LUACRYPTO_NEWPERCPU(aead, struct crypto_aead, crypto_alloc_aead, luacrypto_aead_new_request);
+
+static int luacrypto_aead_lnew(lua_State *L)
+{
+	return lua_toboolean(L, 2) ? luacrypto_aead_newpercpu(L) : luacrypto_aead_new(L);
+}
 
 static const luaL_Reg luacrypto_aead_lib[] = {
-	{"new", luacrypto_aead_new},
+	{"new", luacrypto_aead_lnew},
+	{NULL, NULL}
+};
+
+static const luaL_Reg luacrypto_aead_percpu_lib[] = {
+	{"new", luacrypto_aead_newpercpu},
 	{NULL, NULL}
 };
 
 LUNATIK_NEWLIB(crypto_aead, luacrypto_aead_lib, &luacrypto_aead_class, NULL);
+LUNATIK_NEWLIB(crypto_aead_percpu, luacrypto_aead_percpu_lib, &luacrypto_aead_percpu_class, NULL);
 
 static int __init luacrypto_aead_init(void)
 {
@@ -0,0 +1,298 @@
+/*
+* SPDX-FileCopyrightText: (c) 2025 Ring Zero Desenvolvimento de Software LTDA
+* SPDX-License-Identifier: MIT OR GPL-2.0-only
+*/
+
+/***
+* Low-level Lua interface to HMAC-based Extract-and-Expand Key Derivation
+* Function (HKDF), as specified by RFC 5869, on top of the Linux Kernel
+* Crypto API.
+*
+* An HKDF object holds an HMAC transform and caches its last key; thus, the
+* keyed (inner and outer) hash state is only recomputed when the key changes
+* (e.g., deriving many secrets from the same PRK doesn't rekey the transform).
+* Expansion runs in C, hashing each block without building intermediate strings.
+*
+* Input keying material, salts, PRKs and info may be strings, data objects
+* (used as a whole) or data ranges, given as tables `{data, offset, length}`
+* (e.g., `{packet, 40, 32}`), where `offset` and `length` are optional.
+*
+* @module crypto_hkdf
+* @see crypto.hkdf
+*/
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <crypto/hash.h>
+#include <linux/err.h>
+#include <linux/string.h>
+
+#include <lua.h>
+#include <lualib.h>
+#include <lauxlib.h>
+#include <lunatik.h>
+
+#include "luacrypto.h"
+#include "luadata.h"
+
+#define LUACRYPTO_HKDF_MAXKEY	(128)
+#define LUACRYPTO_HKDF_MAXBLOCKS	(255)
+
+typedef struct luacrypto_hkdf_s {
+	size_t keylen; /* of the cached key; greater than LUACRYPTO_HKDF_MAXKEY if none */
+	u8 key[LUACRYPTO_HKDF_MAXKEY];
+	struct shash_desc desc; /* must be the last field */
+} luacrypto_hkdf_t;
+
+static const u8 luacrypto_hkdf_zeros[HASH_MAX_DIGESTSIZE];
+
+LUNATIK_PRIVATECHECKER(luacrypto_hkdf_check, luacrypto_hkdf_t *);
+
+static inline void luacrypto_hkdf_release_tfm(luacrypto_hkdf_t *hkdf)
+{
+	if (hkdf->desc.tfm)
+		crypto_free_shash(hkdf->desc.tfm);
+	memzero_explicit(hkdf->key, sizeof(hkdf->key));
+}
+
+LUACRYPTO_RELEASER(hkdf, luacrypto_hkdf_t, lunatik_free, luacrypto_hkdf_release_tfm);
+
+/* a string, a data object (as a whole) or a data range, as {data [, offset [, length]]} */
+static const u8 *luacrypto_hkdf_checkbuffer(lua_State *L, int ix, size_t *len)
+{
+	const u8 *buffer;
+	int top;
+
+	switch (lua_type(L, ix)) {
+	case LUA_TUSERDATA:
+		return (const u8 *)luadata_checkptr(L, ix, len, false);
+	case LUA_TTABLE: /* the data object is kept referenced by the table */
+		top = lua_gettop(L);
+		luaL_checkstack(L, 3, NULL);
+		lua_rawgeti(L, ix, 1);
+		lua_rawgeti(L, ix, 2);
+		lua_rawgeti(L, ix, 3);
+		buffer = (const u8 *)luadata_checkrange(L, top + 1, len, false);
+		lua_settop(L, top);
+		return buffer;
+	default:
+		return (const u8 *)luaL_checklstring(L, ix, len);
+	}
+}
+
+static const u8 *luacrypto_hkdf_optbuffer(lua_State *L, int ix, size_t *len)
+{
+	if (lua_isnoneornil(L, ix)) {
+		*len = 0;
+		return NULL;
+	}
+	return luacrypto_hkdf_checkbuffer(L, ix, len);
+}
+
+static void luacrypto_hkdf_setkey(lua_State *L, luacrypto_hkdf_t *hkdf, const u8 *key, size_t keylen)
+{
+	if (keylen == hkdf->keylen && memcmp(hkdf->key, key, keylen) == 0)
+		return; /* keyed state is cached */
+
+	hkdf->keylen = LUACRYPTO_HKDF_MAXKEY + 1;
+	lunatik_try(L, crypto_shash_setkey, hkdf->desc.tfm, key, keylen);
+	if (keylen <= LUACRYPTO_HKDF_MAXKEY) {
+		memcpy(hkdf->key, key, keylen);
+		hkdf->keylen = keylen;
+	}
+}
+
+static void luacrypto_hkdf_doextract(lua_State *L, luacrypto_hkdf_t *hkdf, int ix, u8 *prk)
+{
+	struct crypto_shash *tfm = hkdf->desc.tfm;
+	size_t saltlen, ikmlen;
+	const u8 *salt = luacrypto_hkdf_optbuffer(L, ix, &saltlen);
+	const u8 *ikm = luacrypto_hkdf_checkbuffer(L, ix + 1, &ikmlen);
+
+	if (saltlen == 0) { /* RFC 5869, Section 2.2 */
+		salt = luacrypto_hkdf_zeros;
+		saltlen = crypto_shash_digestsize(tfm);
+	}
+	luacrypto_hkdf_setkey(L, hkdf, salt, saltlen);
+	lunatik_try(L, crypto_shash_digest, &hkdf->desc, ikm, ikmlen, prk);
+}
+
+static void luacrypto_hkdf_doexpand(lua_State *L, luacrypto_hkdf_t *hkdf, const u8 *prk, size_t prklen, int ix)
+{
+	struct shash_desc *desc = &hkdf->desc;
+	unsigned int digestsize = crypto_shash_digestsize(desc->tfm);
+	size_t infolen, tlen = 0, done = 0;
+	const u8 *info = luacrypto_hkdf_optbuffer(L, ix, &infolen);
+	lua_Integer length = luaL_checkinteger(L, ix + 1);
+	u8 t[HASH_MAX_DIGESTSIZE];
+	luaL_Buffer B;
+	u8 *okm;
+	u8 i;
+
+	lunatik_checkbounds(L, ix + 1, length, 1, LUACRYPTO_HKDF_MAXBLOCKS * digestsize);
+	luacrypto_hkdf_setkey(L, hkdf, prk, prklen);
+	okm = (u8 *)luaL_buffinitsize(L, &B, length);
+
+	/* T(i) = HMAC-Hash(PRK, T(i - 1) | info | i) */
+	for (i = 1; done < length; i++) {
+		size_t n = min_t(size_t, length - done, digestsize);
+
+		lunatik_try(L, crypto_shash_init, desc);
+		lunatik_try(L, crypto_shash_update, desc, t, tlen);
+		lunatik_try(L, crypto_shash_update, desc, info, infolen);
+		lunatik_try(L, crypto_shash_finup, desc, &i, 1, t);
+		memcpy(okm + done, t, n);
+		tlen = digestsize;
+		done += n;
+	}
+	memzero_explicit(t, sizeof(t));
+	luaL_pushresultsize(&B, length);
+}
+
+/***
+* HKDF object methods.
+* These methods are available on HKDF objects created by `crypto_hkdf.new()`.
+* @type HKDF
+*/
+
+/***
+* Gets the digest size (i.e., the PRK length) of the underlying HMAC.
+* @function digestsize
+* @treturn integer The digest size in bytes.
+*/
+static int luacrypto_hkdf_digestsize(lua_State *L) {
+	luacrypto_hkdf_t *hkdf = luacrypto_hkdf_check(L, 1);
+	lua_pushinteger(L, crypto_shash_digestsize(hkdf->desc.tfm));
+	return 1;
+}
+
+/***
+* Performs the HKDF Extract step; that is, HMAC(salt, ikm).
+* It can also be used as a plain HMAC, whose keyed state is cached.
+* @function extract
+* @tparam[opt] string|data|table salt The salt (HMAC key). If nil or empty, `digestsize()` zeros are used.
+* @tparam string|data|table ikm The Input Keying Material (HMAC message).
+* @treturn string The Pseudorandom Key (PRK).
+* @raise Error on failure.
+*/
+static int luacrypto_hkdf_extract(lua_State *L) {
+	luacrypto_hkdf_t *hkdf = luacrypto_hkdf_check(L, 1);
+	unsigned int digestsize = crypto_shash_digestsize(hkdf->desc.tfm);
+	luaL_Buffer B;
+	u8 *prk = (u8 *)luaL_buffinitsize(L, &B, digestsize);
+
+	luacrypto_hkdf_doextract(L, hkdf, 2, prk);
+	luaL_pushresultsize(&B, digestsize);
+	return 1;
+}
+
+/***
+* Performs the HKDF Expand step.
+* @function expand
+* @tparam string|data|table prk The Pseudorandom Key.
+* @tparam[opt] string|data|table info The context and application-specific information (defaults to empty).
+* @tparam integer length The length of the Output Keying Material, up to `255 * digestsize()` bytes.
+* @treturn string The Output Keying Material.
+* @raise Error on failure or if `length` is out of bounds.
+*/
+static int luacrypto_hkdf_expand(lua_State *L) {
+	luacrypto_hkdf_t *hkdf = luacrypto_hkdf_check(L, 1);
+	size_t prklen;
+	const u8 *prk = luacrypto_hkdf_checkbuffer(L, 2, &prklen);
+
+	luacrypto_hkdf_doexpand(L, hkdf, prk, prklen, 3);
+	return 1;
+}
+
+/***
+* Performs the full HKDF (Extract and Expand) operation.
+* The PRK is kept in kernel memory only.
+* @function derive
+* @tparam[opt] string|data|table salt The salt. If nil or empty, `digestsize()` zeros are used.
+* @tparam string|data|table ikm The Input Keying Material.
+* @tparam[opt] string|data|table info The context and application-specific information (defaults to empty).
+* @tparam integer length The length of the Output Keying Material.
+* @treturn string The Output Keying Material.
+* @raise Error on failure or if `length` is out of bounds.
+*/
+static int luacrypto_hkdf_derive(lua_State *L) {
+	luacrypto_hkdf_t *hkdf = luacrypto_hkdf_check(L, 1);
+	u8 prk[HASH_MAX_DIGESTSIZE];
+
+	luacrypto_hkdf_doextract(L, hkdf, 2, prk);
+	luacrypto_hkdf_doexpand(L, hkdf, prk, crypto_shash_digestsize(hkdf->desc.tfm), 4);
+	memzero_explicit(prk, sizeof(prk));
+	return 1;
+}
+
+static const luaL_Reg luacrypto_hkdf_mt[] = {
+	{"digestsize", luacrypto_hkdf_digestsize},
+	{"extract", luacrypto_hkdf_extract},
+	{"expand", luacrypto_hkdf_expand},
+	{"derive", luacrypto_hkdf_derive},
+	{"__gc", lunatik_deleteobject},
+	{"__close", lunatik_closeobject},
+	{"__index", lunatik_monitorobject},
+	{NULL, NULL}
+};
+
+static const lunatik_class_t luacrypto_hkdf_class = {
+	.name = "crypto_hkdf",
+	.methods = luacrypto_hkdf_mt,
+	.release = luacrypto_hkdf_release,
+	.sleep = true,
+	.pointer = true,
+};
+
+/***
+* Creates a new HKDF object.
+* This is the constructor function for the `crypto_hkdf` module.
+* @function new
+* @tparam string algname The name of the HMAC algorithm (e.g., "hmac(sha256)").
+* @treturn crypto_hkdf The new HKDF object.
+* @raise Error if the TFM object cannot be allocated/initialized.
+* @usage
+*   local hkdf = require("crypto_hkdf").new("hmac(sha256)")
+*   local okm = hkdf:derive(salt, ikm, "handshake", 32)
+* @within crypto_hkdf
+*/
+static luacrypto_hkdf_t *luacrypto_hkdf_new_desc(lua_State *L, struct crypto_shash *tfm)
+{
+	luacrypto_hkdf_t *hkdf;
+
+	if (crypto_shash_digestsize(tfm) > HASH_MAX_DIGESTSIZE ||
+	    (hkdf = lunatik_malloc(L, sizeof(luacrypto_hkdf_t) + crypto_shash_descsize(tfm))) == NULL) {
+		crypto_free_shash(tfm);
+		luaL_error(L, "failed to allocate HKDF descriptor");
+	}
+	hkdf->desc.tfm = tfm;
+	hkdf->keylen = LUACRYPTO_HKDF_MAXKEY + 1;
+	return hkdf;
+}
+
+LUACRYPTO_NEW(hkdf, struct crypto_shash, crypto_alloc_shash, luacrypto_hkdf_class, luacrypto_hkdf_new_desc);
+
+static const luaL_Reg luacrypto_hkdf_lib[] = {
+	{"new", luacrypto_hkdf_new},
+	{NULL, NULL}
+};
+
+LUNATIK_NEWLIB(crypto_hkdf, luacrypto_hkdf_lib, &luacrypto_hkdf_class, NULL);
+
+static int __init luacrypto_hkdf_init(void)
+{
+	return 0;
+}
+
+static void __exit luacrypto_hkdf_exit(void)
+{
+}
+
+module_init(luacrypto_hkdf_init);
+module_exit(luacrypto_hkdf_exit);
+MODULE_LICENSE("Dual MIT/GPL");
+MODULE_AUTHOR("Lourival Vieira Neto <lourival.neto@ring-0.io>");
+MODULE_DESCRIPTION("Lunatik low-level Linux Crypto API interface (HKDF)");
+
@@ -28,6 +28,7 @@
 #include <lunatik.h>
 
 #include "luacrypto.h"
+#include "luadata.h"
 
 LUNATIK_PRIVATECHECKER(luacrypto_rng_check, struct crypto_rng *);
 
@@ -85,6 +86,32 @@ static int luacrypto_rng_getbytes(lua_State *L)
 	return 1;
 }
 
+/***
+* Fills a data object range with random bytes, with optional seed.
+* Unlike `generate`, it doesn't allocate a new string on each call.
+* @function fill
+* @tparam data data The data object to fill.
+* @tparam[opt=0] integer offset The start of the range.
+* @tparam[opt] integer length The length of the range (defaults to the rest of the data).
+* @tparam[opt] string seed Optional seed material to mix into the RNG.
+* @raise Error on failure (e.g., crypto API error) or if the range is empty or out of bounds.
+* @usage
+*   rng:fill(nonces, 0, 12 * 64) -- 64 nonces at once
+*/
+static int luacrypto_rng_fill(lua_State *L)
+{
+	struct crypto_rng *tfm = luacrypto_rng_check(L, 1);
+	size_t len;
+	u8 *buffer = (u8 *)luadata_checkrange(L, 2, &len, true);
+
+	size_t seed_len = 0;
+	const char *seed_data = lua_tolstring(L, 5, &seed_len);
+
+	lunatik_checkbounds(L, 4, len, 1, UINT_MAX);
+	lunatik_try(L, crypto_rng_generate, tfm, seed_data, (unsigned int)seed_len, buffer, (unsigned int)len);
+	return 0;
+}
+
 /***
 * Resets the RNG.
 * This can be used to re-initialize the RNG, optionally with new seed material.
@@ -131,6 +158,7 @@ static const luaL_Reg luacrypto_rng_mt[] = {
 	{"generate", luacrypto_rng_generate},
 	{"reset", luacrypto_rng_reset},
 	{"getbytes", luacrypto_rng_getbytes},
+	{"fill", luacrypto_rng_fill},
 	{"info", luacrypto_rng_info},
 	{"__gc", lunatik_deleteobject},
 	{"__close", lunatik_closeobject},
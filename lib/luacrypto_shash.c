@@ -20,6 +20,7 @@
 #include <crypto/hash.h>
 #include <linux/err.h>
 #include <linux/slab.h>
+#include <linux/version.h>
 
 #include <lua.h>
 #include <lualib.h>
@@ -27,8 +28,18 @@
 #include <lunatik.h>
 
 #include "luacrypto.h"
+#include "luadata.h"
 
-LUNATIK_PRIVATECHECKER(luacrypto_shash_check, struct shash_desc *);
+LUACRYPTO_CHECKER(shash, struct shash_desc);
+
+/* per-CPU descriptors might be used concurrently, so they only provide single-shot operations */
+static inline struct shash_desc *luacrypto_shash_checkstate(lua_State *L, int ix)
+{
+	struct shash_desc *sdesc = luacrypto_shash_check(L, ix);
+	luaL_argcheck(L, lunatik_toobject(L, ix)->class != &luacrypto_shash_percpu_class, ix,
+		"not supported on per-CPU objects");
+	return sdesc;
+}
 
 static inline void luacrypto_shash_release_tfm(struct shash_desc *obj)
 {
@@ -37,6 +48,22 @@ static inline void luacrypto_shash_release_tfm(struct shash_desc *obj)
 }
 
 LUACRYPTO_RELEASER(shash, struct shash_desc, lunatik_free, luacrypto_shash_release_tfm);
+LUACRYPTO_PERCPU_RELEASER(shash);
+
+static inline int luacrypto_shash_tfm_digest(struct crypto_shash *tfm, const u8 *data, unsigned int len, u8 *out)
+{
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(5, 8, 0))
+	return crypto_shash_tfm_digest(tfm, data, len, out);
+#else
+	SHASH_DESC_ON_STACK(desc, tfm);
+	int ret;
+
+	desc->tfm = tfm;
+	ret = crypto_shash_digest(desc, data, len, out);
+	shash_desc_zero(desc);
+	return ret;
+#endif
+}
 
 /***
 * SHASH object methods.
@@ -63,35 +90,84 @@ static int luacrypto_shash_digestsize(lua_State *L) {
 * @raise Error if setting the key fails.
 */
 static int luacrypto_shash_setkey(lua_State *L) {
-	struct shash_desc *sdesc = luacrypto_shash_check(L, 1);
+	unsigned int i, n;
+	void **sdescs = luacrypto_shash_tfms(L, 1, &n);
 	size_t keylen;
 	const char *key = luaL_checklstring(L, 2, &keylen);
-	lunatik_try(L, crypto_shash_setkey, sdesc->tfm, key, keylen);
+	for (i = 0; i < n; i++)
+		lunatik_try(L, crypto_shash_setkey, ((struct shash_desc *)sdescs[i])->tfm, key, keylen);
 	return 0;
 }
 
+/* a string or a data range (i.e., data [, offset [, length]]) */
+static inline const char *luacrypto_shash_checkbuffer(lua_State *L, int ix, size_t *len)
+{
+	return lua_type(L, ix) == LUA_TUSERDATA ? (const char *)luadata_checkrange(L, ix, len, false) :
+		luaL_checklstring(L, ix, len);
+}
+
 /***
 * Computes the hash of the given data in a single operation.
 * For HMAC, `setkey()` must have been called first.
 * This function initializes, updates, and finalizes the hash calculation.
 * @function digest
-* @tparam string data The data to hash.
+* @tparam string|data data The data to hash.
+* @tparam[opt=0] integer offset If `data` is a data object, the start of the range to hash.
+* @tparam[opt] integer length If `data` is a data object, the length of the range
+*   (defaults to the rest of the data).
 * @treturn string The computed digest (hash output).
 * @raise Error on failure (e.g., allocation error, crypto API error).
 */
 static int luacrypto_shash_digest(lua_State *L) {
 	struct shash_desc *sdesc = luacrypto_shash_check(L, 1);
 	size_t datalen;
-	const char *data = luaL_checklstring(L, 2, &datalen);
+	const char *data = luacrypto_shash_checkbuffer(L, 2, &datalen);
 	unsigned int digestsize = crypto_shash_digestsize(sdesc->tfm);
 	luaL_Buffer b;
 	u8 *digest_buf = luaL_buffinitsize(L, &b, digestsize);
 
-	lunatik_try(L, crypto_shash_digest, sdesc, data, datalen, digest_buf);
+	lunatik_try(L, luacrypto_shash_tfm_digest, sdesc->tfm, data, datalen, digest_buf);
 	luaL_pushresultsize(&b, digestsize);
 	return 1;
 }
 
+/***
+* Computes the digests of many buffers in a single call.
+* Each digest is computed on an on-stack descriptor; thus, it doesn't allocate
+* memory other than the resulting strings and, on per-CPU objects, runs concurrently.
+* @function digest_many
+* @tparam table buffers An array of strings or data objects (hashed as a whole).
+* @treturn table An array with the digest of each buffer, in the same order.
+* @raise Error on failure or if an entry is neither a string nor a data object.
+* @usage
+*   local digests = hasher:digest_many({record1, record2, record3})
+*/
+static int luacrypto_shash_digest_many(lua_State *L) {
+	struct shash_desc *sdesc = luacrypto_shash_check(L, 1);
+	unsigned int digestsize = crypto_shash_digestsize(sdesc->tfm);
+	u8 digest[HASH_MAX_DIGESTSIZE];
+	lua_Integer i, n;
+
+	luaL_checktype(L, 2, LUA_TTABLE);
+	n = luaL_len(L, 2);
+	lua_settop(L, 2);
+	lua_createtable(L, (int)n, 0); /* digests at 3 */
+
+	for (i = 1; i <= n; i++) {
+		size_t datalen;
+		const char *data;
+
+		lua_geti(L, 2, i); /* buffer at 4 */
+		data = lua_type(L, 4) == LUA_TUSERDATA ? (const char *)luadata_checkptr(L, 4, &datalen, false) :
+			luaL_checklstring(L, 4, &datalen);
+		lunatik_try(L, luacrypto_shash_tfm_digest, sdesc->tfm, data, datalen, digest);
+		lua_pushlstring(L, (const char *)digest, digestsize);
+		lua_seti(L, 3, i);
+		lua_pop(L, 1); /* buffer */
+	}
+	return 1;
+}
+
 /***
 * Initializes a multi-part hash operation.
 * This must be called before using `update()` or `final()`.
@@ -99,7 +175,7 @@ static int luacrypto_shash_digest(lua_State *L) {
 * @raise Error on failure.
 */
 static int luacrypto_shash_init_method(lua_State *L) {
-	struct shash_desc *sdesc = luacrypto_shash_check(L, 1);
+	struct shash_desc *sdesc = luacrypto_shash_checkstate(L, 1);
 
 	lunatik_try(L, crypto_shash_init, sdesc);
 	return 0;
@@ -109,13 +185,16 @@ static int luacrypto_shash_init_method(lua_State *L) {
 * Updates the hash state with more data.
 * Must be called after `init()`. Can be called multiple times.
 * @function update
-* @tparam string data The data chunk to add to the hash.
+* @tparam string|data data The data chunk to add to the hash.
+* @tparam[opt=0] integer offset If `data` is a data object, the start of the range to add.
+* @tparam[opt] integer length If `data` is a data object, the length of the range
+*   (defaults to the rest of the data).
 * @raise Error on failure.
 */
 static int luacrypto_shash_update(lua_State *L) {
-	struct shash_desc *sdesc = luacrypto_shash_check(L, 1);
+	struct shash_desc *sdesc = luacrypto_shash_checkstate(L, 1);
 	size_t datalen;
-	const char *data = luaL_checklstring(L, 2, &datalen);
+	const char *data = luacrypto_shash_checkbuffer(L, 2, &datalen);
 
 	lunatik_try(L, crypto_shash_update, sdesc, data, datalen);
 	return 0;
@@ -129,7 +208,7 @@ static int luacrypto_shash_update(lua_State *L) {
 * @raise Error on failure.
 */
 static int luacrypto_shash_final(lua_State *L) {
-	struct shash_desc *sdesc = luacrypto_shash_check(L, 1);
+	struct shash_desc *sdesc = luacrypto_shash_checkstate(L, 1);
 	unsigned int digestsize = crypto_shash_digestsize(sdesc->tfm);
 	luaL_Buffer b;
 	u8 *digest_buf = luaL_buffinitsize(L, &b, digestsize);
@@ -144,14 +223,16 @@ static int luacrypto_shash_final(lua_State *L) {
 * Updates the hash state with the given data, then finalizes and returns the digest.
 * `init()` must have been called prior to calling `finup()`.
 * @function finup
-* @tparam string data The final data chunk.
+* @tparam string|data data The final data chunk.
+* @tparam[opt=0] integer offset If `data` is a data object, the start of the range.
+* @tparam[opt] integer length If `data` is a data object, the length of the range.
 * @treturn string The computed digest.
 * @raise Error on failure.
 */
 static int luacrypto_shash_finup(lua_State *L) {
-	struct shash_desc *sdesc = luacrypto_shash_check(L, 1);
+	struct shash_desc *sdesc = luacrypto_shash_checkstate(L, 1);
 	size_t datalen;
-	const char *data = luaL_checklstring(L, 2, &datalen);
+	const char *data = luacrypto_shash_checkbuffer(L, 2, &datalen);
 	unsigned int digestsize = crypto_shash_digestsize(sdesc->tfm);
 	luaL_Buffer b;
 	u8 *digest_buf = luaL_buffinitsize(L, &b, digestsize);
@@ -170,7 +251,7 @@ static int luacrypto_shash_finup(lua_State *L) {
 * @raise Error on failure (e.g., allocation error).
 */
 static int luacrypto_shash_export(lua_State *L) {
-	struct shash_desc *sdesc = luacrypto_shash_check(L, 1);
+	struct shash_desc *sdesc = luacrypto_shash_checkstate(L, 1);
 	unsigned int statesize = crypto_shash_statesize(sdesc->tfm);
 	luaL_Buffer b;
 	void *state_buf = luaL_buffinitsize(L, &b, statesize);
@@ -188,7 +269,7 @@ static int luacrypto_shash_export(lua_State *L) {
 * @raise Error on failure or if the provided state length is incorrect for the algorithm.
 */
 static int luacrypto_shash_import(lua_State *L) {
-	struct shash_desc *sdesc = luacrypto_shash_check(L, 1);
+	struct shash_desc *sdesc = luacrypto_shash_checkstate(L, 1);
 	size_t statelen;
 	const char *state = luaL_checklstring(L, 2, &statelen);
 	unsigned int expected_statesize = crypto_shash_statesize(sdesc->tfm);
@@ -201,6 +282,7 @@ static const luaL_Reg luacrypto_shash_mt[] = {
 	{"digestsize", luacrypto_shash_digestsize},
 	{"setkey", luacrypto_shash_setkey},
 	{"digest", luacrypto_shash_digest},
+	{"digest_many", luacrypto_shash_digest_many},
 	{"init", luacrypto_shash_init_method},
 	{"update", luacrypto_shash_update},
 	{"final", luacrypto_shash_final},
@@ -213,6 +295,28 @@ static const luaL_Reg luacrypto_shash_mt[] = {
 	{NULL, NULL}
 };
 
+/***
+* Lua C methods for per-CPU SHASH objects.
+* The same methods, but without the object lock and without `__close`, as
+* they are shared among runtimes (thus, they are released by their last
+* reference); multi-part operations
+* (`init`, `update`, `final`, `finup`, `export` and `import`) raise errors.
+*/
+static const luaL_Reg luacrypto_shash_percpu_mt[] = {
+	{"digestsize", luacrypto_shash_digestsize},
+	{"setkey", luacrypto_shash_setkey},
+	{"digest", luacrypto_shash_digest},
+	{"digest_many", luacrypto_shash_digest_many},
+	{"init", luacrypto_shash_init_method},
+	{"update", luacrypto_shash_update},
+	{"final", luacrypto_shash_final},
+	{"finup", luacrypto_shash_finup},
+	{"export", luacrypto_shash_export},
+	{"import", luacrypto_shash_import},
+	{"__gc", lunatik_deleteobject},
+	{NULL, NULL}
+};
+
 /***
 * Lunatik class definition for SHASH objects.
 * This structure binds the C implementation (luacrypto_shash_tfm_t, methods, release function)
@@ -226,11 +330,22 @@ static const lunatik_class_t luacrypto_shash_class = {
 	.pointer = true,
 };
 
+static const lunatik_class_t luacrypto_shash_percpu_class = {
+	.name = "crypto_shash_percpu",
+	.methods = luacrypto_shash_percpu_mt,
+	.release = luacrypto_shash_releasepercpu,
+	.sleep = true,
+	.pointer = true,
+};
+
 /***
 * Creates a new SHASH object.
 * This is the constructor function for the `crypto_shash` module.
 * @function new
 * @tparam string algname The name of the hash algorithm (e.g., "sha256", "hmac(sha256)").
+* @tparam[opt] boolean percpu If `true`, creates a per-CPU object, holding a transform
+*   for each CPU, which can be used concurrently by multiple runtimes without locking.
+*   It only supports single-shot operations (`digest`) and its key must be set before sharing it.
 * @treturn crypto_shash The new SHASH object.
 * @raise Error if the TFM object or kernel descriptor cannot be allocated/initialized.
 * @usage
@@ -247,13 +362,25 @@ static struct shash_desc *luacrypto_shash_new_sdesc(lua_State *L, struct crypto_
 }
 
 LUACRYPTO_NEW(shash, struct crypto_shash, crypto_alloc_shash, luacrypto_shash_class, luacrypto_shash_new_sdesc);
+LUACRYPTO_NEWPERCPU(shash, struct crypto_shash, crypto_alloc_shash, luacrypto_shash_new_sdesc);
+
+static int luacrypto_shash_lnew(lua_State *L)
+{
+	return lua_toboolean(L, 2) ? luacrypto_shash_newpercpu(L) : luacrypto_shash_new(L);
+}
 
 static const luaL_Reg luacrypto_shash_lib[] = {
-	{"new", luacrypto_shash_new},
+	{"new", luacrypto_shash_lnew},
+	{NULL, NULL}
+};
+
+static const luaL_Reg luacrypto_shash_percpu_lib[] = {
+	{"new", luacrypto_shash_newpercpu},
 	{NULL, NULL}
 };
 
 LUNATIK_NEWLIB(crypto_shash, luacrypto_shash_lib, &luacrypto_shash_class, NULL);
+LUNATIK_NEWLIB(crypto_shash_percpu, luacrypto_shash_percpu_lib, &luacrypto_shash_percpu_class, NULL);
 
 static int __init luacrypto_shash_init(void)
 {
@@ -22,6 +22,7 @@
 #include <linux/err.h>
 #include <linux/scatterlist.h>
 #include <linux/slab.h>
+#include <linux/overflow.h>
 
 #include <lua.h>
 #include <lualib.h>
@@ -29,10 +30,29 @@
 #include <lunatik.h>
 
 #include "luacrypto.h"
+#include "luadata.h"
 
-LUNATIK_PRIVATECHECKER(luacrypto_skcipher_check, struct crypto_skcipher *);
+/* each transform has a preallocated request, used under the object lock (or on its own CPU) */
+typedef struct luacrypto_skcipher_s {
+	struct skcipher_request *request;
+	struct crypto_wait wait;
+	u8 iv[];
+} luacrypto_skcipher_t;
 
-LUACRYPTO_RELEASER(skcipher, struct crypto_skcipher, crypto_free_skcipher, NULL);
+#define luacrypto_skcipher_tfm(skcipher)	crypto_skcipher_reqtfm((skcipher)->request)
+
+LUACRYPTO_CHECKER(skcipher, luacrypto_skcipher_t);
+
+static inline void luacrypto_skcipher_release_request(luacrypto_skcipher_t *skcipher)
+{
+	struct crypto_skcipher *tfm = luacrypto_skcipher_tfm(skcipher);
+
+	skcipher_request_free(skcipher->request);
+	crypto_free_skcipher(tfm);
+}
+
+LUACRYPTO_RELEASER(skcipher, luacrypto_skcipher_t, lunatik_free, luacrypto_skcipher_release_request);
+LUACRYPTO_PERCPU_RELEASER(skcipher);
 
 /***
 * SKCIPHER Object methods.
@@ -47,10 +67,12 @@ LUACRYPTO_RELEASER(skcipher, struct crypto_skcipher, crypto_free_skcipher, NULL)
 * @raise Error if setting the key fails (e.g., invalid key length for the algorithm).
 */
 static int luacrypto_skcipher_setkey(lua_State *L) {
-	struct crypto_skcipher *tfm = luacrypto_skcipher_check(L, 1);
+	unsigned int i, n;
+	void **tfms = luacrypto_skcipher_tfms(L, 1, &n);
 	size_t keylen;
 	const char *key = luaL_checklstring(L, 2, &keylen);
-	lunatik_try(L, crypto_skcipher_setkey, tfm, key, keylen);
+	for (i = 0; i < n; i++)
+		lunatik_try(L, crypto_skcipher_setkey, luacrypto_skcipher_tfm((luacrypto_skcipher_t *)tfms[i]), key, keylen);
 	return 0;
 }
 
@@ -60,7 +82,7 @@ static int luacrypto_skcipher_setkey(lua_State *L) {
 * @treturn integer The IV size in bytes.
 */
 static int luacrypto_skcipher_ivsize(lua_State *L) {
-	struct crypto_skcipher *tfm = luacrypto_skcipher_check(L, 1);
+	struct crypto_skcipher *tfm = luacrypto_skcipher_tfm(luacrypto_skcipher_check(L, 1));
 	lua_pushinteger(L, crypto_skcipher_ivsize(tfm));
 	return 1;
 }
@@ -73,56 +95,48 @@ static int luacrypto_skcipher_ivsize(lua_State *L) {
 * @treturn integer The block size in bytes.
 */
 static int luacrypto_skcipher_blocksize(lua_State *L) {
-	struct crypto_skcipher *tfm = luacrypto_skcipher_check(L, 1);
+	struct crypto_skcipher *tfm = luacrypto_skcipher_tfm(luacrypto_skcipher_check(L, 1));
 	lua_pushinteger(L, crypto_skcipher_blocksize(tfm));
 	return 1;
 }
 
-static inline struct skcipher_request *luacrypto_skcipher_newrequest(lua_State *L, const char **data, u8 **iv,
-	size_t *data_len)
+static inline int luacrypto_skcipher_run(lua_State *L, int ix, int (*op)(struct skcipher_request *), const char *iv,
+	struct scatterlist *sg, size_t len)
 {
-	struct crypto_skcipher *tfm = luacrypto_skcipher_check(L, 1);
-
-	size_t iv_len;
-	const char *l_iv = luaL_checklstring(L, 2, &iv_len);
-	luaL_argcheck(L, iv_len == crypto_skcipher_ivsize(tfm), 2, "incorrect IV length");
-
-	*data = luaL_checklstring(L, 3, data_len);
-
-	gfp_t gfp = lunatik_gfp(lunatik_toruntime(L));
-	struct skcipher_request *request = lunatik_checknull(L, skcipher_request_alloc(tfm, gfp));
-	*iv = (u8 *)lunatik_checkalloc(L, iv_len);
-	memcpy(*iv, l_iv, iv_len);
-
-	return request;
+	bool local;
+	luacrypto_skcipher_t *skcipher = luacrypto_skcipher_get(L, ix, &local);
+	struct skcipher_request *request = skcipher->request;
+	int ret;
+
+	memcpy(skcipher->iv, iv, crypto_skcipher_ivsize(luacrypto_skcipher_tfm(skcipher)));
+	skcipher_request_set_crypt(request, sg, sg, len, skcipher->iv);
+	ret = local ? op(request) : crypto_wait_req(op(request), &skcipher->wait); /* per-CPU transforms are synchronous */
+	luacrypto_put(local);
+	return ret;
 }
 
-static inline void luacrypto_skcipher_setrequest(lua_State *L, struct skcipher_request *request, const char *data, u8 *iv,
-	size_t data_len, char *buffer)
+static inline const char *luacrypto_skcipher_checkiv(lua_State *L, int ix, struct crypto_skcipher *tfm)
 {
-	memcpy(buffer, data, data_len);
-
-	struct scatterlist sg_work;
-	sg_init_one(&sg_work, buffer, data_len);
-
-	skcipher_request_set_crypt(request, &sg_work, &sg_work, data_len, iv);
-	skcipher_request_set_callback(request, 0, NULL, NULL);
+	size_t iv_len;
+	const char *iv = luaL_checklstring(L, ix, &iv_len);
+	luaL_argcheck(L, iv_len == crypto_skcipher_ivsize(tfm), ix, "incorrect IV length");
+	return iv;
 }
 
-LUACRYPTO_FREEREQUEST(skcipher, struct skcipher_request, skcipher_request_free);
-
 #define LUACRYPTO_SKCIPHER_NEWCRYPT(name)								\
 static int luacrypto_skcipher_##name(lua_State *L) {							\
-	const char *data;										\
-	u8 *iv;												\
+	struct crypto_skcipher *tfm = luacrypto_skcipher_tfm(luacrypto_skcipher_check(L, 1));		\
+	const char *iv = luacrypto_skcipher_checkiv(L, 2, tfm);						\
 	size_t data_len;										\
-	struct skcipher_request *request = luacrypto_skcipher_newrequest(L, &data, &iv, &data_len);	\
+	const char *data = luaL_checklstring(L, 3, &data_len);						\
 													\
 	luaL_Buffer B;											\
 	char *buffer = luaL_buffinitsize(L, &B, data_len);						\
-	luacrypto_skcipher_setrequest(L, request, data, iv, data_len, buffer);				\
-	int ret = crypto_skcipher_##name(request);							\
-	luacrypto_skcipher_freerequest(request, iv);							\
+	memcpy(buffer, data, data_len);									\
+													\
+	struct scatterlist sg;										\
+	sg_init_one(&sg, buffer, data_len);								\
+	int ret = luacrypto_skcipher_run(L, 1, crypto_skcipher_##name, iv, &sg, data_len);		\
 	if (ret < 0)											\
 		luaL_error(L, "Crypto operation failed with error code %d", -ret);			\
 													\
@@ -130,6 +144,21 @@ static int luacrypto_skcipher_##name(lua_State *L) {							\
 	return 1;											\
 }
 
+#define LUACRYPTO_SKCIPHER_NEWCRYPTINTO(name)								\
+static int luacrypto_skcipher_##name##_into(lua_State *L) {						\
+	struct crypto_skcipher *tfm = luacrypto_skcipher_tfm(luacrypto_skcipher_check(L, 1));		\
+	size_t len;											\
+	char *buffer = (char *)luadata_checkrange(L, 2, &len, true);					\
+	const char *iv = luacrypto_skcipher_checkiv(L, 5, tfm);						\
+													\
+	struct scatterlist sg;										\
+	sg_init_one(&sg, buffer, len);									\
+	int ret = luacrypto_skcipher_run(L, 1, crypto_skcipher_##name, iv, &sg, len);			\
+	if (ret < 0)											\
+		luaL_error(L, "Crypto operation failed with error code %d", -ret);			\
+	return 0;											\
+}
+
 /***
 * Encrypts plaintext using the SKCIPHER transform.
 * The IV (nonce) must be unique for each encryption operation with the same key for most modes.
@@ -138,7 +167,7 @@ static int luacrypto_skcipher_##name(lua_State *L) {							\
 * @tparam string iv The Initialization Vector. Its length must match `ivsize()`.
 * @tparam string plaintext The data to encrypt.
 * @treturn string The ciphertext.
-* @raise Error on encryption failure, incorrect IV length, or allocation issues.
+* @raise Error on encryption failure or incorrect IV length.
 */
 LUACRYPTO_SKCIPHER_NEWCRYPT(encrypt);
 
@@ -150,10 +179,140 @@ LUACRYPTO_SKCIPHER_NEWCRYPT(encrypt);
 * @tparam string iv The Initialization Vector. Its length must match `ivsize()`.
 * @tparam string ciphertext The data to decrypt.
 * @treturn string The plaintext.
-* @raise Error on decryption failure, incorrect IV length, or allocation issues.
+* @raise Error on decryption failure or incorrect IV length.
 */
 LUACRYPTO_SKCIPHER_NEWCRYPT(decrypt);
 
+/***
+* Encrypts a range of a data object in place.
+* It doesn't allocate memory; thus, it suits per-packet encryption (e.g., of packet payloads).
+* @function encrypt_into
+* @tparam data data The data object.
+* @tparam[opt=0] integer offset The start of the range.
+* @tparam[opt] integer length The length of the range (defaults to the rest of the data).
+* @tparam string iv The Initialization Vector. Its length must match `ivsize()`.
+* @raise Error on encryption failure, incorrect IV length, or if the range is out of bounds.
+* @usage
+*   cipher:encrypt_into(payload, 16, 64, iv)
+*/
+LUACRYPTO_SKCIPHER_NEWCRYPTINTO(encrypt);
+
+/***
+* Decrypts a range of a data object in place.
+* @function decrypt_into
+* @tparam data data The data object.
+* @tparam[opt=0] integer offset The start of the range.
+* @tparam[opt] integer length The length of the range (defaults to the rest of the data).
+* @tparam string iv The Initialization Vector. Its length must match `ivsize()`.
+* @raise Error on decryption failure, incorrect IV length, or if the range is out of bounds.
+*/
+LUACRYPTO_SKCIPHER_NEWCRYPTINTO(decrypt);
+
+typedef struct luacrypto_skcipher_batchentry_s {
+	luacrypto_batchentry_t entry;
+	struct skcipher_request *request;
+	struct scatterlist sg;
+	const char *input;
+	const char *iv;
+	size_t len;
+	size_t offset; /* of its output (followed by its IV) */
+} luacrypto_skcipher_batchentry_t;
+
+static int luacrypto_skcipher_batch(lua_State *L, int (*op)(struct skcipher_request *))
+{
+	struct crypto_skcipher *tfm = luacrypto_skcipher_tfm(luacrypto_skcipher_check(L, 1));
+	unsigned int ivsize = crypto_skcipher_ivsize(tfm);
+	gfp_t gfp = lunatik_gfp(lunatik_toruntime(L));
+	luacrypto_skcipher_batchentry_t *entries;
+	luacrypto_batch_t batch;
+	size_t total = 0;
+	lua_Integer i, n;
+	char *out;
+
+	luaL_checktype(L, 2, LUA_TTABLE);
+	luaL_checktype(L, 3, LUA_TTABLE);
+	n = (lua_Integer)lua_rawlen(L, 3);
+	lunatik_checkbounds(L, 3, n, 1, LUACRYPTO_MAXBATCH);
+	luaL_argcheck(L, (lua_Integer)lua_rawlen(L, 2) == n, 2, "expected an IV per input");
+
+	/* checks all arguments before submitting any request */
+	entries = (luacrypto_skcipher_batchentry_t *)lua_newuserdatauv(L, n * sizeof(luacrypto_skcipher_batchentry_t), 0);
+	for (i = 0; i < n; i++) {
+		luacrypto_skcipher_batchentry_t *e = &entries[i];
+
+		luaL_argcheck(L, lua_rawgeti(L, 2, i + 1) == LUA_TSTRING && lua_rawlen(L, -1) == ivsize, 2,
+			"incorrect IV length");
+		luaL_argcheck(L, lua_rawgeti(L, 3, i + 1) == LUA_TSTRING, 3, "expected an array of strings");
+		e->iv = lua_tostring(L, -2);
+		e->input = lua_tolstring(L, -1, &e->len);
+		e->offset = total;
+		total += e->len + ivsize;
+		lua_pop(L, 2); /* referenced by the argument tables */
+	}
+	out = (char *)lua_newuserdatauv(L, total, 0);
+
+	for (i = 0; i < n; i++) {
+		if ((entries[i].request = skcipher_request_alloc(tfm, gfp)) == NULL) {
+			while (i-- > 0)
+				skcipher_request_free(entries[i].request);
+			luaL_error(L, "not enough memory");
+		}
+	}
+
+	luacrypto_batch_init(&batch);
+	for (i = 0; i < n; i++) {
+		luacrypto_skcipher_batchentry_t *e = &entries[i];
+		char *buffer = out + e->offset;
+		u8 *iv = (u8 *)buffer + e->len;
+
+		memcpy(buffer, e->input, e->len);
+		memcpy(iv, e->iv, ivsize);
+		sg_init_one(&e->sg, buffer, e->len);
+		skcipher_request_set_callback(e->request, CRYPTO_TFM_REQ_MAY_BACKLOG, luacrypto_batch_callback, &e->entry);
+		skcipher_request_set_crypt(e->request, &e->sg, &e->sg, e->len, iv);
+		luacrypto_batch_add(&batch, &e->entry);
+		luacrypto_batch_submitted(&e->entry, op(e->request));
+	}
+	luacrypto_batch_wait(&batch);
+
+	for (i = 0; i < n; i++)
+		skcipher_request_free(entries[i].request);
+
+	lua_createtable(L, (int)n, 0);
+	for (i = 0; i < n; i++)
+		luacrypto_batch_pushresult(L, i + 1, &entries[i].entry, out + entries[i].offset, entries[i].len);
+	return 1;
+}
+
+/***
+* Encrypts many plaintexts in a single call.
+* All requests are submitted at once and then waited for; thus, asynchronous
+* implementations (e.g., `cryptd` or hardware engines) process them in parallel.
+* @function encrypt_batch
+* @tparam table ivs An array of Initialization Vectors, one per plaintext.
+* @tparam table plaintexts An array of strings to encrypt.
+* @treturn table An array with the ciphertext of each plaintext or, if its encryption has failed, its error code.
+* @raise Error on allocation failure, incorrect IV length or if the arrays are malformed.
+* @usage
+*   for i, ciphertext in ipairs(cipher:encrypt_batch(ivs, records)) do send(i, ciphertext) end
+*/
+static int luacrypto_skcipher_encrypt_batch(lua_State *L) {
+	return luacrypto_skcipher_batch(L, crypto_skcipher_encrypt);
+}
+
+/***
+* Decrypts many ciphertexts in a single call.
+* @function decrypt_batch
+* @tparam table ivs An array of Initialization Vectors, one per ciphertext.
+* @tparam table ciphertexts An array of strings to decrypt.
+* @treturn table An array with the plaintext of each ciphertext or, if its decryption has failed, its error code.
+* @raise Error on allocation failure, incorrect IV length or if the arrays are malformed.
+* @see encrypt_batch
+*/
+static int luacrypto_skcipher_decrypt_batch(lua_State *L) {
+	return luacrypto_skcipher_batch(L, crypto_skcipher_decrypt);
+}
+
 /***
 * Lua C methods for the SKCIPHER TFM object.
 * Includes cryptographic operations and Lunatik metamethods.
@@ -168,12 +327,35 @@ static const luaL_Reg luacrypto_skcipher_mt[] = {
 	{"blocksize", luacrypto_skcipher_blocksize},
 	{"encrypt", luacrypto_skcipher_encrypt},
 	{"decrypt", luacrypto_skcipher_decrypt},
+	{"encrypt_into", luacrypto_skcipher_encrypt_into},
+	{"decrypt_into", luacrypto_skcipher_decrypt_into},
+	{"encrypt_batch", luacrypto_skcipher_encrypt_batch},
+	{"decrypt_batch", luacrypto_skcipher_decrypt_batch},
 	{"__gc", lunatik_deleteobject},
 	{"__close", lunatik_closeobject},
 	{"__index", lunatik_monitorobject},
 	{NULL, NULL}
 };
 
+/***
+* Lua C methods for per-CPU SKCIPHER objects.
+* The same methods, but without the object lock and without `__close`, as
+* they are shared among runtimes; thus, they are released by their last reference.
+*/
+static const luaL_Reg luacrypto_skcipher_percpu_mt[] = {
+	{"setkey", luacrypto_skcipher_setkey},
+	{"ivsize", luacrypto_skcipher_ivsize},
+	{"blocksize", luacrypto_skcipher_blocksize},
+	{"encrypt", luacrypto_skcipher_encrypt},
+	{"decrypt", luacrypto_skcipher_decrypt},
+	{"encrypt_into", luacrypto_skcipher_encrypt_into},
+	{"decrypt_into", luacrypto_skcipher_decrypt_into},
+	{"encrypt_batch", luacrypto_skcipher_encrypt_batch},
+	{"decrypt_batch", luacrypto_skcipher_decrypt_batch},
+	{"__gc", lunatik_deleteobject},
+	{NULL, NULL}
+};
+
 /***
 * Lunatik class definition for SKCIPHER TFM objects.
 * This structure binds the C implementation (luacrypto_skcipher_t, methods, release function)
@@ -188,11 +370,22 @@ static const lunatik_class_t luacrypto_skcipher_class = {
 	.pointer = true,
 };
 
+static const lunatik_class_t luacrypto_skcipher_percpu_class = {
+	.name = "crypto_skcipher_percpu",
+	.methods = luacrypto_skcipher_percpu_mt,
+	.release = luacrypto_skcipher_releasepercpu,
+	.sleep = true,
+	.pointer = true,
+};
+
 /***
 * Creates a new SKCIPHER transform (TFM) object.
 * This is the constructor function for the `crypto_skcipher` module.
 * @function new
 * @tparam string algname The name of the skcipher algorithm (e.g., "cbc(aes)", "ctr(aes)").
+* @tparam[opt] boolean percpu If `true`, creates a per-CPU object, holding a transform
+*   for each CPU, which can be used concurrently by multiple runtimes without locking.
+*   Its key must be set before sharing it.
 * @treturn skcipher The new SKCIPHER TFM object.
 * @raise Error if the TFM object or kernel request cannot be allocated/initialized.
 * @usage
@@ -200,14 +393,40 @@ static const lunatik_class_t luacrypto_skcipher_class = {
 *   local cipher = skcipher.new("cbc(aes)")
 * @within skcipher
 */
-LUACRYPTO_NEW(skcipher, struct crypto_skcipher, crypto_alloc_skcipher, luacrypto_skcipher_class, NULL);
+static luacrypto_skcipher_t *luacrypto_skcipher_new_request(lua_State *L, struct crypto_skcipher *tfm)
+{
+	luacrypto_skcipher_t *skcipher = lunatik_malloc(L, struct_size(skcipher, iv, crypto_skcipher_ivsize(tfm)));
+
+	if (skcipher == NULL || (skcipher->request = skcipher_request_alloc(tfm, GFP_KERNEL)) == NULL) {
+		lunatik_free(skcipher);
+		crypto_free_skcipher(tfm);
+		luaL_error(L, "not enough memory");
+	}
+	crypto_init_wait(&skcipher->wait);
+	skcipher_request_set_callback(skcipher->request, CRYPTO_TFM_REQ_MAY_BACKLOG, crypto_req_done, &skcipher->wait);
+	return skcipher;
+}
+
+LUACRYPTO_NEW(skcipher, struct crypto_skcipher, crypto_alloc_skcipher, luacrypto_skcipher_class, luacrypto_skcipher_new_request);
+LUACRYPTO_NEWPERCPU(skcipher, struct crypto_skcipher, crypto_alloc_skcipher, luacrypto_skcipher_new_request);
+
+static int luacrypto_skcipher_lnew(lua_State *L)
+{
+	return lua_toboolean(L, 2) ? luacrypto_skcipher_newpercpu(L) : luacrypto_skcipher_new(L);
+}
 
 static const luaL_Reg luacrypto_skcipher_lib[] = {
-	{"new", luacrypto_skcipher_new},
+	{"new", luacrypto_skcipher_lnew},
+	{NULL, NULL}
+};
+
+static const luaL_Reg luacrypto_skcipher_percpu_lib[] = {
+	{"new", luacrypto_skcipher_newpercpu},
 	{NULL, NULL}
 };
 
 LUNATIK_NEWLIB(crypto_skcipher, luacrypto_skcipher_lib, &luacrypto_skcipher_class, NULL);
+LUNATIK_NEWLIB(crypto_skcipher_percpu, luacrypto_skcipher_percpu_lib, &luacrypto_skcipher_percpu_class, NULL);
 
 static int __init luacrypto_skcipher_init(void)
 {
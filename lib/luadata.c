@@ -410,6 +410,35 @@ int luadata_reset(lunatik_object_t *object, void *ptr, size_t size, uint8_t opt)
 }
 EXPORT_SYMBOL(luadata_reset);
 
+void *luadata_checkptr(lua_State *L, int ix, size_t *size, bool writable)
+{
+	lunatik_object_t *object = *(lunatik_object_t **)luaL_checkudata(L, ix, luadata_class.name);
+	luadata_t *data;
+
+	lunatik_argchecknull(L, object, ix);
+	data = (luadata_t *)object->private;
+	lunatik_argchecknull(L, data, ix);
+	if (writable)
+		luaL_argcheck(L, !(data->opt & LUADATA_OPT_READONLY), ix, "read only");
+
+	*size = data->size;
+	return data->ptr;
+}
+EXPORT_SYMBOL(luadata_checkptr);
+
+void *luadata_checkrange(lua_State *L, int ix, size_t *length, bool writable)
+{
+	size_t size;
+	char *ptr = (char *)luadata_checkptr(L, ix, &size, writable);
+	lua_Integer offset = luaL_optinteger(L, ix + 1, 0);
+	lua_Integer len = luaL_optinteger(L, ix + 2, (lua_Integer)size - offset);
+
+	luadata_checkbounds(L, ix + 1, size, offset, len);
+	*length = (size_t)len;
+	return ptr + offset;
+}
+EXPORT_SYMBOL(luadata_checkrange);
+
 static int __init luadata_init(void)
 {
 	return 0;
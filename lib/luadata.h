@@ -20,6 +20,12 @@ LUNATIK_LIB(data);
 lunatik_object_t *luadata_new(lua_State *L);
 int luadata_reset(lunatik_object_t *object, void *ptr, size_t size, uint8_t opt);
 
+/* returns the memory of the data object at index ix */
+void *luadata_checkptr(lua_State *L, int ix, size_t *size, bool writable);
+
+/* same as above, but restricted by the optional offset and length at ix + 1 and ix + 2 */
+void *luadata_checkrange(lua_State *L, int ix, size_t *length, bool writable);
+
 static inline void luadata_close(lunatik_object_t *object)
 {
 	luadata_clear(object);
@@ -0,0 +1,297 @@
+/*
+* SPDX-FileCopyrightText: (c) 2025 Ring Zero Desenvolvimento de Software LTDA
+* SPDX-License-Identifier: MIT OR GPL-2.0-only
+*/
+
+/***
+* Deferred execution on another runtime.
+* This library allows atomic runtimes (e.g., Netfilter, XDP or probe hooks) to
+* hand work over to a (typically sleepable) runtime, which can then use
+* sleepable APIs, such as sockets, file I/O or `GFP_KERNEL` allocation.
+*
+* Calls are queued, without locking, on per-CPU lists and drained by a work
+* item in process context; all calls pending when the work runs are executed
+* in a batch, holding the target runtime lock once. Each per-CPU list is
+* bounded; calls beyond that bound are dropped and counted.
+*
+* The target runtime script must return a table of functions; a call named
+* `"f"` calls the function `f` of this table. Arguments might be nil, booleans,
+* integers, strings or Lunatik objects (passed by reference).
+*
+* @module defer
+* @see pool
+*/
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/percpu.h>
+#include <linux/llist.h>
+#include <linux/workqueue.h>
+
+#include <lua.h>
+#include <lualib.h>
+#include <lauxlib.h>
+
+#include <lunatik.h>
+
+#include "luajob.h"
+
+#define LUADEFER_MAX	(1024)
+
+typedef struct luadefer_queue_s {
+	struct llist_head jobs;
+	atomic_t size;
+} luadefer_queue_t;
+
+/***
+* Represents a deferred call queue bound to a target runtime.
+* This is a userdata object returned by `defer.new()`.
+* @type defer
+*/
+typedef struct luadefer_s {
+	struct work_struct work;
+	lunatik_object_t *object;
+	lunatik_object_t *runtime;
+	luadefer_queue_t __percpu *queues;
+	int max;
+	atomic_long_t queued;
+	atomic_long_t executed;
+	atomic_long_t failed;
+	atomic_long_t dropped;
+	atomic_long_t batches;
+} luadefer_t;
+
+static int luadefer_new(lua_State *L);
+
+LUNATIK_PRIVATECHECKER(luadefer_check, luadefer_t *);
+
+static int luadefer_handler(lua_State *L, luadefer_t *defer, struct llist_node *batch)
+{
+	luajob_t *job, *next;
+
+	llist_for_each_entry_safe(job, next, batch, node) {
+		atomic_long_inc(luajob_run(L, job) == 0 ? &defer->executed : &defer->failed);
+		luajob_free(job);
+	}
+	return 0;
+}
+
+static void luadefer_free(struct llist_node *batch)
+{
+	luajob_t *job, *next;
+
+	llist_for_each_entry_safe(job, next, batch, node)
+		luajob_free(job);
+}
+
+static struct llist_node *luadefer_drain(luadefer_t *defer)
+{
+	struct llist_node *batch = NULL;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		luadefer_queue_t *queue = per_cpu_ptr(defer->queues, cpu);
+		struct llist_node *jobs = llist_del_all(&queue->jobs);
+		struct llist_node *last;
+		int n = 0;
+
+		if (jobs == NULL)
+			continue;
+
+		jobs = llist_reverse_order(jobs); /* FIFO per CPU */
+		for (last = jobs; ; last = last->next) {
+			n++;
+			if (last->next == NULL)
+				break;
+		}
+		atomic_sub(n, &queue->size);
+
+		last->next = batch;
+		batch = jobs;
+	}
+	return batch;
+}
+
+static void luadefer_work(struct work_struct *work)
+{
+	luadefer_t *defer = container_of(work, luadefer_t, work);
+	lunatik_object_t *object = defer->object;
+	struct llist_node *batch = luadefer_drain(defer);
+
+	if (batch != NULL) {
+		int ret;
+
+		atomic_long_inc(&defer->batches);
+		lunatik_run(defer->runtime, luadefer_handler, ret, defer, batch);
+		if (ret == -ENXIO) /* runtime has been stopped */
+			luadefer_free(batch);
+	}
+	lunatik_putobject(object); /* taken by call() */
+}
+
+/***
+* Queues a call to a function of the target runtime.
+* It never sleeps; thus, it can be called from atomic runtimes.
+* @function call
+* @tparam string name The name of the function, in the table returned by the target script.
+* @param ... Arguments passed to the function. They must be nil, booleans, integers,
+*   strings or Lunatik objects.
+* @treturn boolean `true` if the call was queued, `false` if it was dropped
+*   (because the queue was full or memory allocation failed).
+* @raise Error if an argument has an unsupported type.
+* @usage
+*   -- inside a netfilter hook
+*   d:call("log", src, dst, #payload)
+*/
+static int luadefer_call(lua_State *L)
+{
+	luadefer_t *defer = luadefer_check(L, 1);
+	luadefer_queue_t *queue;
+	luajob_t *job;
+	bool queued = false;
+
+	luaL_checktype(L, 2, LUA_TSTRING);
+	if ((job = luajob_new(L, 2, lua_gettop(L) - 1, GFP_ATOMIC)) == NULL)
+		goto out;
+
+	queue = get_cpu_ptr(defer->queues);
+	if (atomic_inc_return(&queue->size) > defer->max) {
+		atomic_dec(&queue->size);
+		put_cpu_ptr(defer->queues);
+		luajob_free(job);
+		goto out;
+	}
+	llist_add(&job->node, &queue->jobs);
+	put_cpu_ptr(defer->queues);
+
+	atomic_long_inc(&defer->queued);
+	lunatik_getobject(defer->object);
+	if (!queue_work(system_unbound_wq, &defer->work))
+		lunatik_putobject(defer->object); /* already pending */
+	queued = true;
+out:
+	if (!queued)
+		atomic_long_inc(&defer->dropped);
+	lua_pushboolean(L, queued);
+	return 1;
+}
+
+/***
+* Gets the queue statistics.
+* @function stats
+* @treturn table A table with the following fields:
+*   @tfield integer queued The number of queued calls.
+*   @tfield integer executed The number of calls that have run successfully.
+*   @tfield integer failed The number of calls that have raised an error.
+*   @tfield integer dropped The number of dropped calls.
+*   @tfield integer batches The number of batches (i.e., work executions).
+*/
+static int luadefer_stats(lua_State *L)
+{
+	luadefer_t *defer = luadefer_check(L, 1);
+
+	lua_createtable(L, 0, 5);
+	lua_pushinteger(L, (lua_Integer)atomic_long_read(&defer->queued));
+	lua_setfield(L, -2, "queued");
+	lua_pushinteger(L, (lua_Integer)atomic_long_read(&defer->executed));
+	lua_setfield(L, -2, "executed");
+	lua_pushinteger(L, (lua_Integer)atomic_long_read(&defer->failed));
+	lua_setfield(L, -2, "failed");
+	lua_pushinteger(L, (lua_Integer)atomic_long_read(&defer->dropped));
+	lua_setfield(L, -2, "dropped");
+	lua_pushinteger(L, (lua_Integer)atomic_long_read(&defer->batches));
+	lua_setfield(L, -2, "batches");
+	return 1;
+}
+
+static void luadefer_release(void *private)
+{
+	luadefer_t *defer = (luadefer_t *)private;
+
+	/* pending work holds a reference; hence, there is no work to cancel here */
+	if (defer->queues != NULL) {
+		luadefer_free(luadefer_drain(defer));
+		free_percpu(defer->queues);
+	}
+	if (defer->runtime != NULL)
+		lunatik_putobject(defer->runtime);
+}
+
+static const luaL_Reg luadefer_lib[] = {
+	{"new", luadefer_new},
+	{NULL, NULL}
+};
+
+static const luaL_Reg luadefer_mt[] = {
+	{"__gc", lunatik_deleteobject},
+	{"call", luadefer_call},
+	{"stats", luadefer_stats},
+	{NULL, NULL}
+};
+
+static const lunatik_class_t luadefer_class = {
+	.name = "defer",
+	.methods = luadefer_mt,
+	.release = luadefer_release,
+	.sleep = false,
+};
+
+/***
+* Creates a new deferred call queue.
+* @function new
+* @tparam runtime runtime The target runtime, whose script returns a table of functions.
+* @tparam[opt=1024] integer max The maximum number of pending calls per CPU.
+* @treturn defer A new defer object.
+* @raise Error if `runtime` isn't a runtime or if memory allocation fails.
+* @usage
+*   -- main script (sleepable)
+*   local logger = lunatik.runtime("examples/logger")
+*   local d = defer.new(logger)
+*   -- d can now be shared with an atomic runtime (e.g., using rcu)
+* @within defer
+*/
+static int luadefer_new(lua_State *L)
+{
+	lunatik_object_t *runtime = lunatik_checkruntime(L, 1);
+	lua_Integer max = luaL_optinteger(L, 2, LUADEFER_MAX);
+	lunatik_object_t *object;
+	luadefer_t *defer;
+	int cpu;
+
+	lunatik_checkbounds(L, 2, max, 1, INT_MAX);
+	object = lunatik_newobject(L, &luadefer_class, sizeof(luadefer_t));
+	defer = (luadefer_t *)object->private;
+	memset(defer, 0, sizeof(luadefer_t));
+
+	INIT_WORK(&defer->work, luadefer_work);
+	defer->object = object;
+	defer->max = (int)max;
+	defer->queues = lunatik_checknull(L, alloc_percpu_gfp(luadefer_queue_t, lunatik_toruntime(L)->gfp));
+	for_each_possible_cpu(cpu) {
+		luadefer_queue_t *queue = per_cpu_ptr(defer->queues, cpu);
+		init_llist_head(&queue->jobs);
+		atomic_set(&queue->size, 0);
+	}
+
+	lunatik_getobject(runtime);
+	defer->runtime = runtime;
+	return 1; /* object */
+}
+
+LUNATIK_NEWLIB(defer, luadefer_lib, &luadefer_class, NULL);
+
+static int __init luadefer_init(void)
+{
+	return 0;
+}
+
+static void __exit luadefer_exit(void)
+{
+}
+
+module_init(luadefer_init);
+module_exit(luadefer_exit);
+MODULE_LICENSE("Dual MIT/GPL");
+MODULE_AUTHOR("Lourival Vieira Neto <lourival.neto@ring-0.io>");
+
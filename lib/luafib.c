@@ -4,25 +4,33 @@
 */
 
 /***
-* Forwarding Information Base (FIB) rules.
+* Forwarding Information Base (FIB) rules and routes.
 * This library allows Lua scripts to add and delete FIB rules, similar to the
 * user-space `ip rule add` and `ip rule del` commands.
 * FIB rules are used to influence routing decisions by selecting different
 * routing tables based on various criteria.
 *
+* It also allows Lua scripts to look up IPv4 routes, similar to `ip route get`,
+* and to add and delete many IPv4 routes at once, similar to `ip -batch`.
+* Addresses are integers in host byte order (see `net.aton`).
+*
 * @module fib
 */
 #define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
 #include <linux/kernel.h>
 #include <linux/module.h>
 #include <linux/version.h>
+#include <linux/rtnetlink.h>
 #include <net/fib_rules.h>
+#include <net/ip_fib.h>
 
 #include <lua.h>
 #include <lauxlib.h>
 
 #include <lunatik.h>
 
+#define LUAFIB_MAXROUTES	(4096)
+
 #define luafib_nl_sizeof(t)	(nla_total_size(sizeof(t)))
 
 #define LUAFIB_NL_SIZE	(NLMSG_ALIGN(sizeof(struct fib_rule_hdr)) 	\
@@ -134,9 +142,233 @@ LUAFIB_OPRULE(newrule);
 */
 LUAFIB_OPRULE(delrule);
 
+/***
+* Looks up the route to a destination.
+* This function binds the kernel `fib_lookup` API, applying the FIB rules.
+*
+* @function lookup
+* @tparam integer dst The destination address.
+* @tparam[opt=0] integer src The source address.
+* @tparam[opt=0] integer oif The output interface index.
+* @tparam[opt=0] integer mark The packet mark.
+* @treturn integer The next hop address (gateway), or 0 if the destination is directly connected.
+* @treturn integer The output interface index.
+* @treturn integer The routing table identifier of the route.
+* @treturn nil If there is no route to the destination.
+* @usage
+*   local gateway, oif, table = fib.lookup(net.aton("8.8.8.8"))
+*/
+static int luafib_lookup(lua_State *L)
+{
+	struct net *net = &init_net;
+	struct flowi4 fl4;
+	struct fib_result res;
+	u32 gateway = 0, table = RT_TABLE_MAIN;
+	int oif = 0;
+
+	memset(&fl4, 0, sizeof(fl4));
+	fl4.daddr = cpu_to_be32((u32)luaL_checkinteger(L, 1));
+	fl4.saddr = cpu_to_be32((u32)luaL_optinteger(L, 2, 0));
+	fl4.flowi4_oif = (int)luaL_optinteger(L, 3, 0);
+	fl4.flowi4_mark = (u32)luaL_optinteger(L, 4, 0);
+	/* as an output route lookup (e.g., ip_route_output_key) */
+	fl4.flowi4_iif = LOOPBACK_IFINDEX;
+	fl4.flowi4_scope = RT_SCOPE_UNIVERSE;
+
+	rcu_read_lock();
+	if (fib_lookup(net, &fl4, &res, FIB_LOOKUP_NOREF) != 0) {
+		rcu_read_unlock();
+		lua_pushnil(L);
+		return 1;
+	}
+
+	if (res.table)
+		table = res.table->tb_id;
+	if (res.fi) {
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(5, 3, 0))
+		struct fib_nh_common *nhc = FIB_RES_NHC(res);
+
+		if (nhc->nhc_gw_family == AF_INET)
+			gateway = be32_to_cpu(nhc->nhc_gw.ipv4);
+		if (nhc->nhc_dev)
+			oif = nhc->nhc_dev->ifindex;
+#else
+		gateway = be32_to_cpu(FIB_RES_GW(res));
+		if (FIB_RES_DEV(res))
+			oif = FIB_RES_DEV(res)->ifindex;
+#endif
+	}
+	rcu_read_unlock();
+
+	lua_pushinteger(L, (lua_Integer)gateway);
+	lua_pushinteger(L, (lua_Integer)oif);
+	lua_pushinteger(L, (lua_Integer)table);
+	return 3;
+}
+
+typedef int (*luafib_table_op_t)(struct net *, struct fib_table *, struct fib_config *, struct netlink_ext_ack *);
+typedef struct fib_table *(*luafib_table_get_t)(struct net *, u32);
+
+/* not exported; resolved on module load */
+static luafib_table_op_t luafib_table_insert;
+static luafib_table_op_t luafib_table_delete;
+static luafib_table_get_t luafib_new_table;
+static luafib_table_get_t luafib_get_table;
+
+static lua_Integer luafib_getfield(lua_State *L, int ix, const char *field, lua_Integer def)
+{
+	lua_Integer value = def;
+	int type = lua_getfield(L, ix, field);
+
+	if (type != LUA_TNIL) {
+		if (!lua_isinteger(L, -1))
+			luaL_error(L, "route field '%s' must be an integer", field);
+		value = lua_tointeger(L, -1);
+	}
+	lua_pop(L, 1);
+	return value;
+}
+
+static void luafib_checkroute(lua_State *L, int ix, struct fib_config *cfg, bool add)
+{
+	u32 gateway = (u32)luafib_getfield(L, ix, "gateway", 0);
+	lua_Integer len = luafib_getfield(L, ix, "len", 32);
+
+	if (len < 0 || len > 32)
+		luaL_error(L, "route field 'len' out of bounds");
+
+	memset(cfg, 0, sizeof(*cfg));
+	cfg->fc_dst = cpu_to_be32((u32)luafib_getfield(L, ix, "dst", 0));
+	cfg->fc_dst_len = (int)len;
+	cfg->fc_oif = (int)luafib_getfield(L, ix, "oif", 0);
+	cfg->fc_table = (u32)luafib_getfield(L, ix, "table", RT_TABLE_MAIN);
+	cfg->fc_priority = (u32)luafib_getfield(L, ix, "priority", 0);
+	cfg->fc_type = RTN_UNICAST;
+	cfg->fc_nlinfo.nl_net = &init_net;
+
+	if (gateway) {
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(5, 3, 0))
+		cfg->fc_gw_family = AF_INET;
+		cfg->fc_gw4 = cpu_to_be32(gateway);
+#else
+		cfg->fc_gw = cpu_to_be32(gateway);
+#endif
+	}
+
+	if (add) {
+		cfg->fc_protocol = RTPROT_STATIC;
+		cfg->fc_scope = gateway ? RT_SCOPE_UNIVERSE : RT_SCOPE_LINK;
+		lua_getfield(L, ix, "replace");
+		cfg->fc_nlflags = NLM_F_CREATE | (lua_toboolean(L, -1) ? NLM_F_REPLACE : NLM_F_EXCL);
+		lua_pop(L, 1);
+	}
+	else
+		cfg->fc_scope = RT_SCOPE_NOWHERE; /* matches any scope */
+}
+
+static int luafib_route(struct fib_config *cfg, bool add)
+{
+	struct net *net = cfg->fc_nlinfo.nl_net;
+	struct fib_table *tb;
+
+	if (add)
+		return (tb = luafib_new_table(net, cfg->fc_table)) == NULL ? -ENOBUFS :
+			luafib_table_insert(net, tb, cfg, NULL);
+
+	return (tb = luafib_get_table(net, cfg->fc_table)) == NULL ? -ESRCH :
+		luafib_table_delete(net, tb, cfg, NULL);
+}
+
+static int luafib_routes(lua_State *L, bool add)
+{
+	struct fib_config *cfgs;
+	int *rets;
+	lua_Integer n, i;
+
+	luaL_checktype(L, 1, LUA_TTABLE);
+	n = luaL_len(L, 1);
+	lunatik_checkbounds(L, 1, n, 1, LUAFIB_MAXROUTES);
+	if (luafib_table_insert == NULL)
+		luaL_error(L, "route programming is not supported on this kernel");
+
+	/* parses all routes before taking the RTNL lock; userdata is collected on errors */
+	cfgs = (struct fib_config *)lua_newuserdatauv(L, n * sizeof(struct fib_config), 0);
+	rets = (int *)lua_newuserdatauv(L, n * sizeof(int), 0);
+	for (i = 0; i < n; i++) {
+		luaL_argcheck(L, lua_rawgeti(L, 1, i + 1) == LUA_TTABLE, 1, "array of routes expected");
+		luafib_checkroute(L, -1, &cfgs[i], add);
+		lua_pop(L, 1);
+	}
+
+	rtnl_lock();
+	for (i = 0; i < n; i++)
+		rets[i] = luafib_route(&cfgs[i], add);
+	rtnl_unlock();
+
+	lua_createtable(L, (int)n, 0);
+	for (i = 0; i < n; i++) {
+		lua_pushinteger(L, -rets[i]);
+		lua_rawseti(L, -2, i + 1);
+	}
+	return 1;
+}
+
+/***
+* Adds many IPv4 routes at once.
+* All routes are added under a single acquisition of the RTNL lock. Each
+* route is a table with the following (optional) fields:
+*
+*   - `dst`: the destination address (defaults to 0);
+*   - `len`: the destination prefix length (defaults to 32);
+*   - `gateway`: the next hop address (defaults to none; i.e., a link route);
+*   - `oif`: the output interface index;
+*   - `table`: the routing table identifier (defaults to 254, the main table);
+*   - `priority`: the route metric (defaults to 0);
+*   - `replace`: if true, replaces an existing route instead of failing.
+*
+* Routes are added with the `RTPROT_STATIC` protocol.
+*
+* @function newroutes
+* @tparam table routes An array of routes (up to 4096).
+* @treturn table An array holding, for each route, 0 on success or a positive errno
+*   (e.g., `linux.errno.EXIST`) on failure.
+* @raise Error if a route is malformed (in which case no route is added).
+* @usage
+*   local results = fib.newroutes{
+*     {dst = net.aton("10.1.0.0"), len = 16, gateway = net.aton("192.168.0.1"), table = 100},
+*     {dst = net.aton("10.2.0.0"), len = 16, oif = 2, table = 100},
+*   }
+*/
+static int luafib_newroutes(lua_State *L)
+{
+	return luafib_routes(L, true);
+}
+
+/***
+* Deletes many IPv4 routes at once.
+* All routes are deleted under a single acquisition of the RTNL lock. Routes
+* are described as in `newroutes`; omitted `gateway`, `oif` and `priority`
+* match any route.
+*
+* @function delroutes
+* @tparam table routes An array of routes (up to 4096).
+* @treturn table An array holding, for each route, 0 on success or a positive errno
+*   (e.g., `linux.errno.SRCH` if there is no such route) on failure.
+* @raise Error if a route is malformed (in which case no route is deleted).
+* @usage
+*   fib.delroutes{{dst = net.aton("10.1.0.0"), len = 16, table = 100}}
+*/
+static int luafib_delroutes(lua_State *L)
+{
+	return luafib_routes(L, false);
+}
+
 static const luaL_Reg luafib_lib[] = {
 	{"newrule", luafib_newrule},
 	{"delrule", luafib_delrule},
+	{"lookup", luafib_lookup},
+	{"newroutes", luafib_newroutes},
+	{"delroutes", luafib_delroutes},
 	{NULL, NULL}
 };
 
@@ -148,6 +380,20 @@ LUNATIK_NEWLIB(fib, luafib_lib, &luafib_class, NULL);
 
 static int __init luafib_init(void)
 {
+	luafib_table_insert = (luafib_table_op_t)lunatik_lookup("fib_table_insert");
+	luafib_table_delete = (luafib_table_op_t)lunatik_lookup("fib_table_delete");
+#ifdef CONFIG_IP_MULTIPLE_TABLES
+	luafib_new_table = (luafib_table_get_t)lunatik_lookup("fib_new_table");
+	luafib_get_table = (luafib_table_get_t)lunatik_lookup("fib_get_table");
+#else
+	luafib_new_table = fib_new_table;
+	luafib_get_table = fib_get_table;
+#endif
+	/* rules and lookups don't depend on them */
+	if (!luafib_table_insert || !luafib_table_delete || !luafib_new_table || !luafib_get_table) {
+		pr_warn("FIB table symbols not found, route programming disabled\n");
+		luafib_table_insert = NULL;
+	}
 	return 0;
 }
 
@@ -51,7 +51,8 @@ static int luafifo_push(lua_State *L)
 * Pops data from the FIFO.
 * Retrieves a specified number of bytes from the FIFO.
 * @function pop
-* @tparam integer size The maximum number of bytes to retrieve from the FIFO.
+* @tparam[opt] integer size The maximum number of bytes to retrieve from the FIFO.
+*   If omitted, retrieves all bytes available.
 * @treturn string A string containing the bytes popped from the FIFO. The actual length of this string might be less than `size` if the FIFO contained fewer bytes.
 * @treturn integer The actual number of bytes popped from the FIFO.
 * @usage
@@ -65,7 +66,7 @@ static int luafifo_push(lua_State *L)
 static int luafifo_pop(lua_State *L)
 {
 	struct kfifo *fifo = luafifo_check(L, 1);
-	size_t size = luaL_checkinteger(L, 2);
+	size_t size = luaL_optinteger(L, 2, kfifo_len(fifo));
 	luaL_Buffer B;
 	char *lbuf = luaL_buffinitsize(L, &B, size);
 
@@ -0,0 +1,362 @@
+/*
+* SPDX-FileCopyrightText: (c) 2025 Ring Zero Desenvolvimento de Software LTDA
+* SPDX-License-Identifier: MIT OR GPL-2.0-only
+*/
+
+/***
+* IPv4 and IPv6 addresses and prefixes.
+* This library parses and formats addresses in C (using the kernel's
+* `in4_pton`, `in6_pton` and `%pI` formats) and provides prefix objects, which
+* match addresses, either given as values or read straight from data objects
+* (e.g., packets), without creating intermediate Lua values.
+*
+* Addresses are either binary strings in network byte order (4 bytes for IPv4,
+* 16 bytes for IPv6), as returned by `pton`, or, for IPv4 only, integers in
+* host byte order, as returned by `aton`.
+*
+* Prefixes are immutable; thus, they can be created once (e.g., when the
+* script is loaded) and shared among runtimes, including non-sleepable ones.
+*
+* @module inet
+* @see net
+*/
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/inet.h>
+#include <linux/in6.h>
+#include <linux/string.h>
+
+#include <lua.h>
+#include <lualib.h>
+#include <lauxlib.h>
+
+#include <lunatik.h>
+
+#include "luadata.h"
+
+#define LUAINET_IN4	(sizeof(struct in_addr))
+#define LUAINET_IN6	(sizeof(struct in6_addr))
+
+typedef union luainet_addr_u {
+	__be32 in4;
+	u64 in6[2];
+	u8 bytes[LUAINET_IN6];
+} luainet_addr_t;
+
+/***
+* Represents an IPv4 or IPv6 prefix (e.g., "10.0.0.0/8").
+* This is a userdata object returned by `inet.prefix()`.
+* @type prefix
+*/
+typedef struct luainet_prefix_s {
+	luainet_addr_t addr; /* masked */
+	luainet_addr_t mask;
+	size_t size; /* of the address, in bytes */
+	unsigned int len; /* of the prefix, in bits */
+} luainet_prefix_t;
+
+static int luainet_prefix(lua_State *L);
+
+LUNATIK_PRIVATECHECKER(luainet_check, luainet_prefix_t *);
+
+/* parses text into a binary address; returns its size or 0 if invalid */
+static size_t luainet_parse(const char *text, size_t len, u8 *addr)
+{
+	const char *end;
+
+	if (memchr(text, ':', len) != NULL)
+		return in6_pton(text, len, addr, -1, &end) && end == text + len ? LUAINET_IN6 : 0;
+	return in4_pton(text, len, addr, -1, &end) && end == text + len ? LUAINET_IN4 : 0;
+}
+
+static inline void luainet_format(lua_State *L, const u8 *addr, size_t size)
+{
+	char text[INET6_ADDRSTRLEN];
+	int len = size == LUAINET_IN4 ? snprintf(text, sizeof(text), "%pI4", addr) :
+		snprintf(text, sizeof(text), "%pI6c", addr);
+
+	lua_pushlstring(L, text, len);
+}
+
+/* checks an address, given as a binary string or as an IPv4 integer, of the prefix's family */
+static const u8 *luainet_checkaddr(lua_State *L, int ix, const luainet_prefix_t *prefix, luainet_addr_t *addr)
+{
+	size_t size;
+	const char *bytes;
+
+	if (lua_isinteger(L, ix)) {
+		luaL_argcheck(L, prefix->size == LUAINET_IN4, ix, "IPv6 address expected");
+		addr->in4 = cpu_to_be32((u32)lua_tointeger(L, ix));
+		return addr->bytes;
+	}
+	bytes = luaL_checklstring(L, ix, &size);
+	luaL_argcheck(L, size == prefix->size, ix, "address of another family");
+	return (const u8 *)bytes;
+}
+
+static inline bool luainet_match(const luainet_prefix_t *prefix, const u8 *bytes)
+{
+	luainet_addr_t addr;
+
+	if (prefix->size == LUAINET_IN4) {
+		memcpy(&addr.in4, bytes, LUAINET_IN4);
+		return ((addr.in4 ^ prefix->addr.in4) & prefix->mask.in4) == 0;
+	}
+	memcpy(addr.in6, bytes, LUAINET_IN6);
+	return (((addr.in6[0] ^ prefix->addr.in6[0]) & prefix->mask.in6[0]) |
+		((addr.in6[1] ^ prefix->addr.in6[1]) & prefix->mask.in6[1])) == 0;
+}
+
+/***
+* Checks whether the prefix contains an address.
+* @function contains
+* @tparam string|integer addr A binary address (see `pton`) or, for IPv4 prefixes, an integer (see `aton`).
+* @treturn boolean `true` if the address belongs to the prefix.
+* @raise Error if the address is of another family.
+* @usage
+*   local private = inet.prefix("10.0.0.0/8")
+*   private:contains(inet.aton("10.1.2.3")) -- true
+*/
+static int luainet_contains(lua_State *L)
+{
+	luainet_prefix_t *prefix = luainet_check(L, 1);
+	luainet_addr_t addr;
+
+	lua_pushboolean(L, luainet_match(prefix, luainet_checkaddr(L, 2, prefix, &addr)));
+	return 1;
+}
+
+/***
+* Checks whether the prefix contains the address stored at a data offset.
+* The address is read in network byte order (e.g., from an IP header).
+* @function match
+* @tparam data data The data object (e.g., a packet).
+* @tparam integer offset The offset of the address.
+* @treturn boolean `true` if the address belongs to the prefix.
+* @raise Error if the address is out of bounds.
+* @usage
+*   local server = inet.prefix("10.1.1.2")
+*   local function hook(skb)
+*     if server:match(skb, 16) then -- IPv4 destination address
+*       -- ...
+*     end
+*   end
+*/
+static int luainet_matchdata(lua_State *L)
+{
+	luainet_prefix_t *prefix = luainet_check(L, 1);
+	size_t size;
+	const u8 *bytes = (const u8 *)luadata_checkptr(L, 2, &size, false);
+	lua_Integer offset = luaL_checkinteger(L, 3);
+
+	luaL_argcheck(L, offset >= 0 && offset + prefix->size <= size, 3, "out of bounds");
+	lua_pushboolean(L, luainet_match(prefix, bytes + offset));
+	return 1;
+}
+
+/***
+* Gets the address and the length of the prefix.
+* @function unpack
+* @treturn string The (masked) binary address.
+* @treturn integer The prefix length, in bits.
+*/
+static int luainet_unpack(lua_State *L)
+{
+	luainet_prefix_t *prefix = luainet_check(L, 1);
+
+	lua_pushlstring(L, (const char *)prefix->addr.bytes, prefix->size);
+	lua_pushinteger(L, (lua_Integer)prefix->len);
+	return 2;
+}
+
+/***
+* Formats the prefix in CIDR notation (e.g., "10.0.0.0/8").
+* This is the Lua `__tostring` metamethod.
+* @function __tostring
+* @treturn string The textual prefix.
+*/
+static int luainet_tostring(lua_State *L)
+{
+	luainet_prefix_t *prefix = luainet_check(L, 1);
+
+	luainet_format(L, prefix->addr.bytes, prefix->size);
+	lua_pushfstring(L, "%s/%d", lua_tostring(L, -1), (int)prefix->len);
+	return 1;
+}
+
+/***
+* Parses a textual address.
+* @function pton
+* @tparam string text An IPv4 (e.g., "10.1.2.3") or IPv6 (e.g., "2001:db8::1") address.
+* @treturn string The binary address, in network byte order (4 or 16 bytes).
+* @treturn nil If `text` isn't a valid address.
+*/
+static int luainet_pton(lua_State *L)
+{
+	size_t len;
+	const char *text = luaL_checklstring(L, 1, &len);
+	luainet_addr_t addr;
+	size_t size = luainet_parse(text, len, addr.bytes);
+
+	if (size == 0)
+		lua_pushnil(L);
+	else
+		lua_pushlstring(L, (const char *)addr.bytes, size);
+	return 1;
+}
+
+/***
+* Formats a binary address.
+* @function ntop
+* @tparam string addr A binary address, in network byte order (4 or 16 bytes).
+* @treturn string The textual address (IPv6 addresses are compressed, e.g., "2001:db8::1").
+* @raise Error if `addr` isn't 4 or 16 bytes long.
+*/
+static int luainet_ntop(lua_State *L)
+{
+	size_t size;
+	const char *addr = luaL_checklstring(L, 1, &size);
+
+	luaL_argcheck(L, size == LUAINET_IN4 || size == LUAINET_IN6, 1, "invalid address length");
+	luainet_format(L, (const u8 *)addr, size);
+	return 1;
+}
+
+/***
+* Parses a textual IPv4 address into an integer.
+* @function aton
+* @tparam string text An IPv4 address (e.g., "192.168.1.1").
+* @treturn integer The address, in host byte order (e.g., 3232235777).
+* @treturn nil If `text` isn't a valid IPv4 address.
+*/
+static int luainet_aton(lua_State *L)
+{
+	size_t len;
+	const char *text = luaL_checklstring(L, 1, &len);
+	const char *end;
+	__be32 addr;
+
+	if (in4_pton(text, len, (u8 *)&addr, -1, &end) && end == text + len)
+		lua_pushinteger(L, (lua_Integer)be32_to_cpu(addr));
+	else
+		lua_pushnil(L);
+	return 1;
+}
+
+/***
+* Formats an IPv4 address given as an integer.
+* @function ntoa
+* @tparam integer addr The address, in host byte order.
+* @treturn string The textual address (e.g., "192.168.1.1").
+*/
+static int luainet_ntoa(lua_State *L)
+{
+	__be32 addr = cpu_to_be32((u32)luaL_checkinteger(L, 1));
+
+	luainet_format(L, (const u8 *)&addr, LUAINET_IN4);
+	return 1;
+}
+
+static const luaL_Reg luainet_lib[] = {
+	{"pton", luainet_pton},
+	{"ntop", luainet_ntop},
+	{"aton", luainet_aton},
+	{"ntoa", luainet_ntoa},
+	{"prefix", luainet_prefix},
+	{NULL, NULL}
+};
+
+static const luaL_Reg luainet_mt[] = {
+	{"__gc", lunatik_deleteobject},
+	{"__tostring", luainet_tostring},
+	{"contains", luainet_contains},
+	{"match", luainet_matchdata},
+	{"unpack", luainet_unpack},
+	{NULL, NULL}
+};
+
+static const lunatik_class_t luainet_class = {
+	.name = "inet",
+	.methods = luainet_mt,
+	.sleep = false,
+};
+
+static void luainet_setmask(luainet_prefix_t *prefix)
+{
+	unsigned int i;
+
+	memset(prefix->mask.bytes, 0, sizeof(prefix->mask.bytes));
+	for (i = 0; i < prefix->len / 8; i++)
+		prefix->mask.bytes[i] = 0xFF;
+	if (prefix->len % 8)
+		prefix->mask.bytes[i] = (u8)(0xFF << (8 - prefix->len % 8));
+
+	for (i = 0; i < prefix->size; i++)
+		prefix->addr.bytes[i] &= prefix->mask.bytes[i];
+}
+
+/***
+* Creates a new prefix.
+* @function prefix
+* @tparam string cidr A prefix in CIDR notation (e.g., "10.0.0.0/8" or "2001:db8::/32"), or an address
+*   (e.g., "10.1.1.2"), which is taken as a full-length prefix. Host bits are cleared.
+* @treturn prefix A new prefix object.
+* @raise Error if `cidr` isn't a valid prefix.
+* @usage
+*   local inet = require("inet")
+*   local docs = inet.prefix("2001:db8::/32")
+*   print(docs, docs:contains(inet.pton("2001:db8::1"))) -- 2001:db8::/32 true
+* @within inet
+*/
+static int luainet_prefix(lua_State *L)
+{
+	size_t len;
+	const char *cidr = luaL_checklstring(L, 1, &len);
+	const char *slash = memchr(cidr, '/', len);
+	size_t addrlen = slash ? (size_t)(slash - cidr) : len;
+	lunatik_object_t *object;
+	luainet_prefix_t *prefix;
+	luainet_addr_t addr;
+	unsigned int bits;
+	size_t size;
+
+	luaL_argcheck(L, (size = luainet_parse(cidr, addrlen, addr.bytes)) != 0, 1, "invalid address");
+	bits = size * 8;
+	if (slash) {
+		char text[sizeof("128")];
+		size_t n = len - addrlen - 1;
+
+		luaL_argcheck(L, n > 0 && n < sizeof(text), 1, "invalid prefix length");
+		memcpy(text, slash + 1, n);
+		text[n] = '\0';
+		luaL_argcheck(L, kstrtouint(text, 10, &bits) == 0 && bits <= size * 8, 1, "invalid prefix length");
+	}
+
+	object = lunatik_newobject(L, &luainet_class, sizeof(luainet_prefix_t));
+	prefix = (luainet_prefix_t *)object->private;
+	memset(prefix, 0, sizeof(luainet_prefix_t));
+	memcpy(prefix->addr.bytes, addr.bytes, size);
+	prefix->size = size;
+	prefix->len = bits;
+	luainet_setmask(prefix);
+	return 1; /* object */
+}
+
+LUNATIK_NEWLIB(inet, luainet_lib, &luainet_class, NULL);
+
+static int __init luainet_init(void)
+{
+	return 0;
+}
+
+static void __exit luainet_exit(void)
+{
+}
+
+module_init(luainet_init);
+module_exit(luainet_exit);
+MODULE_LICENSE("Dual MIT/GPL");
+MODULE_AUTHOR("Lourival Vieira Neto <lourival.neto@ring-0.io>");
+
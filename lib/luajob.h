@@ -0,0 +1,187 @@
+/*
+* SPDX-FileCopyrightText: (c) 2025 Ring Zero Desenvolvimento de Software LTDA
+* SPDX-License-Identifier: MIT OR GPL-2.0-only
+*/
+
+#ifndef luajob_h
+#define luajob_h
+
+#include <linux/list.h>
+#include <linux/llist.h>
+#include <linux/slab.h>
+
+#include <lunatik.h>
+
+/*
+* A job is a list of arguments copied out of a Lua state, so it can be queued
+* and later pushed into another runtime. Supported types are nil, boolean,
+* integer, string and Lunatik objects (which are passed by reference).
+*/
+
+typedef struct luajob_arg_s {
+	int type;
+	union {
+		bool boolean;
+		lua_Integer integer;
+		lunatik_object_t *object;
+		struct {
+			const char *ptr;
+			size_t len;
+		} string;
+	};
+} luajob_arg_t;
+
+typedef struct luajob_s {
+	union {
+		struct list_head list;
+		struct llist_node node;
+	};
+	int nargs;
+	luajob_arg_t args[];
+} luajob_t;
+
+/* checks the arguments and returns the size needed to store them */
+static inline size_t luajob_checkargs(lua_State *L, int ix, int nargs)
+{
+	size_t size = sizeof(luajob_t) + nargs * sizeof(luajob_arg_t);
+	int i;
+
+	for (i = ix; i < ix + nargs; i++) {
+		switch (lua_type(L, i)) {
+		case LUA_TNIL: case LUA_TBOOLEAN: case LUA_TNUMBER:
+			break;
+		case LUA_TSTRING:
+			size += lua_rawlen(L, i);
+			break;
+		case LUA_TUSERDATA:
+			luaL_argcheck(L, lunatik_testobject(L, i) != NULL, i, "invalid object");
+			break;
+		default:
+			luaL_argerror(L, i, "unsupported type");
+		}
+	}
+	return size;
+}
+
+static inline void luajob_copyargs(lua_State *L, luajob_t *job, int ix, int nargs)
+{
+	char *strings = (char *)&job->args[nargs];
+	int i;
+
+	job->nargs = nargs;
+	for (i = 0; i < nargs; i++) {
+		luajob_arg_t *arg = &job->args[i];
+
+		switch ((arg->type = lua_type(L, ix + i))) {
+		case LUA_TBOOLEAN:
+			arg->boolean = lua_toboolean(L, ix + i);
+			break;
+		case LUA_TNUMBER:
+			arg->integer = lua_tointeger(L, ix + i);
+			break;
+		case LUA_TSTRING: {
+			const char *str = lua_tolstring(L, ix + i, &arg->string.len);
+			memcpy(strings, str, arg->string.len);
+			arg->string.ptr = strings;
+			strings += arg->string.len;
+			break;
+		}
+		case LUA_TUSERDATA:
+			arg->object = lunatik_testobject(L, ix + i);
+			lunatik_getobject(arg->object);
+			break;
+		}
+	}
+}
+
+/* returns NULL if allocation fails; raises an error if any argument is invalid */
+static inline luajob_t *luajob_new(lua_State *L, int ix, int nargs, gfp_t gfp)
+{
+	size_t size = luajob_checkargs(L, ix, nargs);
+	luajob_t *job = (luajob_t *)kmalloc(size, gfp);
+
+	if (job != NULL)
+		luajob_copyargs(L, job, ix, nargs);
+	return job;
+}
+
+/* might raise an error (e.g., if an object class cannot be loaded); thus, it must run in protected mode */
+static inline int luajob_push(lua_State *L, luajob_t *job, int from)
+{
+	int i;
+
+	luaL_checkstack(L, job->nargs, NULL);
+	for (i = from; i < job->nargs; i++) {
+		luajob_arg_t *arg = &job->args[i];
+
+		switch (arg->type) {
+		case LUA_TBOOLEAN:
+			lua_pushboolean(L, arg->boolean);
+			break;
+		case LUA_TNUMBER:
+			lua_pushinteger(L, arg->integer);
+			break;
+		case LUA_TSTRING:
+			lua_pushlstring(L, arg->string.ptr, arg->string.len);
+			break;
+		case LUA_TUSERDATA:
+			lunatik_pushobject(L, arg->object);
+			break;
+		default:
+			lua_pushnil(L);
+			break;
+		}
+	}
+	return job->nargs - from;
+}
+
+#define luajob_name(job)	((job)->args[0].string.ptr)
+#define luajob_namelen(job)	((job)->args[0].string.len)
+
+/*
+* Calls the function named by the first argument of the job (a light userdata at index 2)
+* from the table of functions at index 1, passing the remaining arguments.
+* It's a lua_CFunction, meant to be called by lua_pcall().
+*/
+static inline int luajob_call(lua_State *L)
+{
+	luajob_t *job = (luajob_t *)lua_touserdata(L, 2);
+	int nargs;
+
+	luaL_checktype(L, 1, LUA_TTABLE);
+	lua_pushlstring(L, luajob_name(job), luajob_namelen(job));
+	lua_pushvalue(L, -1);
+	if (lua_gettable(L, 1) != LUA_TFUNCTION)
+		return luaL_error(L, "function '%s' not found", lua_tostring(L, -2));
+
+	nargs = luajob_push(L, job, 1);
+	lua_call(L, nargs, 0);
+	return 0;
+}
+
+/* runs the job on the runtime state L, whose script has returned a table of functions */
+static inline int luajob_run(lua_State *L, luajob_t *job)
+{
+	lua_pushcfunction(L, luajob_call);
+	lua_pushvalue(L, 1); /* functions */
+	lua_pushlightuserdata(L, job);
+	if (lua_pcall(L, 2, 0, 0) != LUA_OK) {
+		pr_err("%s\n", lua_tostring(L, -1));
+		lua_pop(L, 1);
+		return -ENOEXEC;
+	}
+	return 0;
+}
+
+static inline void luajob_free(luajob_t *job)
+{
+	int i;
+
+	for (i = 0; i < job->nargs; i++)
+		if (job->args[i].type == LUA_TUSERDATA)
+			lunatik_putobject(job->args[i].object);
+	kfree(job);
+}
+
+#endif
+
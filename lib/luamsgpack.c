@@ -0,0 +1,480 @@
+/*
+* SPDX-FileCopyrightText: (c) 2025 Ring Zero Desenvolvimento de Software LTDA
+* SPDX-License-Identifier: MIT OR GPL-2.0-only
+*/
+
+/***
+* Binary serialization of Lua values.
+* This library encodes Lua values into a compact binary format, which is a
+* subset of [MessagePack](https://msgpack.org), and decodes them back, possibly
+* on another runtime. It's meant for exchanging structured messages through
+* strings (e.g., mailboxes, rings, devices or sockets) or `data` objects.
+*
+* Supported values are nil, booleans, integers, strings and tables (nested up
+* to 32 levels). Tables whose keys are exactly `1..n` are encoded as arrays;
+* other tables are encoded as maps. Functions, userdata and cyclic tables
+* cannot be encoded.
+*
+* @module msgpack
+* @see data
+*/
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+#include <linux/kernel.h>
+#include <linux/module.h>
+
+#include <lua.h>
+#include <lualib.h>
+#include <lauxlib.h>
+
+#include <lunatik.h>
+
+#include "luadata.h"
+
+#define LUAMSGPACK_MAXDEPTH	(32)
+#define LUAMSGPACK_BUFFERSIZE	(256)
+
+#define LUAMSGPACK_NIL		(0xc0)
+#define LUAMSGPACK_FALSE	(0xc2)
+#define LUAMSGPACK_TRUE		(0xc3)
+#define LUAMSGPACK_BIN8		(0xc4)
+#define LUAMSGPACK_BIN16	(0xc5)
+#define LUAMSGPACK_BIN32	(0xc6)
+#define LUAMSGPACK_UINT8	(0xcc)
+#define LUAMSGPACK_UINT16	(0xcd)
+#define LUAMSGPACK_UINT32	(0xce)
+#define LUAMSGPACK_UINT64	(0xcf)
+#define LUAMSGPACK_INT8		(0xd0)
+#define LUAMSGPACK_INT16	(0xd1)
+#define LUAMSGPACK_INT32	(0xd2)
+#define LUAMSGPACK_INT64	(0xd3)
+#define LUAMSGPACK_STR8		(0xd9)
+#define LUAMSGPACK_STR16	(0xda)
+#define LUAMSGPACK_STR32	(0xdb)
+#define LUAMSGPACK_ARRAY16	(0xdc)
+#define LUAMSGPACK_ARRAY32	(0xdd)
+#define LUAMSGPACK_MAP16	(0xde)
+#define LUAMSGPACK_MAP32	(0xdf)
+
+#define LUAMSGPACK_FIXMAP	(0x80)
+#define LUAMSGPACK_FIXARRAY	(0x90)
+#define LUAMSGPACK_FIXSTR	(0xa0)
+
+typedef struct luamsgpack_writer_s {
+	lua_State *L;
+	char *ptr;
+	size_t size;
+	size_t pos;
+	int box;	/* stack index of the growable buffer; 0 if writing into fixed memory */
+} luamsgpack_writer_t;
+
+typedef struct luamsgpack_reader_s {
+	lua_State *L;
+	const uint8_t *ptr;
+	size_t size;
+	size_t pos;
+} luamsgpack_reader_t;
+
+static void luamsgpack_grow(luamsgpack_writer_t *w, size_t len)
+{
+	lua_State *L = w->L;
+	size_t size = w->size;
+	char *ptr;
+
+	if (w->box == 0)
+		luaL_error(L, "not enough space");
+
+	while (size - w->pos < len)
+		size *= 2;
+
+	ptr = (char *)lua_newuserdatauv(L, size, 0);
+	memcpy(ptr, w->ptr, w->pos);
+	lua_replace(L, w->box);
+	w->ptr = ptr;
+	w->size = size;
+}
+
+static inline void luamsgpack_write(luamsgpack_writer_t *w, const void *src, size_t len)
+{
+	if (unlikely(w->size - w->pos < len))
+		luamsgpack_grow(w, len);
+	memcpy(w->ptr + w->pos, src, len);
+	w->pos += len;
+}
+
+/* writes the type byte followed by n bytes of value, in big-endian */
+static inline void luamsgpack_writetype(luamsgpack_writer_t *w, uint8_t type, uint64_t value, int n)
+{
+	uint8_t buf[1 + sizeof(uint64_t)];
+	int i;
+
+	buf[0] = type;
+	for (i = n; i > 0; i--, value >>= 8)
+		buf[i] = (uint8_t)value;
+	luamsgpack_write(w, buf, n + 1);
+}
+
+static void luamsgpack_encodeinteger(luamsgpack_writer_t *w, lua_Integer value)
+{
+	if (value >= 0) {
+		if (value <= 0x7f)
+			luamsgpack_writetype(w, (uint8_t)value, 0, 0);
+		else if (value <= U8_MAX)
+			luamsgpack_writetype(w, LUAMSGPACK_UINT8, value, 1);
+		else if (value <= U16_MAX)
+			luamsgpack_writetype(w, LUAMSGPACK_UINT16, value, 2);
+		else if (value <= U32_MAX)
+			luamsgpack_writetype(w, LUAMSGPACK_UINT32, value, 4);
+		else
+			luamsgpack_writetype(w, LUAMSGPACK_UINT64, value, 8);
+	}
+	else {
+		if (value >= -32)
+			luamsgpack_writetype(w, (uint8_t)value, 0, 0);
+		else if (value >= S8_MIN)
+			luamsgpack_writetype(w, LUAMSGPACK_INT8, (uint8_t)value, 1);
+		else if (value >= S16_MIN)
+			luamsgpack_writetype(w, LUAMSGPACK_INT16, (uint16_t)value, 2);
+		else if (value >= S32_MIN)
+			luamsgpack_writetype(w, LUAMSGPACK_INT32, (uint32_t)value, 4);
+		else
+			luamsgpack_writetype(w, LUAMSGPACK_INT64, (uint64_t)value, 8);
+	}
+}
+
+static void luamsgpack_encodestring(luamsgpack_writer_t *w, int ix)
+{
+	size_t len;
+	const char *str = lua_tolstring(w->L, ix, &len);
+
+	if (len < 32)
+		luamsgpack_writetype(w, LUAMSGPACK_FIXSTR | len, 0, 0);
+	else if (len <= U8_MAX)
+		luamsgpack_writetype(w, LUAMSGPACK_STR8, len, 1);
+	else if (len <= U16_MAX)
+		luamsgpack_writetype(w, LUAMSGPACK_STR16, len, 2);
+	else if (len <= U32_MAX)
+		luamsgpack_writetype(w, LUAMSGPACK_STR32, len, 4);
+	else
+		luaL_error(w->L, "string too large");
+	luamsgpack_write(w, str, len);
+}
+
+static inline void luamsgpack_encodeheader(luamsgpack_writer_t *w, size_t n, uint8_t fix, uint8_t type16, uint8_t type32)
+{
+	if (n < 16)
+		luamsgpack_writetype(w, fix | n, 0, 0);
+	else if (n <= U16_MAX)
+		luamsgpack_writetype(w, type16, n, 2);
+	else
+		luamsgpack_writetype(w, type32, n, 4);
+}
+
+static void luamsgpack_encode(luamsgpack_writer_t *w, int ix, int depth);
+
+static void luamsgpack_encodetable(luamsgpack_writer_t *w, int ix, int depth)
+{
+	lua_State *L = w->L;
+	lua_Unsigned len = lua_rawlen(L, ix);
+	size_t n = 0;
+	bool array = true;
+
+	if (depth > LUAMSGPACK_MAXDEPTH)
+		luaL_error(L, "table too deep (or cyclic)");
+	luaL_checkstack(L, 3, NULL);
+
+	lua_pushnil(L);
+	while (lua_next(L, ix) != 0) {
+		lua_pop(L, 1);
+		if (array) {
+			lua_Integer key = lua_isinteger(L, -1) ? lua_tointeger(L, -1) : 0;
+			array = key >= 1 && (lua_Unsigned)key <= len;
+		}
+		n++;
+	}
+
+	if (array && n == len) { /* keys are 1..n */
+		lua_Unsigned i;
+
+		luamsgpack_encodeheader(w, n, LUAMSGPACK_FIXARRAY, LUAMSGPACK_ARRAY16, LUAMSGPACK_ARRAY32);
+		for (i = 1; i <= len; i++) {
+			lua_rawgeti(L, ix, (lua_Integer)i);
+			luamsgpack_encode(w, lua_gettop(L), depth + 1);
+			lua_pop(L, 1);
+		}
+		return;
+	}
+
+	luaL_argcheck(L, n <= U32_MAX, 1, "table too large");
+	luamsgpack_encodeheader(w, n, LUAMSGPACK_FIXMAP, LUAMSGPACK_MAP16, LUAMSGPACK_MAP32);
+	lua_pushnil(L);
+	while (lua_next(L, ix) != 0) {
+		int top = lua_gettop(L);
+		luamsgpack_encode(w, top - 1, depth + 1); /* key */
+		luamsgpack_encode(w, top, depth + 1); /* value */
+		lua_pop(L, 1);
+	}
+}
+
+static void luamsgpack_encode(luamsgpack_writer_t *w, int ix, int depth)
+{
+	lua_State *L = w->L;
+
+	switch (lua_type(L, ix)) {
+	case LUA_TNIL:
+		luamsgpack_writetype(w, LUAMSGPACK_NIL, 0, 0);
+		break;
+	case LUA_TBOOLEAN:
+		luamsgpack_writetype(w, lua_toboolean(L, ix) ? LUAMSGPACK_TRUE : LUAMSGPACK_FALSE, 0, 0);
+		break;
+	case LUA_TNUMBER:
+		luamsgpack_encodeinteger(w, lua_tointeger(L, ix));
+		break;
+	case LUA_TSTRING:
+		luamsgpack_encodestring(w, ix);
+		break;
+	case LUA_TTABLE:
+		luamsgpack_encodetable(w, ix, depth);
+		break;
+	default:
+		luaL_error(L, "cannot encode %s", luaL_typename(L, ix));
+		break;
+	}
+}
+
+/***
+* Encodes a Lua value.
+* @function encode
+* @param value The value to be encoded.
+* @tparam[opt] data data A data object where the value is written into, instead of a new string.
+* @tparam[opt=0] integer offset The offset of `data` where the value is written.
+* @tparam[opt] integer length The maximum number of bytes to be written; defaults to the rest of `data`.
+* @treturn string The encoded value, if `data` is omitted.
+* @treturn integer The number of bytes written into `data`, otherwise.
+* @raise Error if the value cannot be encoded or if it doesn't fit in `data`.
+* @usage
+*   local msg = msgpack.encode({op = "add", args = {1, 2}})
+*   local n = msgpack.encode(msg, buffer, 4) -- writes after a 4-byte header
+*/
+static int luamsgpack_encodevalue(lua_State *L)
+{
+	luamsgpack_writer_t w = {.L = L};
+
+	luaL_checkany(L, 1);
+	if (lua_isnoneornil(L, 2)) {
+		lua_settop(L, 1);
+		w.size = LUAMSGPACK_BUFFERSIZE;
+		w.ptr = (char *)lua_newuserdatauv(L, w.size, 0);
+		w.box = 2;
+		luamsgpack_encode(&w, 1, 0);
+		lua_pushlstring(L, w.ptr, w.pos);
+	}
+	else {
+		w.ptr = (char *)luadata_checkrange(L, 2, &w.size, true);
+		luamsgpack_encode(&w, 1, 0);
+		lua_pushinteger(L, (lua_Integer)w.pos);
+	}
+	return 1;
+}
+
+static inline const uint8_t *luamsgpack_read(luamsgpack_reader_t *r, size_t len)
+{
+	const uint8_t *ptr = r->ptr + r->pos;
+
+	if (unlikely(r->size - r->pos < len))
+		luaL_error(r->L, "truncated message");
+	r->pos += len;
+	return ptr;
+}
+
+static inline uint64_t luamsgpack_readuint(luamsgpack_reader_t *r, int n)
+{
+	const uint8_t *ptr = luamsgpack_read(r, n);
+	uint64_t value = 0;
+	int i;
+
+	for (i = 0; i < n; i++)
+		value = (value << 8) | ptr[i];
+	return value;
+}
+
+static void luamsgpack_decode(luamsgpack_reader_t *r, int depth);
+
+static void luamsgpack_decodestring(luamsgpack_reader_t *r, size_t len)
+{
+	const char *str = (const char *)luamsgpack_read(r, len);
+	lua_pushlstring(r->L, str, len);
+}
+
+static void luamsgpack_decodearray(luamsgpack_reader_t *r, size_t n, int depth)
+{
+	lua_State *L = r->L;
+	size_t i;
+
+	/* each element takes at least one byte */
+	luaL_argcheck(L, n <= r->size - r->pos, 1, "truncated message");
+	lua_createtable(L, (int)n, 0);
+	for (i = 1; i <= n; i++) {
+		luamsgpack_decode(r, depth + 1);
+		lua_rawseti(L, -2, (lua_Integer)i);
+	}
+}
+
+static void luamsgpack_decodemap(luamsgpack_reader_t *r, size_t n, int depth)
+{
+	lua_State *L = r->L;
+	size_t i;
+
+	luaL_argcheck(L, n <= (r->size - r->pos) / 2, 1, "truncated message");
+	lua_createtable(L, 0, (int)n);
+	for (i = 0; i < n; i++) {
+		luamsgpack_decode(r, depth + 1); /* key */
+		if (lua_isnil(L, -1))
+			luaL_error(L, "invalid map key");
+		luamsgpack_decode(r, depth + 1); /* value */
+		lua_rawset(L, -3);
+	}
+}
+
+static void luamsgpack_decode(luamsgpack_reader_t *r, int depth)
+{
+	lua_State *L = r->L;
+	uint8_t type = *luamsgpack_read(r, 1);
+
+	if (depth > LUAMSGPACK_MAXDEPTH)
+		luaL_error(L, "message too deep");
+	luaL_checkstack(L, 3, NULL);
+
+	if (type <= 0x7f) /* positive fixint */
+		lua_pushinteger(L, (lua_Integer)type);
+	else if (type >= 0xe0) /* negative fixint */
+		lua_pushinteger(L, (lua_Integer)(int8_t)type);
+	else if ((type & 0xe0) == LUAMSGPACK_FIXSTR)
+		luamsgpack_decodestring(r, type & 0x1f);
+	else if ((type & 0xf0) == LUAMSGPACK_FIXARRAY)
+		luamsgpack_decodearray(r, type & 0x0f, depth);
+	else if ((type & 0xf0) == LUAMSGPACK_FIXMAP)
+		luamsgpack_decodemap(r, type & 0x0f, depth);
+	else switch (type) {
+	case LUAMSGPACK_NIL:
+		lua_pushnil(L);
+		break;
+	case LUAMSGPACK_FALSE: case LUAMSGPACK_TRUE:
+		lua_pushboolean(L, type == LUAMSGPACK_TRUE);
+		break;
+	case LUAMSGPACK_UINT8:
+		lua_pushinteger(L, (lua_Integer)luamsgpack_readuint(r, 1));
+		break;
+	case LUAMSGPACK_UINT16:
+		lua_pushinteger(L, (lua_Integer)luamsgpack_readuint(r, 2));
+		break;
+	case LUAMSGPACK_UINT32:
+		lua_pushinteger(L, (lua_Integer)luamsgpack_readuint(r, 4));
+		break;
+	case LUAMSGPACK_UINT64:
+		lua_pushinteger(L, (lua_Integer)luamsgpack_readuint(r, 8));
+		break;
+	case LUAMSGPACK_INT8:
+		lua_pushinteger(L, (lua_Integer)(int8_t)luamsgpack_readuint(r, 1));
+		break;
+	case LUAMSGPACK_INT16:
+		lua_pushinteger(L, (lua_Integer)(int16_t)luamsgpack_readuint(r, 2));
+		break;
+	case LUAMSGPACK_INT32:
+		lua_pushinteger(L, (lua_Integer)(int32_t)luamsgpack_readuint(r, 4));
+		break;
+	case LUAMSGPACK_INT64:
+		lua_pushinteger(L, (lua_Integer)(int64_t)luamsgpack_readuint(r, 8));
+		break;
+	case LUAMSGPACK_STR8: case LUAMSGPACK_BIN8:
+		luamsgpack_decodestring(r, luamsgpack_readuint(r, 1));
+		break;
+	case LUAMSGPACK_STR16: case LUAMSGPACK_BIN16:
+		luamsgpack_decodestring(r, luamsgpack_readuint(r, 2));
+		break;
+	case LUAMSGPACK_STR32: case LUAMSGPACK_BIN32:
+		luamsgpack_decodestring(r, luamsgpack_readuint(r, 4));
+		break;
+	case LUAMSGPACK_ARRAY16:
+		luamsgpack_decodearray(r, luamsgpack_readuint(r, 2), depth);
+		break;
+	case LUAMSGPACK_ARRAY32:
+		luamsgpack_decodearray(r, luamsgpack_readuint(r, 4), depth);
+		break;
+	case LUAMSGPACK_MAP16:
+		luamsgpack_decodemap(r, luamsgpack_readuint(r, 2), depth);
+		break;
+	case LUAMSGPACK_MAP32:
+		luamsgpack_decodemap(r, luamsgpack_readuint(r, 4), depth);
+		break;
+	default:
+		luaL_error(L, "unsupported type (0x%02x)", type);
+		break;
+	}
+}
+
+/***
+* Decodes a Lua value.
+* @function decode
+* @tparam string|data message The encoded value.
+* @tparam[opt=0] integer offset The offset of `message` where the value starts.
+* @tparam[opt] integer length The number of bytes available; defaults to the rest of `message`.
+* @return The decoded value.
+* @treturn integer The offset right after the decoded value, which can be used
+*   for decoding a sequence of values.
+* @raise Error if the message is truncated or malformed.
+* @usage
+*   local msg = msgpack.decode(s)
+*   local value, offset = msgpack.decode(buffer, 4)
+*/
+static int luamsgpack_decodevalue(lua_State *L)
+{
+	luamsgpack_reader_t r = {.L = L};
+	size_t offset;
+
+	if (lua_type(L, 1) == LUA_TSTRING) {
+		size_t size;
+		const char *str = lua_tolstring(L, 1, &size);
+		lua_Integer off = luaL_optinteger(L, 2, 0);
+		lua_Integer len;
+
+		lunatik_checkbounds(L, 2, off, 0, (lua_Integer)size);
+		len = luaL_optinteger(L, 3, (lua_Integer)size - off);
+		lunatik_checkbounds(L, 3, len, 0, (lua_Integer)size - off);
+
+		r.ptr = (const uint8_t *)str + off;
+		r.size = (size_t)len;
+		offset = (size_t)off;
+	}
+	else {
+		r.ptr = (const uint8_t *)luadata_checkrange(L, 1, &r.size, false);
+		offset = (size_t)luaL_optinteger(L, 2, 0);
+	}
+
+	luamsgpack_decode(&r, 0);
+	lua_pushinteger(L, (lua_Integer)(offset + r.pos));
+	return 2;
+}
+
+static const luaL_Reg luamsgpack_lib[] = {
+	{"encode", luamsgpack_encodevalue},
+	{"decode", luamsgpack_decodevalue},
+	{NULL, NULL}
+};
+
+LUNATIK_NEWLIB(msgpack, luamsgpack_lib, NULL, NULL);
+
+static int __init luamsgpack_init(void)
+{
+	return 0;
+}
+
+static void __exit luamsgpack_exit(void)
+{
+}
+
+module_init(luamsgpack_init);
+module_exit(luamsgpack_exit);
+MODULE_LICENSE("Dual MIT/GPL");
+MODULE_AUTHOR("Lourival Vieira Neto <lourival.neto@ring-0.io>");
+
@@ -0,0 +1,268 @@
+/*
+* SPDX-FileCopyrightText: (c) 2025 Ring Zero Desenvolvimento de Software LTDA
+* SPDX-License-Identifier: MIT OR GPL-2.0-only
+*/
+
+/***
+* Waiting on multiple event sources.
+* This library allows a sleepable runtime to wait until any of a set of
+* objects is ready, instead of polling each one of them in turn. It registers
+* the runtime thread on the wait queues of all sources (as `poll(2)` does), so
+* it's woken up as soon as one of them becomes ready.
+*
+* Pollable objects are:
+*
+* - `completion`: ready when completed (i.e., `completion:wait()` won't block);
+* - `ring`: ready when it has messages to pop;
+* - `socket`: ready when it has data to receive (or a pending connection, error or hang up);
+* - `timer`: ready when it is due.
+*
+* Waiting doesn't consume the ready source; e.g., one still has to call
+* `completion:wait()` or `ring:pop()` afterwards. A source closed while waiting
+* (e.g., `socket:close()`) is returned as ready.
+*
+* @module poll
+* @see completion
+* @see ring
+*/
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/poll.h>
+#include <linux/wait.h>
+#include <linux/sched.h>
+#include <linux/sched/signal.h>
+#include <linux/hrtimer.h>
+#include <linux/overflow.h>
+
+#include <lua.h>
+#include <lualib.h>
+#include <lauxlib.h>
+
+#include <lunatik.h>
+
+#define LUAPOLL_MAXSOURCES	(256)
+#define LUAPOLL_ENTRIES		(2)	/* wait queues per source */
+#define LUAPOLL_EVENTS		(EPOLLIN | EPOLLRDNORM | EPOLLERR | EPOLLHUP | EPOLLRDHUP | EPOLLNVAL)
+
+struct luapoll_s;
+
+typedef struct luapoll_entry_s {
+	wait_queue_entry_t wait;
+	wait_queue_head_t *head;
+	struct luapoll_s *poll;
+} luapoll_entry_t;
+
+typedef struct luapoll_s {
+	lunatik_poll_t table;
+	struct task_struct *task;
+	lunatik_object_t **sources;
+	void **privates; /* polled while registering on wait queues */
+	unsigned int nsources;
+	unsigned int npolled;
+	unsigned int nentries;
+	unsigned int maxentries;
+	bool triggered;
+	bool overflow;
+	luapoll_entry_t entries[];
+} luapoll_t;
+
+static int luapoll_wake(wait_queue_entry_t *wait, unsigned int mode, int sync, void *key)
+{
+	luapoll_entry_t *entry = container_of(wait, luapoll_entry_t, wait);
+	luapoll_t *poll = entry->poll;
+
+	if (key != NULL && !(key_to_poll(key) & LUAPOLL_EVENTS))
+		return 0;
+
+	WRITE_ONCE(poll->triggered, true);
+	smp_wmb(); /* pairs with set_current_state() on luapoll_wait() */
+	return wake_up_process(poll->task);
+}
+
+static void luapoll_queue(struct file *file, wait_queue_head_t *head, poll_table *table)
+{
+	luapoll_t *poll = container_of(table, luapoll_t, table.table);
+	luapoll_entry_t *entry;
+
+	if (poll->nentries == poll->maxentries) {
+		poll->overflow = true;
+		return;
+	}
+
+	entry = &poll->entries[poll->nentries++];
+	entry->head = head;
+	entry->poll = poll;
+	init_waitqueue_func_entry(&entry->wait, luapoll_wake);
+	add_wait_queue(head, &entry->wait);
+}
+
+static int luapoll_scan(luapoll_t *poll)
+{
+	bool registering = !poll_does_not_wait(&poll->table.table);
+	unsigned int i;
+
+	for (i = 0; i < poll->nsources; i++) {
+		lunatik_object_t *object = poll->sources[i];
+		void *private;
+		__poll_t events;
+
+		lunatik_lock(object);
+		private = object->private;
+		events = private != NULL ? object->class->poll(private, &poll->table) : EPOLLNVAL; /* closed */
+		lunatik_unlock(object);
+
+		if (registering)
+			poll->privates[poll->npolled++] = private;
+		if (events & LUAPOLL_EVENTS)
+			return i;
+	}
+	return -1;
+}
+
+/* it must not raise errors, as entries are registered on wait queues */
+static int luapoll_wait(luapoll_t *poll, ktime_t expires, int *ready)
+{
+	int ret = 0;
+
+	init_poll_funcptr(&poll->table.table, luapoll_queue);
+	for (;;) {
+		ktime_t deadline;
+
+		poll->table.deadline = expires;
+		*ready = luapoll_scan(poll);
+		poll->table.table._qproc = NULL; /* registers on wait queues only once */
+
+		if (*ready >= 0 || ret != 0)
+			break;
+		if (signal_pending(current)) {
+			ret = -EINTR;
+			break;
+		}
+
+		deadline = poll->table.deadline;
+		if (poll->overflow) /* not registered on all wait queues */
+			deadline = ktime_before(deadline, ktime_add_ms(ktime_get(), 1)) ?
+				deadline : ktime_add_ms(ktime_get(), 1);
+
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (!READ_ONCE(poll->triggered) &&
+		    schedule_hrtimeout_range(&deadline, 0, HRTIMER_MODE_ABS) == 0 &&
+		    ktime_compare(deadline, expires) >= 0)
+			ret = -ETIME; /* scans once more before timing out */
+		__set_current_state(TASK_RUNNING);
+		smp_store_mb(poll->triggered, false);
+	}
+
+	while (poll->nentries > 0) {
+		luapoll_entry_t *entry = &poll->entries[--poll->nentries];
+		remove_wait_queue(entry->head, &entry->wait);
+	}
+
+	while (poll->npolled > 0) {
+		unsigned int i = --poll->npolled;
+		void (*unpoll)(void *) = poll->sources[i]->class->unpoll;
+
+		if (unpoll != NULL && poll->privates[i] != NULL)
+			unpoll(poll->privates[i]);
+	}
+	return ret;
+}
+
+/***
+* Waits until any of the given sources is ready.
+* It must be called on a sleepable runtime.
+* @function wait
+* @tparam table sources An array of pollable objects (completions, rings, sockets or timers).
+* @tparam[opt] integer timeout The maximum time to wait, in milliseconds.
+*   If omitted, waits indefinitely; if `0`, only checks the sources.
+* @return[1] The first ready source.
+* @treturn[1] integer The index of the ready source in `sources`.
+* @treturn[2] nil If no source got ready.
+* @treturn[2] string `"timeout"` or `"interrupt"`.
+* @raise Error if called on a non-sleepable runtime or if a source isn't pollable.
+* @usage
+*   local poll = require("poll")
+*   local source, ix = poll.wait({inbox, requests, sock}, 1000)
+*   if source == inbox then
+*     handle(inbox:pop())
+*   end
+* @within poll
+*/
+static int luapoll_lwait(lua_State *L)
+{
+	lua_Integer n, timeout;
+	ktime_t expires = KTIME_MAX;
+	luapoll_t *poll;
+	unsigned int i;
+	int ready, ret;
+
+	luaL_checktype(L, 1, LUA_TTABLE);
+	timeout = luaL_optinteger(L, 2, -1);
+	lunatik_checkruntime(L, true);
+
+	n = (lua_Integer)lua_rawlen(L, 1);
+	lunatik_checkbounds(L, 1, n, 1, LUAPOLL_MAXSOURCES);
+
+	poll = (luapoll_t *)lua_newuserdatauv(L, struct_size(poll, entries, n * LUAPOLL_ENTRIES), 0);
+	memset(poll, 0, sizeof(luapoll_t));
+	poll->sources = (lunatik_object_t **)lua_newuserdatauv(L, n * sizeof(lunatik_object_t *), 0);
+	poll->privates = (void **)lua_newuserdatauv(L, n * sizeof(void *), 0);
+	poll->task = current;
+	poll->maxentries = n * LUAPOLL_ENTRIES;
+
+	for (i = 0; i < n; i++) {
+		lunatik_object_t *object;
+
+		lua_rawgeti(L, 1, i + 1);
+		object = lunatik_testobject(L, -1);
+		luaL_argcheck(L, object != NULL && object->class->poll != NULL, 1, "source is not pollable");
+		poll->sources[poll->nsources++] = object;
+		lua_pop(L, 1);
+	}
+
+	if (timeout >= 0)
+		expires = ktime_add_ms(ktime_get(), timeout);
+
+	for (i = 0; i < n; i++)
+		lunatik_getobject(poll->sources[i]);
+	ret = luapoll_wait(poll, expires, &ready);
+	for (i = 0; i < n; i++)
+		lunatik_putobject(poll->sources[i]);
+
+	if (ready >= 0) {
+		lua_rawgeti(L, 1, ready + 1);
+		lua_pushinteger(L, (lua_Integer)ready + 1);
+		return 2;
+	}
+
+	lua_pushnil(L);
+	if (ret == -EINTR)
+		lua_pushliteral(L, "interrupt");
+	else
+		lua_pushliteral(L, "timeout");
+	return 2;
+}
+
+static const luaL_Reg luapoll_lib[] = {
+	{"wait", luapoll_lwait},
+	{NULL, NULL}
+};
+
+LUNATIK_NEWLIB(poll, luapoll_lib, NULL, NULL);
+
+static int __init luapoll_init(void)
+{
+	return 0;
+}
+
+static void __exit luapoll_exit(void)
+{
+}
+
+module_init(luapoll_init);
+module_exit(luapoll_exit);
+MODULE_LICENSE("Dual MIT/GPL");
+MODULE_AUTHOR("Lourival Vieira Neto <lourival.neto@ring-0.io>");
+
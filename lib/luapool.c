@@ -0,0 +1,357 @@
+/*
+* SPDX-FileCopyrightText: (c) 2025 Ring Zero Desenvolvimento de Software LTDA
+* SPDX-License-Identifier: MIT OR GPL-2.0-only
+*/
+
+/***
+* Work-stealing pool of Lua runtimes.
+* This library creates a set of sleepable runtimes, all loaded from the same
+* script, each one driven by its own kernel thread bound to a CPU. Jobs (a
+* function name and its arguments) are queued on per-worker deques; each
+* worker consumes its own deque and, when it runs out of jobs, steals from
+* the others. Hence, jobs run in parallel, without a single queue or lock
+* serializing them.
+*
+* The script must return a table of functions; a job named `"f"` calls the
+* function `f` of this table with the job arguments. Arguments might be nil,
+* booleans, integers, strings or Lunatik objects (passed by reference).
+* There is no ordering guarantee among jobs.
+*
+* @module pool
+* @see thread
+*/
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/kthread.h>
+#include <linux/cpumask.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+#include <linux/overflow.h>
+
+#include <lua.h>
+#include <lualib.h>
+#include <lauxlib.h>
+
+#include <lunatik.h>
+
+#include "luajob.h"
+
+#define LUAPOOL_MAXWORKERS	(1024)
+
+struct luapool_s;
+
+typedef struct luapool_worker_s {
+	spinlock_t lock;
+	struct list_head jobs;
+	struct task_struct *task;
+	lunatik_object_t *runtime;
+	struct luapool_s *pool;
+	unsigned int id;
+} ____cacheline_aligned_in_smp luapool_worker_t;
+
+/***
+* Represents a pool of worker runtimes.
+* This is a userdata object returned by `pool.new()`.
+* @type pool
+*/
+typedef struct luapool_s {
+	wait_queue_head_t wait;
+	atomic_t pending;
+	atomic_t next;
+	atomic_long_t submitted;
+	atomic_long_t completed;
+	atomic_long_t failed;
+	atomic_long_t stolen;
+	unsigned int nworkers;
+	luapool_worker_t workers[];
+} luapool_t;
+
+static int luapool_new(lua_State *L);
+
+LUNATIK_PRIVATECHECKER(luapool_check, luapool_t *);
+
+static inline void luapool_push(luapool_worker_t *worker, luajob_t *job)
+{
+	luapool_t *pool = worker->pool;
+
+	spin_lock_bh(&worker->lock);
+	list_add_tail(&job->list, &worker->jobs);
+	atomic_inc(&pool->pending);
+	spin_unlock_bh(&worker->lock);
+}
+
+/* owners take the newest job (cache-hot); thieves take the oldest one */
+static inline luajob_t *luapool_take(luapool_worker_t *worker, bool owner)
+{
+	luajob_t *job = NULL;
+
+	spin_lock_bh(&worker->lock);
+	if (!list_empty(&worker->jobs)) {
+		job = owner ? list_last_entry(&worker->jobs, luajob_t, list) :
+			list_first_entry(&worker->jobs, luajob_t, list);
+		list_del(&job->list);
+		atomic_dec(&worker->pool->pending);
+	}
+	spin_unlock_bh(&worker->lock);
+	return job;
+}
+
+static luajob_t *luapool_pop(luapool_worker_t *worker)
+{
+	luapool_t *pool = worker->pool;
+	luajob_t *job;
+	unsigned int i;
+
+	if ((job = luapool_take(worker, true)) != NULL)
+		return job;
+
+	for (i = 1; i < pool->nworkers; i++) {
+		luapool_worker_t *victim = &pool->workers[(worker->id + i) % pool->nworkers];
+		if ((job = luapool_take(victim, false)) != NULL) {
+			atomic_long_inc(&pool->stolen);
+			return job;
+		}
+	}
+	return NULL;
+}
+
+static int luapool_func(void *data)
+{
+	luapool_worker_t *worker = (luapool_worker_t *)data;
+	luapool_t *pool = worker->pool;
+
+	while (!kthread_should_stop()) {
+		luajob_t *job = luapool_pop(worker);
+		int ret;
+
+		if (job == NULL) {
+			wait_event_interruptible_exclusive(pool->wait,
+				atomic_read(&pool->pending) > 0 || kthread_should_stop());
+			continue;
+		}
+
+		lunatik_run(worker->runtime, luajob_run, ret, job);
+		atomic_long_inc(ret == 0 ? &pool->completed : &pool->failed);
+		luajob_free(job);
+	}
+	return 0;
+}
+
+static luapool_worker_t *luapool_target(luapool_t *pool)
+{
+	unsigned int i;
+
+	/* jobs submitted by a worker are kept on its own deque */
+	for (i = 0; i < pool->nworkers; i++)
+		if (pool->workers[i].task == current)
+			return &pool->workers[i];
+
+	return &pool->workers[(unsigned int)atomic_inc_return(&pool->next) % pool->nworkers];
+}
+
+/***
+* Submits a job to the pool.
+* The job is queued on a worker deque and one idle worker is woken up to run it.
+* @function submit
+* @tparam string name The name of the function, in the table returned by the script, to be called.
+* @param ... Arguments passed to the function. They must be nil, booleans, integers,
+*   strings or Lunatik objects.
+* @treturn nil
+* @raise Error if an argument has an unsupported type or if memory allocation fails.
+* @usage
+*   p:submit("checksum", "/var/log/syslog")
+*/
+static int luapool_submit(lua_State *L)
+{
+	luapool_t *pool = luapool_check(L, 1);
+	int nargs = lua_gettop(L) - 1;
+	luajob_t *job;
+
+	luaL_checktype(L, 2, LUA_TSTRING);
+	job = luajob_new(L, 2, nargs, GFP_KERNEL);
+	lunatik_checknull(L, job);
+
+	luapool_push(luapool_target(pool), job);
+	atomic_long_inc(&pool->submitted);
+	wake_up(&pool->wait);
+	return 0;
+}
+
+/***
+* Gets the pool statistics.
+* @function stats
+* @treturn table A table with the following fields:
+*   @tfield integer workers The number of workers.
+*   @tfield integer pending The number of queued jobs.
+*   @tfield integer submitted The number of submitted jobs.
+*   @tfield integer completed The number of jobs that have run successfully.
+*   @tfield integer failed The number of jobs that have raised an error.
+*   @tfield integer stolen The number of jobs stolen by idle workers.
+*/
+static int luapool_stats(lua_State *L)
+{
+	luapool_t *pool = luapool_check(L, 1);
+
+	lua_createtable(L, 0, 6);
+	lua_pushinteger(L, (lua_Integer)pool->nworkers);
+	lua_setfield(L, -2, "workers");
+	lua_pushinteger(L, (lua_Integer)atomic_read(&pool->pending));
+	lua_setfield(L, -2, "pending");
+	lua_pushinteger(L, (lua_Integer)atomic_long_read(&pool->submitted));
+	lua_setfield(L, -2, "submitted");
+	lua_pushinteger(L, (lua_Integer)atomic_long_read(&pool->completed));
+	lua_setfield(L, -2, "completed");
+	lua_pushinteger(L, (lua_Integer)atomic_long_read(&pool->failed));
+	lua_setfield(L, -2, "failed");
+	lua_pushinteger(L, (lua_Integer)atomic_long_read(&pool->stolen));
+	lua_setfield(L, -2, "stolen");
+	return 1;
+}
+
+/***
+* Stops the pool.
+* Stops all worker threads, discards the jobs still queued and releases the runtimes.
+* It must not be called by a job running on the pool itself.
+* This method is also called automatically when the pool object is garbage collected.
+* @function stop
+* @treturn nil
+*/
+static void luapool_release(void *private)
+{
+	luapool_t *pool = (luapool_t *)private;
+	unsigned int i;
+
+	for (i = 0; i < pool->nworkers; i++)
+		if (pool->workers[i].task != NULL)
+			kthread_stop(pool->workers[i].task);
+
+	for (i = 0; i < pool->nworkers; i++) {
+		luapool_worker_t *worker = &pool->workers[i];
+		luajob_t *job, *next;
+
+		list_for_each_entry_safe(job, next, &worker->jobs, list) {
+			list_del(&job->list);
+			luajob_free(job);
+		}
+		lunatik_stop(worker->runtime);
+	}
+}
+
+static const luaL_Reg luapool_lib[] = {
+	{"new", luapool_new},
+	{NULL, NULL}
+};
+
+static const luaL_Reg luapool_mt[] = {
+	{"__gc", lunatik_deleteobject},
+	{"__close", lunatik_closeobject},
+	{"stop", lunatik_closeobject},
+	{"submit", luapool_submit},
+	{"stats", luapool_stats},
+	{NULL, NULL}
+};
+
+static const lunatik_class_t luapool_class = {
+	.name = "pool",
+	.methods = luapool_mt,
+	.release = luapool_release,
+	.sleep = true,
+};
+
+static unsigned int luapool_cpu(unsigned int id)
+{
+	unsigned int cpu, n = id % num_online_cpus();
+
+	for_each_online_cpu(cpu)
+		if (n-- == 0)
+			return cpu;
+	return cpumask_first(cpu_online_mask);
+}
+
+static int luapool_start(luapool_worker_t *worker)
+{
+	struct task_struct *task = kthread_create(luapool_func, worker, "luapool/%u", worker->id);
+
+	if (IS_ERR(task))
+		return PTR_ERR(task);
+
+	kthread_bind(task, luapool_cpu(worker->id));
+	worker->task = task;
+	wake_up_process(task);
+	return 0;
+}
+
+/***
+* Creates a new pool of worker runtimes.
+* Each worker loads `script` into its own sleepable runtime and runs on its own
+* kernel thread, bound to one of the online CPUs (round-robin).
+* @function new
+* @tparam string script The name of the script loaded by each worker (e.g., "examples/worker").
+*   It must return a table of functions.
+* @tparam[opt] integer workers The number of workers; defaults to the number of online CPUs.
+* @treturn pool A new pool object.
+* @raise Error if a runtime cannot be created or if a thread cannot be started.
+* @usage
+*   -- examples/worker.lua
+*   local worker = {}
+*   function worker.hello(name) print("hello " .. name) end
+*   return worker
+*
+*   -- main script
+*   local pool = require("pool")
+*   local p = pool.new("examples/worker")
+*   p:submit("hello", "world")
+* @within pool
+*/
+static int luapool_new(lua_State *L)
+{
+	const char *script = luaL_checkstring(L, 1);
+	lua_Integer n = luaL_optinteger(L, 2, num_online_cpus());
+	lunatik_object_t *object;
+	luapool_t *pool;
+	size_t size;
+	unsigned int i;
+
+	lunatik_checkbounds(L, 2, n, 1, LUAPOOL_MAXWORKERS);
+	size = struct_size(pool, workers, n);
+	object = lunatik_newobject(L, &luapool_class, size);
+	pool = (luapool_t *)object->private;
+	memset(pool, 0, size);
+
+	init_waitqueue_head(&pool->wait);
+	for (i = 0; i < n; i++) {
+		luapool_worker_t *worker = &pool->workers[i];
+
+		spin_lock_init(&worker->lock);
+		INIT_LIST_HEAD(&worker->jobs);
+		worker->pool = pool;
+		worker->id = i;
+
+		lunatik_try(L, lunatik_runtime, &worker->runtime, script, true);
+		pool->nworkers++;
+	}
+
+	for (i = 0; i < n; i++)
+		lunatik_try(L, luapool_start, &pool->workers[i]);
+
+	return 1; /* object */
+}
+
+LUNATIK_NEWLIB(pool, luapool_lib, &luapool_class, NULL);
+
+static int __init luapool_init(void)
+{
+	return 0;
+}
+
+static void __exit luapool_exit(void)
+{
+}
+
+module_init(luapool_init);
+module_exit(luapool_exit);
+MODULE_LICENSE("Dual MIT/GPL");
+MODULE_AUTHOR("Lourival Vieira Neto <lourival.neto@ring-0.io>");
+
@@ -0,0 +1,264 @@
+/*
+* SPDX-FileCopyrightText: (c) 2025 Ring Zero Desenvolvimento de Software LTDA
+* SPDX-License-Identifier: MIT OR GPL-2.0-only
+*/
+
+/***
+* Fast per-CPU pseudo-random number generators.
+* A random object holds one PRNG state (Tausworthe, as `prandom_u32_state()`)
+* per CPU; thus, it can be shared among runtimes, in process, softirq or
+* interrupt context, and used on hot paths (e.g., sampling packets) without
+* locking (each state is only accessed with local interrupts disabled). Its
+* methods generate many numbers per call, either into a table or into a data object.
+*
+* These generators are **not** cryptographically secure; use `linux.random`
+* or `crypto.rng` for keys, nonces and alike.
+*
+* @module random
+* @see linux.random
+* @see crypto.rng
+*/
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/random.h>
+#include <linux/smp.h>
+#include <linux/irqflags.h>
+#include <linux/overflow.h>
+#include <linux/limits.h>
+#include <linux/version.h>
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(5, 10, 0))
+#include <linux/prandom.h>
+#endif
+
+#include <lua.h>
+#include <lualib.h>
+#include <lauxlib.h>
+
+#include <lunatik.h>
+
+#include "luadata.h"
+
+#define LUARANDOM_MAXINTEGERS	(4096)
+#define LUARANDOM_FILLBATCH	(1024)
+
+typedef struct luarandom_state_s {
+	struct rnd_state state;
+} ____cacheline_aligned_in_smp luarandom_state_t;
+
+/***
+* Represents a set of per-CPU PRNGs.
+* This is a userdata object returned by `random.new()`.
+* @type random
+*/
+typedef struct luarandom_s {
+	unsigned int ncpus;
+	luarandom_state_t states[];
+} luarandom_t;
+
+static int luarandom_new(lua_State *L);
+
+LUNATIK_PRIVATECHECKER(luarandom_check, luarandom_t *);
+
+/* disables interrupts, as the object might be shared with runtimes in softirq or interrupt context */
+static inline struct rnd_state *luarandom_get(luarandom_t *random, unsigned long *flags)
+{
+	local_irq_save(*flags);
+	return &random->states[smp_processor_id()].state;
+}
+
+#define luarandom_put(flags)	local_irq_restore(flags)
+
+static void luarandom_seed(lua_State *L, luarandom_t *random, int ix)
+{
+	bool seeded = !lua_isnoneornil(L, ix);
+	u64 seed = seeded ? (u64)luaL_checkinteger(L, ix) : 0;
+	unsigned int cpu;
+
+	/* seeded states are reproducible, but still distinct per CPU */
+	for (cpu = 0; cpu < random->ncpus; cpu++)
+		prandom_seed_state(&random->states[cpu].state, seeded ? seed + cpu : get_random_u64());
+}
+
+/* returns a number in [1, n] or, if n is zero, the whole 32-bit number */
+static inline lua_Integer luarandom_next(struct rnd_state *state, u64 n)
+{
+	u32 rand = prandom_u32_state(state);
+	return n == 0 ? (lua_Integer)rand : (lua_Integer)(((u64)rand * n) >> 32) + 1;
+}
+
+static inline u64 luarandom_optbound(lua_State *L, int ix)
+{
+	lua_Integer n = luaL_optinteger(L, ix, 0);
+	lunatik_checkbounds(L, ix, n, 0, U32_MAX);
+	return (u64)n;
+}
+
+/***
+* Generates a pseudo-random integer.
+* @function integer
+* @tparam[opt] integer n The upper bound (up to `2^32 - 1`).
+* @treturn integer A number in the range `[1, n]` or, if `n` is omitted, an unsigned 32-bit number.
+* @raise Error if `n` is out of bounds.
+*/
+static int luarandom_integer(lua_State *L)
+{
+	luarandom_t *random = luarandom_check(L, 1);
+	u64 n = luarandom_optbound(L, 2);
+	unsigned long flags;
+	lua_Integer rand = luarandom_next(luarandom_get(random, &flags), n);
+
+	luarandom_put(flags);
+	lua_pushinteger(L, rand);
+	return 1;
+}
+
+/***
+* Generates many pseudo-random integers at once.
+* @function integers
+* @tparam integer count The number of integers (up to 4096).
+* @tparam[opt] integer n The upper bound, as in `integer`.
+* @tparam[opt] table t A table to store the integers at (from index 1), which avoids allocating a new one.
+* @treturn table The table holding the integers.
+* @raise Error if `count` or `n` is out of bounds.
+* @usage
+*   local samples = prng:integers(64, 100, samples)
+*   for i = 1, 64 do if samples[i] <= rate then sample(packets[i]) end end
+*/
+static int luarandom_integers(lua_State *L)
+{
+	luarandom_t *random = luarandom_check(L, 1);
+	lua_Integer count = luaL_checkinteger(L, 2);
+	u64 n = luarandom_optbound(L, 3);
+	lua_Integer rands[64];
+	lua_Integer i = 0;
+
+	lunatik_checkbounds(L, 2, count, 1, LUARANDOM_MAXINTEGERS);
+	if (lua_isnoneornil(L, 4))
+		lua_createtable(L, (int)count, 0);
+	else {
+		luaL_checktype(L, 4, LUA_TTABLE);
+		lua_settop(L, 4);
+	}
+
+	/* generates in batches, as the table can't be written with interrupts disabled */
+	while (i < count) {
+		unsigned long flags;
+		struct rnd_state *state = luarandom_get(random, &flags);
+		int j, batch = (int)min_t(lua_Integer, count - i, ARRAY_SIZE(rands));
+
+		for (j = 0; j < batch; j++)
+			rands[j] = luarandom_next(state, n);
+		luarandom_put(flags);
+
+		for (j = 0; j < batch; j++) {
+			lua_pushinteger(L, rands[j]);
+			lua_rawseti(L, -2, ++i);
+		}
+	}
+	return 1;
+}
+
+/***
+* Fills a data object range with pseudo-random bytes.
+* @function fill
+* @tparam data data The data object to fill.
+* @tparam[opt=0] integer offset The start of the range.
+* @tparam[opt] integer length The length of the range (defaults to the rest of the data).
+* @raise Error if the range is out of bounds.
+* @usage
+*   prng:fill(buffer) -- e.g., then read it with buffer:getuint32(i * 4)
+*/
+static int luarandom_fill(lua_State *L)
+{
+	luarandom_t *random = luarandom_check(L, 1);
+	size_t len;
+	u8 *buffer = (u8 *)luadata_checkrange(L, 2, &len, true);
+
+	/* fills in batches, so interrupts aren't disabled for long */
+	while (len > 0) {
+		unsigned long flags;
+		size_t batch = min_t(size_t, len, LUARANDOM_FILLBATCH);
+
+		prandom_bytes_state(luarandom_get(random, &flags), buffer, batch);
+		luarandom_put(flags);
+		buffer += batch;
+		len -= batch;
+	}
+	return 0;
+}
+
+/***
+* Reseeds the generators.
+* @function seed
+* @tparam[opt] integer seed The seed; if omitted, the generators are seeded by `get_random_u64()`.
+*/
+static int luarandom_reseed(lua_State *L)
+{
+	luarandom_t *random = luarandom_check(L, 1);
+
+	luarandom_seed(L, random, 2);
+	return 0;
+}
+
+static const luaL_Reg luarandom_lib[] = {
+	{"new", luarandom_new},
+	{NULL, NULL}
+};
+
+static const luaL_Reg luarandom_mt[] = {
+	{"__gc", lunatik_deleteobject},
+	{"integer", luarandom_integer},
+	{"integers", luarandom_integers},
+	{"fill", luarandom_fill},
+	{"seed", luarandom_reseed},
+	{NULL, NULL}
+};
+
+static const lunatik_class_t luarandom_class = {
+	.name = "random",
+	.methods = luarandom_mt,
+	.sleep = false,
+};
+
+/***
+* Creates a new set of per-CPU PRNGs.
+* @function new
+* @tparam[opt] integer seed The seed; if omitted, the generators are seeded by `get_random_u64()`.
+* @treturn random A new random object.
+* @raise Error if memory allocation fails.
+* @usage
+*   local prng = require("random").new()
+*   if prng:integer(100) <= 5 then sample(skb) end -- 5% sampling
+* @within random
+*/
+static int luarandom_new(lua_State *L)
+{
+	unsigned int ncpus = nr_cpu_ids;
+	lunatik_object_t *object;
+	luarandom_t *random;
+
+	object = lunatik_newobject(L, &luarandom_class, struct_size(random, states, ncpus));
+	random = (luarandom_t *)object->private;
+	random->ncpus = ncpus;
+	luarandom_seed(L, random, 1);
+	return 1; /* object */
+}
+
+LUNATIK_NEWLIB(random, luarandom_lib, &luarandom_class, NULL);
+
+static int __init luarandom_init(void)
+{
+	return 0;
+}
+
+static void __exit luarandom_exit(void)
+{
+}
+
+module_init(luarandom_init);
+module_exit(luarandom_exit);
+MODULE_LICENSE("Dual MIT/GPL");
+MODULE_AUTHOR("Lourival Vieira Neto <lourival.neto@ring-0.io>");
+
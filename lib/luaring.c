@@ -0,0 +1,447 @@
+/*
+* SPDX-FileCopyrightText: (c) 2025 Ring Zero Desenvolvimento de Software LTDA
+* SPDX-License-Identifier: MIT OR GPL-2.0-only
+*/
+
+/***
+* Lock-free message rings.
+* This library provides rings of fixed-size slots for exchanging messages
+* between runtimes (e.g., a producer on a softirq hook and a consumer on a
+* kernel thread) without a shared lock.
+*
+* Messages are either strings, which are copied into the slots, or Lunatik
+* objects (e.g., `data`, `rcu` or runtimes), which are passed by reference:
+* the ring holds a reference to each queued object and hands it over to the
+* consumer, so no copy is needed. Each message might also carry an integer tag.
+*
+* A `"spsc"` ring has a single producer and a single consumer; the producer
+* owns the tail and the consumer owns the head, which are published with
+* acquire/release ordering. A `"mpsc"` ring has one such ring per CPU:
+* producers running on the same CPU, including on hardirq context (e.g.,
+* probes), are serialized by disabling local interrupts and the single consumer
+* drains all of them. It's up to the user to respect the number of producers
+* and consumers of each ring.
+*
+* @module ring
+* @see fifo
+*/
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/log2.h>
+#include <linux/wait.h>
+#include <linux/overflow.h>
+#include <linux/irqflags.h>
+
+#include <lua.h>
+#include <lualib.h>
+#include <lauxlib.h>
+
+#include <lunatik.h>
+
+#define LUARING_SIZE		(256)
+#define LUARING_MAXSIZE		(64 * 1024)
+#define LUARING_MAXSLOTS	(1 << 20)
+#define LUARING_MAXBYTES	(256 * 1024 * 1024) /* all queues */
+
+typedef struct luaring_slot_s {
+	lunatik_object_t *object;
+	lua_Integer tag;
+	size_t len;
+	char data[];
+} luaring_slot_t;
+
+typedef struct luaring_queue_s {
+	unsigned int head ____cacheline_aligned_in_smp;	/* owned by the consumer */
+	unsigned int tail ____cacheline_aligned_in_smp;	/* owned by the producer */
+	char *slots;
+} luaring_queue_t;
+
+/***
+* Represents a message ring.
+* This is a userdata object returned by `ring.new()`.
+* @type ring
+*/
+typedef struct luaring_s {
+	wait_queue_head_t wait;
+	size_t size;
+	size_t slotsize;
+	unsigned int mask;
+	unsigned int cursor;	/* owned by the consumer */
+	unsigned int nqueues;
+	bool mpsc;
+	luaring_queue_t queues[];
+} luaring_t;
+
+static int luaring_new(lua_State *L);
+
+LUNATIK_PRIVATECHECKER(luaring_check, luaring_t *);
+
+#define luaring_slot(ring, queue, ix)	((luaring_slot_t *)((queue)->slots + ((ix) & (ring)->mask) * (ring)->slotsize))
+
+static inline unsigned int luaring_pending(luaring_t *ring)
+{
+	unsigned int i, pending = 0;
+
+	for (i = 0; i < ring->nqueues; i++) {
+		luaring_queue_t *queue = &ring->queues[i];
+		pending += READ_ONCE(queue->tail) - READ_ONCE(queue->head);
+	}
+	return pending;
+}
+
+static inline void luaring_checkmessage(lua_State *L, luaring_t *ring, int ix)
+{
+	if (lua_type(L, ix) == LUA_TUSERDATA)
+		luaL_argcheck(L, lunatik_testobject(L, ix) != NULL, ix, "invalid object");
+	else {
+		size_t len;
+		luaL_checklstring(L, ix, &len);
+		luaL_argcheck(L, len <= ring->size, ix, "message too large");
+	}
+}
+
+static inline void luaring_setslot(lua_State *L, luaring_slot_t *slot, int ix, lua_Integer tag)
+{
+	slot->tag = tag;
+	if ((slot->object = lunatik_testobject(L, ix)) != NULL) {
+		lunatik_getobject(slot->object); /* put by the consumer */
+		slot->len = 0;
+	}
+	else {
+		const char *str = lua_tolstring(L, ix, &slot->len);
+		memcpy(slot->data, str, slot->len);
+	}
+}
+
+/* might raise an error (e.g., on object class loading) */
+static inline void luaring_pushslot(lua_State *L, luaring_slot_t *slot)
+{
+	if (slot->object != NULL)
+		lunatik_pushobject(L, slot->object);
+	else
+		lua_pushlstring(L, slot->data, slot->len);
+}
+
+static inline void luaring_putslot(luaring_slot_t *slot)
+{
+	if (slot->object != NULL)
+		lunatik_putobject(slot->object);
+}
+
+/* arguments must have been checked, as it might run with interrupts disabled */
+static unsigned int luaring_produce(lua_State *L, luaring_t *ring, luaring_queue_t *queue, int ix, unsigned int n, lua_Integer tag)
+{
+	unsigned int tail = queue->tail;
+	unsigned int head = smp_load_acquire(&queue->head);
+	unsigned int i;
+
+	n = min(n, ring->mask + 1 - (tail - head));
+	for (i = 0; i < n; i++) {
+		luaring_slot_t *slot = luaring_slot(ring, queue, tail + i);
+		luaring_setslot(L, slot, ix + i, tag);
+	}
+	smp_store_release(&queue->tail, tail + n);
+	return n;
+}
+
+static unsigned int luaring_consume(lua_State *L, luaring_t *ring, luaring_queue_t *queue, unsigned int n, bool tag)
+{
+	unsigned int head = queue->head;
+	unsigned int tail = smp_load_acquire(&queue->tail);
+	unsigned int i;
+
+	n = min(n, tail - head);
+	for (i = 0; i < n; i++) {
+		luaring_slot_t *slot = luaring_slot(ring, queue, head + i);
+		luaring_pushslot(L, slot);
+		if (tag)
+			lua_pushinteger(L, slot->tag);
+	}
+	/* pushed objects hold their own references; slots must be put before being released */
+	for (i = 0; i < n; i++)
+		luaring_putslot(luaring_slot(ring, queue, head + i));
+	smp_store_release(&queue->head, head + n);
+	return n;
+}
+
+static unsigned int luaring_enqueue(lua_State *L, luaring_t *ring, int ix, unsigned int n, lua_Integer tag)
+{
+	unsigned int pushed;
+
+	if (ring->mpsc) {
+		unsigned long flags;
+
+		local_irq_save(flags);
+		pushed = luaring_produce(L, ring, &ring->queues[smp_processor_id()], ix, n, tag);
+		local_irq_restore(flags);
+	}
+	else
+		pushed = luaring_produce(L, ring, &ring->queues[0], ix, n, tag);
+
+	if (pushed > 0 && wq_has_sleeper(&ring->wait))
+		wake_up(&ring->wait);
+	return pushed;
+}
+
+static unsigned int luaring_dequeue(lua_State *L, luaring_t *ring, unsigned int n, bool tag)
+{
+	unsigned int i, popped = 0;
+
+	for (i = 0; i < ring->nqueues && popped < n; i++) {
+		unsigned int ix = (ring->cursor + i) % ring->nqueues;
+		popped += luaring_consume(L, ring, &ring->queues[ix], n - popped, tag);
+	}
+	ring->cursor = (ring->cursor + 1) % ring->nqueues; /* fairness among producers */
+	return popped;
+}
+
+/***
+* Pushes messages into the ring.
+* Messages are stored into consecutive slots and published at once.
+* It never sleeps; if the ring has not enough free slots, only the first
+* messages are pushed. Strings are copied; objects are passed by reference.
+* @function push
+* @tparam string|object ... Messages to be pushed; each string must fit in a slot.
+* @treturn integer The number of pushed messages.
+* @raise Error if a message is neither a string nor an object, or if it's larger than the slot size.
+* @usage
+*   if r:push(a, b, c) < 3 then dropped = dropped + 1 end
+*/
+static int luaring_push(lua_State *L)
+{
+	luaring_t *ring = luaring_check(L, 1);
+	unsigned int n = lua_gettop(L) - 1;
+	unsigned int i;
+
+	for (i = 0; i < n; i++)
+		luaring_checkmessage(L, ring, i + 2);
+
+	lua_pushinteger(L, (lua_Integer)luaring_enqueue(L, ring, 2, n, 0));
+	return 1;
+}
+
+/***
+* Pushes a tagged message into the ring.
+* @function pushtagged
+* @tparam string|object message The message to be pushed.
+* @tparam integer tag An integer stored alongside the message (e.g., its kind or length).
+* @treturn boolean `true` if the message was pushed, `false` if the ring is full.
+* @raise Error if the message is neither a string nor an object, or if it's larger than the slot size.
+* @usage
+*   -- hands a filled data buffer over to the consumer, without copying it
+*   r:pushtagged(buffer, len)
+*/
+static int luaring_pushtagged(lua_State *L)
+{
+	luaring_t *ring = luaring_check(L, 1);
+	lua_Integer tag = luaL_checkinteger(L, 3);
+
+	luaring_checkmessage(L, ring, 2);
+	lua_pushboolean(L, luaring_enqueue(L, ring, 2, 1, tag) == 1);
+	return 1;
+}
+
+/***
+* Pops messages from the ring.
+* It never sleeps; see `wait`.
+* @function pop
+* @tparam[opt=1] integer n The maximum number of messages to pop.
+* @treturn string|object... Up to `n` messages, in order (per CPU, on `"mpsc"` rings);
+*   nothing, if the ring is empty.
+* @usage
+*   for _, msg in ipairs({r:pop(32)}) do handle(msg) end
+*/
+static int luaring_pop(lua_State *L)
+{
+	luaring_t *ring = luaring_check(L, 1);
+	lua_Integer n = luaL_optinteger(L, 2, 1);
+
+	lunatik_checkbounds(L, 2, n, 1, LUAI_MAXSTACK);
+	luaL_checkstack(L, (int)n, NULL);
+	return (int)luaring_dequeue(L, ring, (unsigned int)n, false);
+}
+
+/***
+* Pops a tagged message from the ring.
+* @function poptagged
+* @treturn string|object The message.
+* @treturn integer Its tag (`0` if it was pushed by `push`).
+* @treturn nil If the ring is empty.
+* @usage
+*   local buffer, len = r:poptagged()
+*/
+static int luaring_poptagged(lua_State *L)
+{
+	luaring_t *ring = luaring_check(L, 1);
+
+	if (luaring_dequeue(L, ring, 1, true) == 0) {
+		lua_pushnil(L);
+		return 1;
+	}
+	return 2;
+}
+
+/***
+* Waits for messages.
+* It must be called by the consumer on a sleepable runtime.
+* Rings can also be waited on along with other sources through `poll.wait`.
+* @function wait
+* @tparam[opt] integer timeout The maximum time to wait, in milliseconds.
+*   If omitted, waits indefinitely.
+* @treturn[1] boolean `true` if there are messages to pop.
+* @treturn[2] nil If it has not received any messages.
+* @treturn[2] string `"timeout"` or `"interrupt"`.
+* @raise Error if called on a non-sleepable runtime.
+*/
+static int luaring_wait(lua_State *L)
+{
+	luaring_t *ring = luaring_check(L, 1);
+	lua_Integer timeout = luaL_optinteger(L, 2, MAX_SCHEDULE_TIMEOUT);
+	long ret;
+
+	lunatik_checkruntime(L, true);
+	ret = wait_event_interruptible_timeout(ring->wait, luaring_pending(ring) > 0,
+		msecs_to_jiffies((unsigned long)timeout));
+	if (ret > 0) {
+		lua_pushboolean(L, true);
+		return 1;
+	}
+
+	lua_pushnil(L);
+	if (ret == 0)
+		lua_pushliteral(L, "timeout");
+	else
+		lua_pushliteral(L, "interrupt");
+	return 2;
+}
+
+/***
+* Gets the number of messages on the ring.
+* @function count
+* @treturn integer The number of pending messages.
+*/
+static int luaring_count(lua_State *L)
+{
+	luaring_t *ring = luaring_check(L, 1);
+	lua_pushinteger(L, (lua_Integer)luaring_pending(ring));
+	return 1;
+}
+
+static void luaring_release(void *private)
+{
+	luaring_t *ring = (luaring_t *)private;
+	unsigned int i;
+
+	for (i = 0; i < ring->nqueues; i++) {
+		luaring_queue_t *queue = &ring->queues[i];
+		unsigned int ix;
+
+		if (queue->slots == NULL)
+			continue;
+
+		for (ix = queue->head; ix != queue->tail; ix++)
+			luaring_putslot(luaring_slot(ring, queue, ix));
+		kvfree(queue->slots);
+	}
+}
+
+static const luaL_Reg luaring_lib[] = {
+	{"new", luaring_new},
+	{NULL, NULL}
+};
+
+static const luaL_Reg luaring_mt[] = {
+	{"__gc", lunatik_deleteobject},
+	{"push", luaring_push},
+	{"pop", luaring_pop},
+	{"pushtagged", luaring_pushtagged},
+	{"poptagged", luaring_poptagged},
+	{"wait", luaring_wait},
+	{"count", luaring_count},
+	{NULL, NULL}
+};
+
+static __poll_t luaring_poll(void *private, lunatik_poll_t *poll)
+{
+	luaring_t *ring = (luaring_t *)private;
+
+	poll_wait(NULL, &ring->wait, &poll->table);
+	return luaring_pending(ring) > 0 ? EPOLLIN | EPOLLRDNORM : 0;
+}
+
+static const lunatik_class_t luaring_class = {
+	.name = "ring",
+	.methods = luaring_mt,
+	.release = luaring_release,
+	.poll = luaring_poll,
+	.sleep = false,
+};
+
+static const char *const luaring_modes[] = {"spsc", "mpsc", NULL};
+
+/***
+* Creates a new message ring.
+* @function new
+* @tparam integer slots The number of slots (per CPU, on `"mpsc"` rings); it's rounded up to a power of two.
+* @tparam[opt=256] integer size The maximum message size, in bytes.
+* @tparam[opt="spsc"] string mode Either `"spsc"` (single producer) or `"mpsc"` (multiple producers).
+* @treturn ring A new ring object.
+* @raise Error if the ring would take more than 256 MiB (summing all queues), or if memory allocation fails.
+* @usage
+*   local r = ring.new(1024, 64, "mpsc")
+* @within ring
+*/
+static int luaring_new(lua_State *L)
+{
+	lua_Integer slots = luaL_checkinteger(L, 1);
+	lua_Integer size = luaL_optinteger(L, 2, LUARING_SIZE);
+	bool mpsc = luaL_checkoption(L, 3, "spsc", luaring_modes) == 1;
+	unsigned int nqueues = mpsc ? nr_cpu_ids : 1;
+	gfp_t gfp = lunatik_gfp(lunatik_toruntime(L));
+	lunatik_object_t *object;
+	luaring_t *ring;
+	size_t length, total, nslots, slotsize;
+	unsigned int i;
+
+	lunatik_checkbounds(L, 1, slots, 1, LUARING_MAXSLOTS);
+	lunatik_checkbounds(L, 2, size, 1, LUARING_MAXSIZE);
+
+	nslots = roundup_pow_of_two((unsigned long)slots);
+	slotsize = ALIGN(sizeof(luaring_slot_t) + (size_t)size, sizeof(long));
+	luaL_argcheck(L, !check_mul_overflow(nslots, slotsize, &length) &&
+		!check_mul_overflow(length, (size_t)nqueues, &total) && total <= LUARING_MAXBYTES, 1, "ring too large");
+
+	object = lunatik_newobject(L, &luaring_class, struct_size(ring, queues, nqueues));
+	ring = (luaring_t *)object->private;
+	memset(ring, 0, struct_size(ring, queues, nqueues));
+
+	init_waitqueue_head(&ring->wait);
+	ring->size = (size_t)size;
+	ring->slotsize = slotsize;
+	ring->mask = nslots - 1;
+	ring->mpsc = mpsc;
+	ring->nqueues = nqueues;
+
+	for (i = 0; i < nqueues; i++)
+		ring->queues[i].slots = lunatik_checknull(L, kvmalloc(length, gfp | __GFP_NOWARN));
+	return 1; /* object */
+}
+
+LUNATIK_NEWLIB(ring, luaring_lib, &luaring_class, NULL);
+
+static int __init luaring_init(void)
+{
+	return 0;
+}
+
+static void __exit luaring_exit(void)
+{
+}
+
+module_init(luaring_init);
+module_exit(luaring_exit);
+MODULE_LICENSE("Dual MIT/GPL");
+MODULE_AUTHOR("Lourival Vieira Neto <lourival.neto@ring-0.io>");
+
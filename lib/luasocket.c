@@ -14,6 +14,7 @@
 * It allows operations such as creating sockets, binding, listening, connecting,
 * sending, and receiving data. The library also exposes constants for address
 * families, socket types, IP protocols, and message flags.
+* Sockets can be waited on along with other sources through `poll.wait`.
 *
 * For higher-level IPv4 TCP/UDP socket operations with string-based IP addresses
 * (e.g., "127.0.0.1"), consider using the `socket.inet` library.
@@ -27,6 +28,10 @@
 #include <linux/string.h>
 #include <linux/net.h>
 #include <linux/un.h>
+#include <linux/fs.h>
+#include <linux/if_ether.h>
+#include <linux/udp.h>
+#include <linux/wait_bit.h>
 #include <net/sock.h>
 #if (LINUX_VERSION_CODE <= KERNEL_VERSION(6, 1, 0))
 #include <linux/l2tp.h>
@@ -38,6 +43,8 @@
 
 #include <lunatik.h>
 
+#include "luadata.h"
+
 #define luasocket_msgaddr(msg, addr, size)	\
 do {						\
 	msg.msg_namelen = size;			\
@@ -48,6 +55,7 @@ do {						\
 
 static int luasocket_new(lua_State *L);
 static int luasocket_accept(lua_State *L);
+static const lunatik_class_t luasocket_class;
 
 #define LUASOCKET_ISUNIX(family)	((family) == AF_UNIX || (family) == AF_LOCAL)
 
@@ -108,10 +116,86 @@ static int luasocket_pushaddr(lua_State *L, struct sockaddr_storage *addr)
 	return n;
 }
 
-LUNATIK_PRIVATECHECKER(luasocket_check, struct socket *);
+typedef struct luasocket_s {
+	struct socket *sock;
+	/* read buffer used by framed receives */
+	char *buffer;
+	size_t size;
+	size_t head;
+	size_t tail;
+	/* splices receiving from this socket and pollers registered on it, which pin it while closing */
+	atomic_t users;
+} luasocket_t;
+
+LUNATIK_PRIVATECHECKER(luasocket_checkprivate, luasocket_t *);
+
+static inline struct socket *luasocket_check(lua_State *L, int ix)
+{
+	struct socket *sock = luasocket_checkprivate(L, ix)->sock;
+	lunatik_argchecknull(L, sock, ix);
+	return sock;
+}
+
+#define luasocket_pending(s)	((s)->tail - (s)->head)
 
 #define luasocket_setmsg(m)		memset(&(m), 0, sizeof(m))
 
+typedef union luasocket_control_u {
+	char buffer[CMSG_SPACE(sizeof(int))];
+	struct cmsghdr align;
+} luasocket_control_t;
+
+#define luasocket_cmsg(control)		((struct cmsghdr *)(control)->buffer)
+
+static void luasocket_checksegment(lua_State *L, int ix, struct msghdr *msg, luasocket_control_t *control)
+{
+	lua_Integer segment = 0;
+	struct cmsghdr *cmsg;
+	int isinteger = 1;
+
+	ix = lua_absindex(L, ix);
+	if (lua_getfield(L, ix, "segment") != LUA_TNIL)
+		segment = lua_tointegerx(L, -1, &isinteger);
+	lua_pop(L, 1);
+	luaL_argcheck(L, isinteger, ix, "segment must be an integer");
+	if (segment == 0)
+		return;
+
+	lunatik_checkbounds(L, ix, segment, 1, U16_MAX);
+	memset(control, 0, sizeof(*control));
+	cmsg = luasocket_cmsg(control);
+	cmsg->cmsg_level = SOL_UDP;
+	cmsg->cmsg_type = UDP_SEGMENT;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(u16));
+	*(u16 *)CMSG_DATA(cmsg) = (u16)segment;
+
+	msg->msg_control = control->buffer;
+	msg->msg_controllen = CMSG_SPACE(sizeof(u16));
+}
+
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(5, 10, 0))
+static inline void luasocket_setgro(struct msghdr *msg, luasocket_control_t *control)
+{
+	memset(control, 0, sizeof(*control));
+	msg->msg_control = control->buffer;
+	msg->msg_controllen = sizeof(control->buffer);
+	msg->msg_control_is_user = false;
+}
+
+static lua_Integer luasocket_getgro(struct msghdr *msg, luasocket_control_t *control)
+{
+	size_t used = sizeof(control->buffer) - msg->msg_controllen;
+	struct cmsghdr *cmsg = luasocket_cmsg(control);
+
+	if (used >= CMSG_LEN(sizeof(int)) && cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO)
+		return (lua_Integer)*(int *)CMSG_DATA(cmsg);
+	return 0;
+}
+#else
+#define luasocket_setgro(msg, control)	((void)(control))
+#define luasocket_getgro(msg, control)	((lua_Integer)0)
+#endif
+
 /***
 * Sends a message through the socket.
 *
@@ -128,6 +212,11 @@ LUNATIK_PRIVATECHECKER(luasocket_check, struct socket *);
 * - For other address families (e.g., `AF_PACKET`): A packed string representing the destination address
 *   (e.g., MAC address for `AF_PACKET`). The exact format depends on the family.
 * @tparam[opt] integer port The destination port number (required if `addr` is an IPv4 address for `AF_INET`).
+* @tparam[opt] table options A table with send options, passed as the last argument:
+*
+* - `segment`: the segment size for UDP segmentation offload (`UDP_SEGMENT`). The message
+*   is split by the stack into datagrams of `segment` bytes (the last one may be shorter),
+*   so that many datagrams are sent at the cost of a single send.
 * @treturn integer The number of bytes sent.
 * @raise Error if the send operation fails or if address parameters are incorrect for the socket type.
 * @usage
@@ -136,6 +225,9 @@ LUNATIK_PRIVATECHECKER(luasocket_check, struct socket *);
 *
 *   -- For a UDP socket (sending to 192.168.1.100, port 1234):
 *   local bytes_sent = udp_sock:send("UDP packet", net.aton("192.168.1.100"), 1234)
+*
+*   -- Sends 64 datagrams of 1200 bytes each through a connected UDP socket:
+*   udp_sock:send(string.rep("x", 64 * 1200), {segment = 1200})
 * @see net.aton
 */
 static int luasocket_send(lua_State *L)
@@ -145,6 +237,7 @@ static int luasocket_send(lua_State *L)
 	struct kvec vec;
 	struct msghdr msg;
 	struct sockaddr_storage addr;
+	luasocket_control_t control;
 	int nargs = lua_gettop(L);
 	int ret;
 
@@ -153,6 +246,11 @@ static int luasocket_send(lua_State *L)
 	vec.iov_base = (void *)luaL_checklstring(L, 2, &len);
 	vec.iov_len = len;
 
+	if (unlikely(lua_istable(L, nargs) && nargs >= 3)) {
+		luasocket_checksegment(L, nargs, &msg, &control);
+		nargs--;
+	}
+
 	if (unlikely(nargs >= 3)) {
 		size_t size = luasocket_checkaddr(L, socket, &addr, 3);
 		luasocket_msgaddr(msg, addr, size);
@@ -172,11 +270,17 @@ static int luasocket_send(lua_State *L)
 *   See the `socket.msg` table for available flags. These can be OR'd together.
 * @tparam[opt=false] boolean from If `true`, the function also returns the sender's address
 *   and port (for `AF_INET`). This is typically used with connectionless sockets (`SOCK_DGRAM`).
-* @treturn string The received message (as a string of bytes).
+* @tparam[opt=false] boolean segment If `true`, the function also returns the segment size of
+*   a coalesced UDP message. It requires the `socket.udp.GRO` option to be set on the socket
+*   (Kernel 5.10+; on older kernels, it's always `0`).
+* @treturn string The received message (as a string of bytes). Data left buffered by
+*   `receiveline`, `receiveuntil` or `receiveframe` is returned first, unless `from` or `segment` is true.
 * @treturn[opt] integer|string addr If `from` is true, the sender's address.
 *   - For `AF_INET`: An integer representing the IPv4 address (can be converted with `net.ntoa()`).
 *   - For other families: A packed string representing the sender's address.
 * @treturn[opt] integer port If `from` is true and the family is `AF_INET`, the sender's port number.
+* @treturn[opt] integer segment If `segment` is true, the size of each datagram coalesced into the
+*   message by GRO; or `0`, if the message is a single datagram.
 * @raise Error if the receive operation fails.
 * @usage
 *   -- For a connected TCP socket:
@@ -186,11 +290,16 @@ static int luasocket_send(lua_State *L)
 *   -- For a UDP socket, getting sender info:
 *   local data, sender_ip_int, sender_port = udp_sock:receive(1500, 0, true)
 *   if data then print("Received from " .. net.ntoa(sender_ip_int) .. ":" .. sender_port .. ": " .. data) end
+*
+*   -- For a UDP socket with GRO enabled, splitting coalesced datagrams:
+*   udp_sock:setsockopt(socket.sol.UDP, socket.udp.GRO, 1)
+*   local data, segment = udp_sock:receive(65535, 0, false, true)
 * @see socket.msg
 * @see net.ntoa
 */
 static int luasocket_receive(lua_State *L)
 {
+	luasocket_t *luasocket = luasocket_checkprivate(L, 1);
 	struct socket *socket = luasocket_check(L, 1);
 	size_t len = (size_t)luaL_checkinteger(L, 2);
 	luaL_Buffer B;
@@ -199,8 +308,19 @@ static int luasocket_receive(lua_State *L)
 	struct sockaddr_storage addr;
 	int flags = luaL_optinteger(L, 3, 0);
 	int from = lua_toboolean(L, 4);
+	int segment = lua_toboolean(L, 5);
+	luasocket_control_t control;
+	int nret = 1;
 	int ret;
 
+	if (unlikely(luasocket_pending(luasocket) > 0 && !from && !segment)) {
+		len = min(len, luasocket_pending(luasocket));
+		lua_pushlstring(L, luasocket->buffer + luasocket->head, len);
+		if (!(flags & MSG_PEEK))
+			luasocket->head += len;
+		return 1;
+	}
+
 	luasocket_setmsg(msg);
 
 	vec.iov_base = (void *)luaL_buffinitsize(L, &B, len);
@@ -209,10 +329,556 @@ static int luasocket_receive(lua_State *L)
 	if (unlikely(from))
 		luasocket_msgaddr(msg, addr, sizeof(addr));
 
+	if (unlikely(segment))
+		luasocket_setgro(&msg, &control);
+
 	lunatik_tryret(L, ret, kernel_recvmsg, socket, &msg, &vec, 1, len, flags);
 	luaL_pushresultsize(&B, ret);
 
-	return unlikely(from) ? luasocket_pushaddr(L, (struct sockaddr_storage *)msg.msg_name) + 1 : 1;
+	if (unlikely(from))
+		nret += luasocket_pushaddr(L, (struct sockaddr_storage *)msg.msg_name);
+
+	if (unlikely(segment)) {
+		lua_pushinteger(L, luasocket_getgro(&msg, &control));
+		nret++;
+	}
+	return nret;
+}
+
+static int luasocket_reserve(luasocket_t *luasocket, size_t size)
+{
+	size_t pending = luasocket_pending(luasocket);
+
+	if (size > luasocket->size) {
+		char *buffer = kvmalloc(size, GFP_KERNEL);
+		if (buffer == NULL)
+			return -ENOMEM;
+
+		if (pending > 0)
+			memcpy(buffer, luasocket->buffer + luasocket->head, pending);
+		kvfree(luasocket->buffer);
+		luasocket->buffer = buffer;
+		luasocket->size = size;
+	}
+	else if (luasocket->head > 0)
+		memmove(luasocket->buffer, luasocket->buffer + luasocket->head, pending);
+
+	luasocket->head = 0;
+	luasocket->tail = pending;
+	return 0;
+}
+
+/* receives more data into the read buffer, keeping at most max bytes pending; returns 0 on EOF */
+static int luasocket_fill(luasocket_t *luasocket, size_t max)
+{
+	struct kvec vec;
+	struct msghdr msg;
+	int ret;
+
+	if (luasocket_pending(luasocket) >= max)
+		return -EMSGSIZE;
+
+	if (luasocket->size < max || luasocket->tail == luasocket->size) {
+		if ((ret = luasocket_reserve(luasocket, max)) < 0)
+			return ret;
+	}
+
+	vec.iov_base = luasocket->buffer + luasocket->tail;
+	vec.iov_len = min(luasocket->size, luasocket->head + max) - luasocket->tail;
+
+	luasocket_setmsg(msg);
+	if ((ret = kernel_recvmsg(luasocket->sock, &msg, &vec, 1, vec.iov_len, 0)) > 0)
+		luasocket->tail += ret;
+	return ret;
+}
+
+/* returns 1 when a frame of *len (up to max) bytes followed by dlen delimiter bytes is at buffer head, 0 on EOF */
+static int luasocket_finddelim(luasocket_t *luasocket, const char *delim, size_t dlen, size_t max, size_t *len)
+{
+	size_t scanned = 0;
+	int ret;
+
+	for (;;) {
+		const char *base = luasocket->buffer + luasocket->head;
+		size_t end = min(luasocket_pending(luasocket), max + dlen);
+
+		for (; scanned + dlen <= end; scanned++) {
+			if (base[scanned] == delim[0] && memcmp(base + scanned, delim, dlen) == 0) {
+				*len = scanned;
+				return 1;
+			}
+		}
+
+		if ((ret = luasocket_fill(luasocket, max + dlen)) <= 0)
+			return ret;
+	}
+}
+
+/* as luasocket_finddelim(), but for lines terminated by "\n" or "\r\n" (skip is the terminator length) */
+static int luasocket_findline(luasocket_t *luasocket, size_t max, size_t *len, size_t *skip)
+{
+	int ret = luasocket_finddelim(luasocket, "\n", 1, max + 1, len);
+
+	*skip = 1;
+	if (ret == 1 && *len > 0 && luasocket->buffer[luasocket->head + *len - 1] == '\r') {
+		(*len)--;
+		*skip = 2;
+	}
+	return ret == 1 && *len > max ? -EMSGSIZE : ret;
+}
+
+/* returns 1 when n bytes are available at buffer head, 0 on EOF */
+static int luasocket_require(luasocket_t *luasocket, size_t n, size_t max)
+{
+	int ret;
+
+	while (luasocket_pending(luasocket) < n) {
+		if ((ret = luasocket_fill(luasocket, max)) <= 0)
+			return ret;
+	}
+	return 1;
+}
+
+static int luasocket_pushframe(lua_State *L, luasocket_t *luasocket, int ret, size_t offset, size_t len, size_t skip)
+{
+	if (ret == 0) {
+		lua_pushnil(L);
+		return 1;
+	}
+	lua_pushlstring(L, luasocket->buffer + luasocket->head + offset, len);
+	luasocket->head += offset + len + skip;
+	if (luasocket->head == luasocket->tail)
+		luasocket->head = luasocket->tail = 0;
+	return 1;
+}
+
+#define LUASOCKET_FRAMEMAX	(1UL << 16)
+
+static inline size_t luasocket_checkframemax(lua_State *L, int ix)
+{
+	lua_Integer max = luaL_optinteger(L, ix, LUASOCKET_FRAMEMAX);
+	lunatik_checkbounds(L, ix, max, 1, INT_MAX);
+	return (size_t)max;
+}
+
+/***
+* Receives a line from the socket.
+* Data is read in bulk into a kernel-side buffer attached to the socket and
+* lines are extracted from it; thus, there is a single receive call for many
+* lines, instead of one call per byte.
+*
+* @function receiveline
+* @tparam[opt=65536] integer max The maximum line length, excluding the line terminator.
+* @treturn string The line, without the trailing `"\n"` (or `"\r\n"`); or `nil`, if the peer
+*   closed the connection before a complete line was received.
+* @raise Error if the receive operation fails or if the line is longer than `max` (`"EMSGSIZE"`).
+* @usage
+*   local request = conn:receiveline()
+* @see receiveuntil
+*/
+static int luasocket_receiveline(lua_State *L)
+{
+	luasocket_t *luasocket = luasocket_checkprivate(L, 1);
+	size_t max = luasocket_checkframemax(L, 2);
+	size_t len = 0, skip;
+	int ret;
+
+	luasocket_check(L, 1);
+	lunatik_tryret(L, ret, luasocket_findline, luasocket, max, &len, &skip);
+	return luasocket_pushframe(L, luasocket, ret, 0, len, skip);
+}
+
+/***
+* Receives data from the socket up to a delimiter.
+*
+* @function receiveuntil
+* @tparam string delimiter The byte sequence that terminates the message.
+* @tparam[opt=65536] integer max The maximum message length, excluding the delimiter.
+* @treturn string The message, without the delimiter; or `nil`, if the peer closed
+*   the connection before the delimiter was received.
+* @raise Error if the receive operation fails or if the message is longer than `max` (`"EMSGSIZE"`).
+* @usage
+*   local headers = conn:receiveuntil("\r\n\r\n")
+* @see receiveline
+*/
+static int luasocket_receiveuntil(lua_State *L)
+{
+	luasocket_t *luasocket = luasocket_checkprivate(L, 1);
+	size_t dlen;
+	const char *delim = luaL_checklstring(L, 2, &dlen);
+	size_t max = luasocket_checkframemax(L, 3);
+	size_t len = 0;
+	int ret;
+
+	luasocket_check(L, 1);
+	luaL_argcheck(L, dlen > 0, 2, "empty delimiter");
+	lunatik_tryret(L, ret, luasocket_finddelim, luasocket, delim, dlen, max, &len);
+	return luasocket_pushframe(L, luasocket, ret, 0, len, dlen);
+}
+
+static size_t luasocket_checkprefix(lua_State *L, int ix, bool *little)
+{
+	const char *fmt = luaL_checkstring(L, ix);
+	size_t n = sizeof(size_t);
+
+#ifdef __LITTLE_ENDIAN
+	*little = true;
+#else
+	*little = false;
+#endif
+	switch (*fmt) {
+	case '<': *little = true; fmt++; break;
+	case '>': case '!': *little = false; fmt++; break;
+	case '=': fmt++; break;
+	}
+
+	luaL_argcheck(L, *fmt++ == 's', ix, "invalid format");
+	if (*fmt != '\0')
+		n = *fmt++ - '0';
+	luaL_argcheck(L, *fmt == '\0' && (n == 1 || n == 2 || n == 4 || n == 8), ix, "invalid format");
+	return n;
+}
+
+static inline u64 luasocket_unpacksize(const u8 *prefix, size_t n, bool little)
+{
+	u64 size = 0;
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		size |= (u64)prefix[little ? i : n - 1 - i] << (8 * i);
+	return size;
+}
+
+static int luasocket_findframe(luasocket_t *luasocket, size_t n, bool little, size_t max, size_t *len)
+{
+	u64 size;
+	int ret;
+
+	if ((ret = luasocket_require(luasocket, n, n + max)) <= 0)
+		return ret;
+
+	size = luasocket_unpacksize((const u8 *)luasocket->buffer + luasocket->head, n, little);
+	if (size > max)
+		return -EMSGSIZE;
+
+	*len = (size_t)size;
+	return luasocket_require(luasocket, n + *len, n + max);
+}
+
+/***
+* Receives a length-prefixed frame from the socket.
+* The prefix follows the `string.pack` format for length-prefixed strings, that is,
+* `"s[n]"` optionally preceded by an endianness option (`"<"`, `">"` or `"="`);
+* thus, frames sent by `sock:send(string.pack(">s2", msg))` are received by
+* `sock:receiveframe(">s2")`.
+*
+* @function receiveframe
+* @tparam string format The length prefix format (e.g., `"s4"`, `">s2"`).
+* @tparam[opt=65536] integer max The maximum frame length, excluding the prefix.
+* @treturn string The frame payload; or `nil`, if the peer closed the connection before
+*   a complete frame was received.
+* @raise Error if the receive operation fails or if the frame is longer than `max` (`"EMSGSIZE"`).
+* @usage
+*   local msg = conn:receiveframe(">s4")
+*/
+static int luasocket_receiveframe(lua_State *L)
+{
+	luasocket_t *luasocket = luasocket_checkprivate(L, 1);
+	bool little;
+	size_t n = luasocket_checkprefix(L, 2, &little);
+	size_t max = luasocket_checkframemax(L, 3);
+	size_t len = 0;
+	int ret;
+
+	luasocket_check(L, 1);
+	lunatik_tryret(L, ret, luasocket_findframe, luasocket, n, little, max, &len);
+	return luasocket_pushframe(L, luasocket, ret, n, len, 0);
+}
+
+#define LUASOCKET_FRAMEHDR	(sizeof(u32))
+#define luasocket_framealign(n)	ALIGN((n), LUASOCKET_FRAMEHDR)
+
+static int luasocket_nextframe(lua_State *L)
+{
+	lunatik_object_t *view = lunatik_toobject(L, lua_upvalueindex(2));
+	lua_Integer count = lua_tointeger(L, lua_upvalueindex(3));
+	size_t offset = (size_t)lua_tointeger(L, lua_upvalueindex(4));
+	size_t size;
+	char *block;
+	u32 len;
+
+	if (count == 0) {
+		luadata_clear(view);
+		return 0;
+	}
+
+	block = (char *)luadata_checkptr(L, lua_upvalueindex(1), &size, false);
+	luaL_argcheck(L, offset + LUASOCKET_FRAMEHDR <= size, 1, "corrupted block");
+	memcpy(&len, block + offset, LUASOCKET_FRAMEHDR);
+	offset += LUASOCKET_FRAMEHDR;
+	luaL_argcheck(L, offset + len <= size, 1, "corrupted block");
+
+	luadata_reset(view, block + offset, len, LUADATA_OPT_NONE);
+
+	lua_pushinteger(L, count - 1);
+	lua_replace(L, lua_upvalueindex(3));
+	lua_pushinteger(L, (lua_Integer)luasocket_framealign(offset + len));
+	lua_replace(L, lua_upvalueindex(4));
+
+	lua_pushvalue(L, lua_upvalueindex(2));
+	lua_pushinteger(L, (lua_Integer)len);
+	return 2; /* frame, length */
+}
+
+#define LUASOCKET_FRAMES	"socket.frames"
+
+static int luasocket_closeframes(lua_State *L)
+{
+	lua_getiuservalue(L, 1, 1);
+	luadata_clear(lunatik_toobject(L, -1));
+	return 0;
+}
+
+static int luasocket_recvframe(struct socket *socket, char *block, size_t *offset, size_t snaplen, int flags)
+{
+	struct kvec vec = {.iov_base = block + *offset + LUASOCKET_FRAMEHDR, .iov_len = snaplen};
+	struct msghdr msg;
+	u32 len;
+	int ret;
+
+	luasocket_setmsg(msg);
+	if ((ret = kernel_recvmsg(socket, &msg, &vec, 1, snaplen, flags)) > 0) {
+		len = (u32)ret;
+		memcpy(block + *offset, &len, LUASOCKET_FRAMEHDR);
+		*offset = luasocket_framealign(*offset + LUASOCKET_FRAMEHDR + len);
+	}
+	return ret;
+}
+
+/***
+* Receives a batch of frames into a data block and iterates over them.
+* It's meant for `AF_PACKET` and datagram sockets: the first receive waits for a
+* frame (unless the socket is non-blocking), then frames already queued on the
+* socket are drained without waiting until the block is full or the queue is empty.
+* Each frame is stored in the block prefixed by its length, in a layout akin to a
+* `TPACKET_V3` block, and is exposed through a single `data` view that is reset
+* to the next frame on each iteration; thus, no string is allocated per frame.
+* The view must not be used after the iteration moves on; it's cleared when the
+* loop ends, including by `break` or by an error, as the iterator is returned
+* with a closing value for the generic `for`.
+*
+* @function frames
+* @tparam data block The writable data object where frames are stored; it can be reused across calls.
+* @tparam[opt=1514] integer snaplen The maximum number of bytes stored per frame; longer frames are truncated.
+* @treturn function An iterator that returns a `data` view and the length of each frame.
+* @treturn integer The number of frames received.
+* @raise Error if the first receive fails or if the block is smaller than a single frame.
+* @usage
+*   local block = data.new(64 * 1024)
+*   for frame, len in sock:frames(block) do
+*     local ethtype = frame:getuint16(12)
+*   end
+* @see data
+*/
+static int luasocket_frames(lua_State *L)
+{
+	struct socket *socket = luasocket_check(L, 1);
+	size_t size;
+	char *block = (char *)luadata_checkptr(L, 2, &size, true);
+	lua_Integer snaplen = luaL_optinteger(L, 3, ETH_FRAME_LEN);
+	size_t offset = 0;
+	lua_Integer count = 0;
+	int ret;
+
+	lunatik_checkbounds(L, 3, snaplen, 1, U32_MAX);
+	luaL_argcheck(L, LUASOCKET_FRAMEHDR + snaplen <= size, 2, "block too small");
+
+	lunatik_tryret(L, ret, luasocket_recvframe, socket, block, &offset, (size_t)snaplen, 0);
+	while (ret > 0) {
+		count++;
+		if (offset + LUASOCKET_FRAMEHDR + snaplen > size)
+			break;
+		ret = luasocket_recvframe(socket, block, &offset, (size_t)snaplen, MSG_DONTWAIT);
+	}
+
+	lua_pushvalue(L, 2); /* block */
+	luadata_new(L); /* view */
+	lua_pushinteger(L, count);
+	lua_pushinteger(L, 0); /* offset */
+	lua_pushcclosure(L, luasocket_nextframe, 4);
+	lua_pushinteger(L, count);
+	lua_pushnil(L); /* control */
+
+	/* closing value of the generic for, which clears the view if the loop is left early */
+	lua_newuserdatauv(L, 0, 1);
+	lua_getupvalue(L, -4, 2); /* view */
+	lua_setiuservalue(L, -2, 1);
+	if (luaL_newmetatable(L, LUASOCKET_FRAMES)) {
+		lua_pushcfunction(L, luasocket_closeframes);
+		lua_setfield(L, -2, "__close");
+	}
+	lua_setmetatable(L, -2);
+	return 4; /* iterator, count, control, closing */
+}
+
+typedef ssize_t (*luasocket_read_t)(void *source, void *buf, size_t len, loff_t *pos);
+
+static ssize_t luasocket_readfile(void *source, void *buf, size_t len, loff_t *pos)
+{
+	return kernel_read((struct file *)source, buf, len, pos);
+}
+
+static ssize_t luasocket_readsocket(void *source, void *buf, size_t len, loff_t *pos)
+{
+	struct kvec vec = {.iov_base = buf, .iov_len = len};
+	struct msghdr msg;
+
+	luasocket_setmsg(msg);
+	return kernel_recvmsg((struct socket *)source, &msg, &vec, 1, len, 0);
+}
+
+/* stores the number of bytes sent, even on failure, as they can't be taken back */
+static int luasocket_sendall(struct socket *socket, char *buf, size_t len, size_t *sent)
+{
+	*sent = 0;
+	while (*sent < len) {
+		struct kvec vec = {.iov_base = buf + *sent, .iov_len = len - *sent};
+		struct msghdr msg;
+		int ret;
+
+		luasocket_setmsg(msg);
+		if ((ret = kernel_sendmsg(socket, &msg, &vec, 1, vec.iov_len)) <= 0)
+			return ret < 0 ? ret : -EPIPE;
+		*sent += ret;
+	}
+	return 0;
+}
+
+/* moves data from source to socket using a single kernel page as bounce buffer */
+static ssize_t luasocket_transfer(struct socket *socket, luasocket_read_t read, void *source, loff_t *pos, size_t len)
+{
+	char *buf = (char *)__get_free_page(GFP_KERNEL);
+	size_t total = 0;
+	ssize_t ret = 0;
+
+	if (buf == NULL)
+		return -ENOMEM;
+
+	while (total < len) {
+		size_t sent;
+
+		if ((ret = read(source, buf, min_t(size_t, len - total, PAGE_SIZE), pos)) <= 0)
+			break;
+
+		ret = luasocket_sendall(socket, buf, ret, &sent);
+		total += sent;
+		if (ret < 0)
+			break;
+	}
+
+	free_page((unsigned long)buf);
+	return total > 0 ? (ssize_t)total : ret;
+}
+
+static ssize_t luasocket_transferfile(struct socket *socket, const char *path, loff_t pos, size_t len)
+{
+	struct file *file = filp_open(path, O_RDONLY, 0);
+	ssize_t ret;
+
+	if (IS_ERR(file))
+		return PTR_ERR(file);
+
+	ret = luasocket_transfer(socket, luasocket_readfile, file, &pos, len);
+	filp_close(file, NULL);
+	return ret;
+}
+
+#define luasocket_optlength(L, ix)	((size_t)luaL_optinteger((L), (ix), LUA_MAXINTEGER))
+
+/***
+* Sends the contents of a file through the socket.
+* The file is read and sent in kernel space, one page at a time; thus, its
+* contents are never copied into Lua memory.
+*
+* @function sendfile
+* @tparam string path The path of the file to be sent (e.g., "/var/www/index.html").
+* @tparam[opt=0] integer offset The file offset where sending starts.
+* @tparam[opt] integer length The maximum number of bytes to send. If omitted, sends until the end of the file.
+* @treturn integer The number of bytes sent.
+* @raise Error if the file cannot be opened or read, or if the send operation fails before any byte is sent.
+* @usage
+*   local sent = conn:sendfile("/var/www/index.html")
+*/
+static int luasocket_sendfile(lua_State *L)
+{
+	struct socket *socket = luasocket_check(L, 1);
+	const char *path = luaL_checkstring(L, 2);
+	lua_Integer offset = luaL_optinteger(L, 3, 0);
+	size_t len = luasocket_optlength(L, 4);
+	ssize_t ret;
+
+	luaL_argcheck(L, offset >= 0, 3, "out of bounds");
+	lunatik_tryret(L, ret, luasocket_transferfile, socket, path, (loff_t)offset, len);
+	lua_pushinteger(L, (lua_Integer)ret);
+	return 1;
+}
+
+static inline void luasocket_unpin(luasocket_t *luasocket)
+{
+	if (atomic_dec_and_test(&luasocket->users))
+		wake_up_var(&luasocket->users);
+}
+
+static ssize_t luasocket_transfersocket(struct socket *socket, luasocket_t *source, size_t len)
+{
+	ssize_t ret = luasocket_transfer(socket, luasocket_readsocket, source->sock, NULL, len);
+
+	luasocket_unpin(source);
+	return ret;
+}
+
+/***
+* Forwards data received from another socket through this socket.
+* The data is moved in kernel space, one page at a time, until `length` bytes
+* have been forwarded or the peer of the source socket closes the connection.
+* It's meant for proxies; for bidirectional forwarding, each direction should
+* be spliced by its own thread. Closing `from` meanwhile ends the splice, as if
+* its peer had closed the connection. Data left buffered on `from` by framed
+* receives (e.g., `receiveline`) is not forwarded.
+*
+* @function splice
+* @tparam socket from The socket to receive data from.
+* @tparam[opt] integer length The maximum number of bytes to forward. If omitted, forwards until the end of the stream.
+* @treturn integer The number of bytes forwarded.
+* @raise Error if receiving or sending fails before any byte is forwarded.
+* @usage
+*   -- forwards everything the client sends to the upstream server
+*   upstream:splice(client)
+*/
+static int luasocket_splice(lua_State *L)
+{
+	struct socket *socket = luasocket_check(L, 1);
+	lunatik_object_t *from = *(lunatik_object_t **)luaL_checkudata(L, 2, luasocket_class.name);
+	size_t len = luasocket_optlength(L, 3);
+	luasocket_t *source;
+	ssize_t ret;
+
+	luaL_argcheck(L, from != lunatik_toobject(L, 1), 2, "cannot splice a socket to itself");
+	/* from isn't locked while forwarding, as its other direction may be spliced meanwhile;
+	 * instead, it's pinned, so closing it shuts it down and waits for this splice to return */
+	lunatik_argchecknull(L, from, 2);
+	lunatik_lock(from);
+	source = (luasocket_t *)from->private;
+	if (source != NULL && source->sock != NULL)
+		atomic_inc(&source->users);
+	else
+		source = NULL;
+	lunatik_unlock(from);
+
+	lunatik_argchecknull(L, source, 2);
+	lunatik_tryret(L, ret, luasocket_transfersocket, socket, source, len);
+	lua_pushinteger(L, (lua_Integer)ret);
+	return 1;
 }
 
 /***
@@ -308,6 +974,49 @@ static int luasocket_connect(lua_State *L)
 	return 0;
 }
 
+static int luasocket_setopt(struct socket *socket, int level, int optname, int value)
+{
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(5, 9, 0))
+	sockptr_t optval = KERNEL_SOCKPTR(&value);
+
+	if (level == SOL_SOCKET)
+		return sock_setsockopt(socket, level, optname, optval, sizeof(value));
+	return socket->ops->setsockopt == NULL ? -EOPNOTSUPP :
+		socket->ops->setsockopt(socket, level, optname, optval, sizeof(value));
+#elif (LINUX_VERSION_CODE < KERNEL_VERSION(5, 8, 0))
+	return kernel_setsockopt(socket, level, optname, (char *)&value, sizeof(value));
+#else
+	return -EOPNOTSUPP;
+#endif
+}
+
+/***
+* Sets an integer socket option.
+*
+* @function setsockopt
+* @tparam integer level The protocol level of the option (e.g., `socket.sol.UDP`).
+* @tparam integer optname The option (e.g., `socket.udp.GRO`).
+* @tparam integer|boolean value The option value; booleans are converted to `1` or `0`.
+* @treturn nil
+* @raise Error if the option cannot be set (e.g., `"EOPNOTSUPP"` on Kernel 5.8).
+* @usage
+*   udp_sock:setsockopt(socket.sol.UDP, socket.udp.GRO, true)
+*   tcp_server_sock:setsockopt(socket.sol.SOCKET, socket.so.REUSEADDR, 1)
+* @see socket.sol
+* @see socket.so
+* @see socket.udp
+*/
+static int luasocket_setsockopt(lua_State *L)
+{
+	struct socket *socket = luasocket_check(L, 1);
+	int level = (int)luaL_checkinteger(L, 2);
+	int optname = (int)luaL_checkinteger(L, 3);
+	int value = lua_isboolean(L, 4) ? lua_toboolean(L, 4) : (int)luaL_checkinteger(L, 4);
+
+	lunatik_try(L, luasocket_setopt, socket, level, optname, value);
+	return 0;
+}
+
 #define LUASOCKET_NEWGETTER(what) 						\
 static int luasocket_get##what(lua_State *L)					\
 {										\
@@ -352,6 +1061,19 @@ LUASOCKET_NEWGETTER(sockname);
 */
 LUASOCKET_NEWGETTER(peername);
 
+static void luasocket_shutdown(struct socket *sock)
+{
+	struct sock *sk = sock->sk;
+
+	/* sockets that can't be shut down (e.g., AF_PACKET) are marked as such, so blocked receives return */
+	if (kernel_sock_shutdown(sock, SHUT_RDWR) != 0) {
+		lock_sock(sk);
+		WRITE_ONCE(sk->sk_shutdown, SHUTDOWN_MASK);
+		release_sock(sk);
+	}
+	sk->sk_state_change(sk); /* wakes up pollers */
+}
+
 /***
 * Closes the socket.
 * This shuts down the socket for both reading and writing and releases
@@ -364,9 +1086,16 @@ LUASOCKET_NEWGETTER(peername);
 */
 static void luasocket_release(void *private)
 {
-	struct socket *sock = (struct socket *)private;
-	kernel_sock_shutdown(sock, SHUT_RDWR);
-	sock_release(sock);
+	luasocket_t *luasocket = (luasocket_t *)private;
+	struct socket *sock = luasocket->sock;
+
+	if (sock != NULL)
+		luasocket_shutdown(sock);
+	/* the shutdown ends splices and wakes pollers up; it's released once they are gone */
+	wait_var_event(&luasocket->users, atomic_read(&luasocket->users) == 0);
+	if (sock != NULL)
+		sock_release(sock);
+	kvfree(luasocket->buffer);
 }
 
 static const luaL_Reg luasocket_lib[] = {
@@ -381,10 +1110,17 @@ static const luaL_Reg luasocket_mt[] = {
 	{"close", lunatik_closeobject},
 	{"send", luasocket_send},
 	{"receive", luasocket_receive},
+	{"receiveline", luasocket_receiveline},
+	{"receiveuntil", luasocket_receiveuntil},
+	{"receiveframe", luasocket_receiveframe},
+	{"frames", luasocket_frames},
+	{"sendfile", luasocket_sendfile},
+	{"splice", luasocket_splice},
 	{"bind", luasocket_bind},
 	{"listen", luasocket_listen},
 	{"accept", luasocket_accept},
 	{"connect", luasocket_connect},
+	{"setsockopt", luasocket_setsockopt},
 	{"getsockname", luasocket_getsockname},
 	{"getpeername", luasocket_getpeername},
 	{NULL, NULL}
@@ -674,24 +1410,122 @@ static const lunatik_reg_t luasocket_ipproto[] = {
 	{NULL, 0}
 };
 
+/***
+* Table of socket option level constants, used by `sock:setsockopt()`.
+* (Constants from `<linux/socket.h>`)
+* @table sol
+*   @tfield integer SOCKET Socket-level options (see `socket.so`).
+*   @tfield integer IP IPv4 options.
+*   @tfield integer IPV6 IPv6 options.
+*   @tfield integer TCP TCP options.
+*   @tfield integer UDP UDP options (see `socket.udp`).
+*   @tfield integer PACKET Packet socket options.
+* @within socket
+*/
+static const lunatik_reg_t luasocket_sol[] = {
+	{"SOCKET", SOL_SOCKET},
+	{"IP", SOL_IP},
+	{"IPV6", SOL_IPV6},
+	{"TCP", SOL_TCP},
+	{"UDP", SOL_UDP},
+	{"PACKET", SOL_PACKET},
+	{NULL, 0}
+};
+
+/***
+* Table of socket-level option constants, used with `socket.sol.SOCKET`.
+* (Constants from `<uapi/asm-generic/socket.h>`)
+* @table so
+*   @tfield integer REUSEADDR Allows reuse of local addresses.
+*   @tfield integer REUSEPORT Allows multiple sockets to bind to the same port.
+*   @tfield integer KEEPALIVE Enables keep-alive messages.
+*   @tfield integer BROADCAST Allows sending broadcast datagrams.
+*   @tfield integer SNDBUF Send buffer size.
+*   @tfield integer RCVBUF Receive buffer size.
+*   @tfield integer PRIORITY Protocol-defined priority of the sent packets.
+*   @tfield integer MARK Mark of the sent packets.
+* @within socket
+*/
+static const lunatik_reg_t luasocket_so[] = {
+	{"REUSEADDR", SO_REUSEADDR},
+	{"REUSEPORT", SO_REUSEPORT},
+	{"KEEPALIVE", SO_KEEPALIVE},
+	{"BROADCAST", SO_BROADCAST},
+	{"SNDBUF", SO_SNDBUF},
+	{"RCVBUF", SO_RCVBUF},
+	{"PRIORITY", SO_PRIORITY},
+	{"MARK", SO_MARK},
+	{NULL, 0}
+};
+
+/***
+* Table of UDP option constants, used with `socket.sol.UDP`.
+* (Constants from `<uapi/linux/udp.h>`)
+* @table udp
+*   @tfield integer CORK Never sends partially complete segments.
+*   @tfield integer SEGMENT Default segment size for UDP segmentation offload (see `sock:send()`).
+*   @tfield integer GRO Enables coalescing of received datagrams (see `sock:receive()`).
+* @within socket
+*/
+static const lunatik_reg_t luasocket_udp[] = {
+	{"CORK", UDP_CORK},
+	{"SEGMENT", UDP_SEGMENT},
+	{"GRO", UDP_GRO},
+	{NULL, 0}
+};
+
 static const lunatik_namespace_t luasocket_flags[] = {
 	{"af", luasocket_af},
 	{"msg", luasocket_msg},
 	{"sock", luasocket_sock},
 	{"ipproto", luasocket_ipproto},
+	{"sol", luasocket_sol},
+	{"so", luasocket_so},
+	{"udp", luasocket_udp},
 	{NULL, NULL}
 };
 
+static __poll_t luasocket_poll(void *private, lunatik_poll_t *poll)
+{
+	luasocket_t *luasocket = (luasocket_t *)private;
+	struct socket *socket = luasocket->sock;
+	__poll_t events;
+
+	if (!poll_does_not_wait(&poll->table))
+		atomic_inc(&luasocket->users); /* until unpoll() */
+
+	if (socket == NULL)
+		return EPOLLNVAL;
+
+	events = socket->ops->poll(NULL, socket, &poll->table);
+	if (luasocket_pending(luasocket) > 0) /* buffered by receiveline(), receiveuntil() or receiveframe() */
+		events |= EPOLLIN | EPOLLRDNORM;
+	return events;
+}
+
+static void luasocket_unpoll(void *private)
+{
+	luasocket_unpin((luasocket_t *)private);
+}
+
 static const lunatik_class_t luasocket_class = {
 	.name = "socket",
 	.methods = luasocket_mt,
 	.release = luasocket_release,
+	.poll = luasocket_poll,
+	.unpoll = luasocket_unpoll,
 	.sleep = true,
-	.pointer = true,
+	.pointer = false,
 };
 
-#define luasocket_newsocket(L)		(lunatik_newobject((L), &luasocket_class, 0))
-#define luasocket_psocket(object)	((struct socket **)&object->private)
+static inline lunatik_object_t *luasocket_newsocket(lua_State *L)
+{
+	lunatik_object_t *object = lunatik_newobject(L, &luasocket_class, sizeof(luasocket_t));
+	memset(object->private, 0, sizeof(luasocket_t));
+	return object;
+}
+
+#define luasocket_psocket(object)	(&((luasocket_t *)(object)->private)->sock)
 
 /***
 * Accepts a connection on a listening socket.
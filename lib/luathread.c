@@ -15,6 +15,9 @@
 #include <linux/kernel.h>
 #include <linux/module.h>
 #include <linux/kthread.h>
+#include <linux/cpumask.h>
+#include <linux/sched.h>
+#include <uapi/linux/sched/types.h>
 
 #include <lua.h>
 #include <lualib.h>
@@ -198,6 +201,128 @@ static const lunatik_class_t luathread_class = {
 
 #define luathread_new(L)	(lunatik_newobject((L), &luathread_class, sizeof(luathread_t)))
 
+typedef struct luathread_attr_s {
+	int cpu;
+	struct cpumask *mask;
+	int policy;
+	int priority;
+	int nice;
+} luathread_attr_t;
+
+static const char *const luathread_policies[] = {"normal", "fifo", "rr", "batch", "idle", NULL};
+static const int luathread_policy[] = {SCHED_NORMAL, SCHED_FIFO, SCHED_RR, SCHED_BATCH, SCHED_IDLE};
+
+#define luathread_isrt(policy)	((policy) == SCHED_FIFO || (policy) == SCHED_RR)
+
+static inline lua_Integer luathread_optfield(lua_State *L, int ix, const char *field, lua_Integer def)
+{
+	lua_Integer value;
+
+	lua_getfield(L, ix, field);
+	value = luaL_optinteger(L, -1, def);
+	lua_pop(L, 1);
+	return value;
+}
+
+static struct cpumask *luathread_checkmask(lua_State *L, int ix)
+{
+	/* userdata memory is collected by Lua, so it doesn't leak if we raise an error */
+	struct cpumask *mask = (struct cpumask *)lua_newuserdatauv(L, cpumask_size(), 0);
+	int cpus = lua_absindex(L, -2);
+
+	cpumask_clear(mask);
+	if (lua_isinteger(L, cpus)) {
+		u64 bits = (u64)lua_tointeger(L, cpus);
+		unsigned int cpu;
+
+		for (cpu = 0; cpu < min_t(unsigned int, nr_cpu_ids, 64); cpu++)
+			if (bits & BIT_ULL(cpu))
+				cpumask_set_cpu(cpu, mask);
+	}
+	else {
+		lua_Integer i, n;
+
+		luaL_argcheck(L, lua_istable(L, cpus), ix, "cpumask must be a table or an integer");
+		n = (lua_Integer)luaL_len(L, cpus);
+		for (i = 1; i <= n; i++) {
+			lua_Integer cpu;
+
+			lua_geti(L, cpus, i);
+			cpu = luaL_checkinteger(L, -1);
+			lunatik_checkbounds(L, ix, cpu, 0, nr_cpu_ids - 1);
+			cpumask_set_cpu((unsigned int)cpu, mask);
+			lua_pop(L, 1);
+		}
+	}
+	luaL_argcheck(L, cpumask_intersects(mask, cpu_online_mask), ix, "cpumask has no online CPU");
+	return mask;
+}
+
+static void luathread_checkattr(lua_State *L, int ix, luathread_attr_t *attr)
+{
+	attr->cpu = -1;
+	attr->mask = NULL;
+	attr->policy = SCHED_NORMAL;
+	attr->priority = 0;
+	attr->nice = 0;
+
+	if (lua_isnoneornil(L, ix))
+		return;
+
+	luaL_checktype(L, ix, LUA_TTABLE);
+
+	attr->cpu = (int)luathread_optfield(L, ix, "cpu", -1);
+	if (attr->cpu >= 0)
+		luaL_argcheck(L, attr->cpu < nr_cpu_ids && cpu_online(attr->cpu), ix, "cpu isn't online");
+
+	if (lua_getfield(L, ix, "cpumask") != LUA_TNIL)
+		attr->mask = luathread_checkmask(L, ix); /* leaves the mask on the stack */
+	else
+		lua_pop(L, 1);
+
+	if (lua_getfield(L, ix, "policy") != LUA_TNIL)
+		attr->policy = luathread_policy[luaL_checkoption(L, -1, NULL, luathread_policies)];
+	lua_pop(L, 1);
+
+	attr->priority = (int)luathread_optfield(L, ix, "priority", luathread_isrt(attr->policy) ? MAX_RT_PRIO / 2 : 0);
+	if (luathread_isrt(attr->policy))
+		lunatik_checkbounds(L, ix, attr->priority, 1, MAX_RT_PRIO - 1);
+
+	attr->nice = (int)luathread_optfield(L, ix, "nice", 0);
+	lunatik_checkbounds(L, ix, attr->nice, MIN_NICE, MAX_NICE);
+}
+
+static int luathread_setattr(struct task_struct *task, luathread_attr_t *attr)
+{
+	int ret;
+
+	if (attr->cpu >= 0)
+		kthread_bind(task, attr->cpu);
+	else if (attr->mask != NULL && (ret = set_cpus_allowed_ptr(task, attr->mask)) < 0)
+		return ret;
+
+	if (attr->policy != SCHED_NORMAL) {
+		struct sched_attr sched = {
+			.size = sizeof(struct sched_attr),
+			.sched_policy = attr->policy,
+			.sched_priority = attr->priority,
+			.sched_nice = attr->nice,
+		};
+		return sched_setattr_nocheck(task, &sched);
+	}
+	set_user_nice(task, attr->nice);
+	return 0;
+}
+
+static int luathread_start(struct task_struct *task, luathread_attr_t *attr)
+{
+	int ret = luathread_setattr(task, attr);
+
+	if (ret < 0)
+		kthread_stop(task); /* has never run */
+	return ret;
+}
+
 /***
 * Creates and starts a new kernel thread to run a Lua task.
 * The Lua task is defined by a function returned from the script loaded into the provided `runtime` environment.
@@ -208,8 +333,17 @@ static const lunatik_class_t luathread_class = {
 *   (e.g., loaded via `lunatik.runtime("path/to/script.lua")`) must return a function.
 *   This function will be executed in the new kernel thread.
 * @tparam string name A descriptive name for the kernel thread (e.g., as shown in `ps` or `top`).
+* @tparam[opt] table options Placement and scheduling options, applied before the thread starts:
+*
+* - `cpu`: the online CPU the thread is bound to.
+* - `cpumask`: the CPUs the thread is allowed to run on, either as an array of CPU numbers or
+*   as an integer bitmask (for the first 64 CPUs). Ignored if `cpu` is set.
+* - `policy`: the scheduling policy, one of `"normal"` (default), `"fifo"`, `"rr"`, `"batch"` or `"idle"`.
+* - `priority`: the real-time priority (1-99) for `"fifo"` and `"rr"`; defaults to 50.
+* - `nice`: the nice value (-20 to 19) for the other policies; defaults to 0.
 * @treturn thread A new thread object representing the created kernel thread.
-* @raise Error if the runtime is not sleepable, if memory allocation fails, or if `kthread_run` fails.
+* @raise Error if the runtime is not sleepable, if an option is invalid, if memory allocation fails,
+*   or if the thread cannot be created.
 * @usage
 * -- main_script.lua
 * local lunatik = require("lunatik")
@@ -217,6 +351,8 @@ static const lunatik_class_t luathread_class = {
 * -- Assume "worker_script.lua" returns a function: function() print("worker running") while not thread.shouldstop() do linux.schedule(1000) end print("worker stopped") end
 * local worker_rt = lunatik.runtime("worker_script.lua")
 * local new_thread = thread.run(worker_rt, "my_lua_worker")
+* -- pinned to CPU 2 with a real-time priority
+* local rt_thread = thread.run(lunatik.runtime("worker_script.lua"), "rt_worker", {cpu = 2, policy = "fifo", priority = 10})
 * @see lunatik.runtime
 * @within thread
 */
@@ -225,17 +361,27 @@ static int luathread_run(lua_State *L)
 	lunatik_object_t *runtime = lunatik_checkobject(L, 1);
 	luaL_argcheck(L, runtime->sleep, 1, "cannot use non-sleepable runtime in this context");
 	const char *name = luaL_checkstring(L, 2);
-	lunatik_object_t *object = luathread_new(L);
-	luathread_t *thread = object->private;
+	luathread_attr_t attr;
+	lunatik_object_t *object;
+	luathread_t *thread;
+	struct task_struct *task;
+
+	luathread_checkattr(L, 3, &attr);
+	object = luathread_new(L);
+	thread = object->private;
+
+	task = kthread_create(luathread_func, object, "%s", name);
+	if (IS_ERR(task))
+		luaL_error(L, "failed to create a new thread");
+
+	lunatik_try(L, luathread_start, task, &attr);
 
 	lunatik_getobject(object);
 	lunatik_getobject(runtime);
 	thread->runtime = runtime;
+	thread->task = task;
 
-	thread->task = kthread_run(luathread_func, object, name);
-	if (IS_ERR(thread->task))
-		luaL_error(L, "failed to create a new thread");
-
+	wake_up_process(task);
 	return 1; /* object */
 }
 
@@ -0,0 +1,498 @@
+/*
+* SPDX-FileCopyrightText: (c) 2025 Ring Zero Desenvolvimento de Software LTDA
+* SPDX-License-Identifier: MIT OR GPL-2.0-only
+*/
+
+/***
+* One-shot and periodic timers.
+* This library runs Lua callbacks after a given interval, without keeping a
+* kernel thread per timer. All timers of a runtime are kept in a single
+* wheel, sorted by expiration, which is driven by a single kernel timer
+* programmed to the earliest expiration. Non-sleepable runtimes are driven
+* by a high-resolution timer (`hrtimer`), whose callbacks run in softirq
+* context; sleepable runtimes are driven by delayed work, whose callbacks
+* run in process context (and with jiffy granularity).
+*
+* Timers belong to the runtime that created them and can only be handled by it.
+* A timer is kept alive while it is active, even if the script doesn't hold a
+* reference to it.
+*
+* Timers can also be waited on along with other sources through `poll.wait`;
+* a timer is ready when it is due, and its callback runs as soon as the
+* runtime is released.
+*
+* @module timer
+*/
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/version.h>
+#include <linux/hrtimer.h>
+#include <linux/workqueue.h>
+#include <linux/ktime.h>
+#include <linux/list.h>
+
+#include <lua.h>
+#include <lualib.h>
+#include <lauxlib.h>
+
+#include <lunatik.h>
+
+#define LUATIMER_WHEEL	"timer.wheel"
+
+static char luatimer_wheelkey; /* registry key of the runtime wheel */
+
+typedef struct luatimer_wheel_s {
+	union {
+		struct hrtimer hrtimer;
+		struct delayed_work work;
+	};
+	lunatik_object_t *runtime;
+	struct list_head timers; /* sorted by expiration */
+	ktime_t next;
+	bool sleep;
+} luatimer_wheel_t;
+
+/***
+* Represents a timer.
+* This is a userdata object returned by `timer.new()`.
+* @type timer
+*/
+typedef struct luatimer_s {
+	struct list_head entry;
+	luatimer_wheel_t *wheel;
+	lunatik_object_t *object;
+	lunatik_object_t *runtime;
+	ktime_t expires;
+	ktime_t interval;
+	ktime_t slack;
+	bool periodic;
+} luatimer_t;
+
+static int luatimer_new(lua_State *L);
+
+static inline bool luatimer_active(luatimer_t *timer)
+{
+	return !list_empty(&timer->entry);
+}
+
+static void luatimer_program(luatimer_wheel_t *wheel)
+{
+	luatimer_t *first;
+
+	if (list_empty(&wheel->timers))
+		return;
+
+	first = list_first_entry(&wheel->timers, luatimer_t, entry);
+	if (ktime_compare(first->expires, wheel->next) == 0)
+		return; /* already programmed */
+
+	wheel->next = first->expires;
+	if (wheel->sleep) {
+		s64 delay = ktime_to_ns(ktime_sub(first->expires, ktime_get()));
+		mod_delayed_work(system_wq, &wheel->work, delay > 0 ? nsecs_to_jiffies(delay) : 0);
+	}
+	else
+		hrtimer_start_range_ns(&wheel->hrtimer, first->expires, (u64)ktime_to_ns(first->slack), HRTIMER_MODE_ABS_SOFT);
+}
+
+static void luatimer_insert(luatimer_wheel_t *wheel, luatimer_t *timer)
+{
+	luatimer_t *pos;
+
+	list_for_each_entry_reverse(pos, &wheel->timers, entry) {
+		if (ktime_compare(pos->expires, timer->expires) <= 0) {
+			list_add(&timer->entry, &pos->entry);
+			return;
+		}
+	}
+	list_add(&timer->entry, &wheel->timers);
+}
+
+static int luatimer_call(lua_State *L)
+{
+	lunatik_object_t *object = (lunatik_object_t *)lua_touserdata(L, 1);
+
+	if (lunatik_getregistry(L, object) != LUA_TUSERDATA) /* timer */
+		return 0;
+
+	lua_pushvalue(L, -1);
+	if (lua_rawget(L, 2) != LUA_TFUNCTION) /* callbacks[timer] */
+		return luaL_error(L, "could not find timer callback");
+
+	lua_insert(L, -2);
+	lua_call(L, 1, 0); /* callback(timer) */
+	return 0;
+}
+
+static void luatimer_unanchor(lua_State *L, luatimer_t *timer)
+{
+	lua_pushnil(L);
+	lunatik_setregistry(L, -1, timer->object);
+	lua_pop(L, 1);
+}
+
+static int luatimer_handler(lua_State *L, luatimer_wheel_t *wheel)
+{
+	ktime_t now = ktime_get();
+	luatimer_t *timer, *next;
+	LIST_HEAD(expired);
+	int callbacks;
+
+	wheel->next = KTIME_MAX;
+	if (unlikely(!lunatik_isready(L))) { /* the script is still being loaded */
+		now = ktime_add_ms(now, 1);
+		list_for_each_entry(timer, &wheel->timers, entry)
+			timer->expires = ktime_after(timer->expires, now) ? timer->expires : now;
+		luatimer_program(wheel);
+		return 0;
+	}
+
+	/* timers due within their slack are coalesced into this run */
+	list_for_each_entry_safe(timer, next, &wheel->timers, entry)
+		if (ktime_compare(ktime_sub(timer->expires, timer->slack), now) <= 0)
+			list_move_tail(&timer->entry, &expired);
+
+	lua_rawgetp(L, LUA_REGISTRYINDEX, &luatimer_wheelkey);
+	lua_getiuservalue(L, -1, 1);
+	callbacks = lua_gettop(L);
+
+	while (!list_empty(&expired)) {
+		timer = list_first_entry(&expired, luatimer_t, entry);
+		list_del_init(&timer->entry);
+
+		lunatik_getobject(timer->object); /* the callback might drop the last reference */
+		if (timer->periodic) {
+			timer->expires = ktime_add(timer->expires, timer->interval);
+			if (ktime_before(timer->expires, now)) /* overrun */
+				timer->expires = ktime_add(now, timer->interval);
+			luatimer_insert(wheel, timer);
+		}
+
+		lua_pushcfunction(L, luatimer_call);
+		lua_pushlightuserdata(L, timer->object);
+		lua_pushvalue(L, callbacks);
+		if (lua_pcall(L, 2, 0, 0) != LUA_OK) {
+			pr_err("%s\n", lua_tostring(L, -1));
+			lua_pop(L, 1);
+		}
+
+		if (!luatimer_active(timer) && timer->wheel != NULL)
+			luatimer_unanchor(L, timer);
+		lunatik_putobject(timer->object);
+	}
+
+	luatimer_program(wheel);
+	return 0;
+}
+
+static enum hrtimer_restart luatimer_hrtimer(struct hrtimer *hrtimer)
+{
+	luatimer_wheel_t *wheel = container_of(hrtimer, luatimer_wheel_t, hrtimer);
+	int ret;
+
+	lunatik_run(wheel->runtime, luatimer_handler, ret, wheel);
+	return HRTIMER_NORESTART;
+}
+
+static void luatimer_work(struct work_struct *work)
+{
+	luatimer_wheel_t *wheel = container_of(to_delayed_work(work), luatimer_wheel_t, work);
+	int ret;
+
+	lunatik_run(wheel->runtime, luatimer_handler, ret, wheel);
+}
+
+static int luatimer_wheelgc(lua_State *L)
+{
+	luatimer_wheel_t *wheel = (luatimer_wheel_t *)luaL_checkudata(L, 1, LUATIMER_WHEEL);
+	luatimer_t *timer, *next;
+
+	if (wheel->sleep)
+		cancel_delayed_work_sync(&wheel->work);
+	else
+		hrtimer_cancel(&wheel->hrtimer);
+
+	list_for_each_entry_safe(timer, next, &wheel->timers, entry) {
+		list_del_init(&timer->entry);
+		timer->wheel = NULL;
+	}
+	return 0;
+}
+
+static luatimer_wheel_t *luatimer_getwheel(lua_State *L)
+{
+	lunatik_object_t *runtime = lunatik_toruntime(L);
+	luatimer_wheel_t *wheel;
+
+	if (lua_rawgetp(L, LUA_REGISTRYINDEX, &luatimer_wheelkey) == LUA_TUSERDATA) {
+		wheel = (luatimer_wheel_t *)lua_touserdata(L, -1);
+		lua_pop(L, 1);
+		return wheel;
+	}
+	lua_pop(L, 1);
+
+	wheel = (luatimer_wheel_t *)lua_newuserdatauv(L, sizeof(luatimer_wheel_t), 1);
+	memset(wheel, 0, sizeof(luatimer_wheel_t));
+	INIT_LIST_HEAD(&wheel->timers);
+	wheel->runtime = runtime;
+	wheel->sleep = runtime->sleep;
+	wheel->next = KTIME_MAX;
+	if (wheel->sleep)
+		INIT_DELAYED_WORK(&wheel->work, luatimer_work);
+	else {
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(6, 13, 0))
+		hrtimer_setup(&wheel->hrtimer, luatimer_hrtimer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS_SOFT);
+#else
+		hrtimer_init(&wheel->hrtimer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS_SOFT);
+		wheel->hrtimer.function = luatimer_hrtimer;
+#endif
+	}
+
+	lua_newtable(L); /* callbacks */
+	lua_newtable(L); /* ephemeron: callbacks don't keep their timers alive */
+	lua_pushliteral(L, "k");
+	lua_setfield(L, -2, "__mode");
+	lua_setmetatable(L, -2);
+	lua_setiuservalue(L, -2, 1);
+
+	if (luaL_newmetatable(L, LUATIMER_WHEEL)) {
+		lua_pushcfunction(L, luatimer_wheelgc);
+		lua_setfield(L, -2, "__gc");
+	}
+	lua_setmetatable(L, -2);
+
+	/* the wheel lives as long as the runtime */
+	lunatik_setregistry(L, -1, &luatimer_wheelkey);
+	lua_pop(L, 1);
+	return wheel;
+}
+
+static inline luatimer_t *luatimer_check(lua_State *L, int ix)
+{
+	luatimer_t *timer = (luatimer_t *)lunatik_checkobject(L, ix)->private;
+
+	lunatik_argchecknull(L, timer, ix);
+	luaL_argcheck(L, timer->runtime == lunatik_toruntime(L), ix, "timer belongs to another runtime");
+	luaL_argcheck(L, timer->wheel != NULL, ix, "timer has been released");
+	return timer;
+}
+
+static inline ktime_t luatimer_checkinterval(lua_State *L, int ix)
+{
+	lua_Integer ms = luaL_checkinteger(L, ix);
+	luaL_argcheck(L, ms >= 0, ix, "out of bounds");
+	return ms_to_ktime(ms);
+}
+
+static void luatimer_start(lua_State *L, int ix, luatimer_t *timer)
+{
+	if (luatimer_active(timer))
+		list_del_init(&timer->entry);
+	else
+		lunatik_setregistry(L, ix, timer->object); /* keep the timer alive while active */
+
+	timer->expires = ktime_add(ktime_get(), timer->interval);
+	luatimer_insert(timer->wheel, timer);
+	luatimer_program(timer->wheel);
+}
+
+/***
+* Starts or restarts a timer.
+* If the timer is active, its expiration is pushed forward.
+* @function start
+* @tparam[opt] integer interval A new interval in milliseconds.
+* @treturn nil
+* @usage
+*   t:start(500) -- fires 500 ms from now
+*/
+static int luatimer_lstart(lua_State *L)
+{
+	luatimer_t *timer = luatimer_check(L, 1);
+
+	if (!lua_isnoneornil(L, 2))
+		timer->interval = luatimer_checkinterval(L, 2);
+	luatimer_start(L, 1, timer);
+	return 0;
+}
+
+/***
+* Cancels a timer.
+* A cancelled timer can be started again by `timer:start()`.
+* @function cancel
+* @treturn boolean `true` if the timer was active, `false` otherwise.
+* @usage
+*   t:cancel()
+*/
+static int luatimer_cancel(lua_State *L)
+{
+	luatimer_t *timer = luatimer_check(L, 1);
+	bool active = luatimer_active(timer);
+
+	if (active) {
+		list_del_init(&timer->entry);
+		luatimer_unanchor(L, timer);
+	}
+	lua_pushboolean(L, active);
+	return 1;
+}
+
+/***
+* Checks whether a timer is active.
+* @function active
+* @treturn boolean `true` if the timer is waiting to fire, `false` otherwise.
+*/
+static int luatimer_lactive(lua_State *L)
+{
+	luatimer_t *timer = luatimer_check(L, 1);
+	lua_pushboolean(L, luatimer_active(timer));
+	return 1;
+}
+
+/***
+* Gets the time remaining until a timer fires.
+* @function remaining
+* @treturn integer The remaining time in milliseconds, or `nil` if the timer isn't active.
+*/
+static int luatimer_remaining(lua_State *L)
+{
+	luatimer_t *timer = luatimer_check(L, 1);
+	s64 remaining;
+
+	if (!luatimer_active(timer))
+		return 0;
+
+	remaining = ktime_to_ms(ktime_sub(timer->expires, ktime_get()));
+	lua_pushinteger(L, remaining > 0 ? (lua_Integer)remaining : 0);
+	return 1;
+}
+
+static void luatimer_release(void *private)
+{
+	luatimer_t *timer = (luatimer_t *)private;
+
+	/* only reachable while active when the runtime is being closed */
+	if (timer->wheel != NULL && luatimer_active(timer))
+		list_del_init(&timer->entry);
+}
+
+static const luaL_Reg luatimer_lib[] = {
+	{"new", luatimer_new},
+	{NULL, NULL}
+};
+
+static const luaL_Reg luatimer_mt[] = {
+	{"__gc", lunatik_deleteobject},
+	{"start", luatimer_lstart},
+	{"cancel", luatimer_cancel},
+	{"active", luatimer_lactive},
+	{"remaining", luatimer_remaining},
+	{NULL, NULL}
+};
+
+/* timers have no wait queue; instead, they bound how long the poller might sleep */
+static __poll_t luatimer_poll(void *private, lunatik_poll_t *poll)
+{
+	luatimer_t *timer = (luatimer_t *)private;
+
+	if (timer->wheel == NULL || !luatimer_active(timer))
+		return 0;
+
+	if (ktime_compare(timer->expires, ktime_get()) <= 0)
+		return EPOLLIN | EPOLLRDNORM;
+
+	if (ktime_before(timer->expires, poll->deadline))
+		poll->deadline = timer->expires;
+	return 0;
+}
+
+static const lunatik_class_t luatimer_class = {
+	.name = "timer",
+	.methods = luatimer_mt,
+	.release = luatimer_release,
+	.poll = luatimer_poll,
+	.sleep = false,
+};
+
+/***
+* Creates and starts a new timer.
+* The callback runs in the context of the timer's runtime: in softirq context for
+* non-sleepable runtimes and in process context for sleepable ones.
+* @function new
+* @tparam function callback The function called when the timer fires; it receives the timer object.
+* @tparam integer interval The interval in milliseconds until the timer fires.
+* @tparam[opt] table options A table with the following optional fields:
+*
+* - `periodic`: if `true`, the timer fires every `interval` milliseconds until cancelled (default `false`).
+* - `slack`: how late, in milliseconds, the timer might fire (default `0`). Timers with slack
+*   might also fire up to `slack` milliseconds early, so they are coalesced with others.
+* @treturn timer A new active timer object.
+* @raise Error if the interval is invalid or memory allocation fails.
+* @usage
+*   local timer = require("timer")
+*   local flush = timer.new(function (t) stats:flush() end, 1000, {periodic = true, slack = 100})
+*   local once  = timer.new(function () print("fired") end, 10)
+* @within timer
+*/
+static int luatimer_new(lua_State *L)
+{
+	ktime_t interval;
+	luatimer_wheel_t *wheel;
+	lunatik_object_t *object;
+	luatimer_t *timer;
+
+	luaL_checktype(L, 1, LUA_TFUNCTION);
+	interval = luatimer_checkinterval(L, 2);
+	if (!lua_isnoneornil(L, 3))
+		luaL_checktype(L, 3, LUA_TTABLE);
+
+	wheel = luatimer_getwheel(L);
+	object = lunatik_newobject(L, &luatimer_class, sizeof(luatimer_t));
+	timer = (luatimer_t *)object->private;
+
+	INIT_LIST_HEAD(&timer->entry);
+	timer->wheel = wheel;
+	timer->object = object;
+	timer->runtime = lunatik_toruntime(L);
+	timer->interval = interval;
+	timer->periodic = false;
+	timer->slack = 0;
+
+	if (lua_istable(L, 3)) {
+		lua_getfield(L, 3, "periodic");
+		timer->periodic = lua_toboolean(L, -1);
+		lua_getfield(L, 3, "slack");
+		timer->slack = ms_to_ktime(luaL_optinteger(L, -1, 0));
+		lua_pop(L, 2);
+		luaL_argcheck(L, ktime_to_ns(timer->slack) >= 0, 3, "invalid slack");
+	}
+	luaL_argcheck(L, !timer->periodic || ktime_to_ns(interval) > 0, 2, "periodic timers need an interval");
+
+	lua_rawgetp(L, LUA_REGISTRYINDEX, &luatimer_wheelkey);
+	lua_getiuservalue(L, -1, 1);
+	lua_pushvalue(L, -3); /* timer */
+	lua_pushvalue(L, 1); /* callback */
+	lua_rawset(L, -3); /* callbacks[timer] = callback */
+	lua_pop(L, 2);
+
+	luatimer_start(L, -1, timer);
+	return 1; /* object */
+}
+
+LUNATIK_NEWLIB(timer, luatimer_lib, &luatimer_class, NULL);
+
+static int __init luatimer_init(void)
+{
+	return 0;
+}
+
+static void __exit luatimer_exit(void)
+{
+}
+
+module_init(luatimer_init);
+module_exit(luatimer_exit);
+MODULE_LICENSE("Dual MIT/GPL");
+MODULE_AUTHOR("Lourival Vieira Neto <lourival.neto@ring-0.io>");
+
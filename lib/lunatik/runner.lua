@@ -14,6 +14,7 @@
 local lunatik = require("lunatik")
 local thread  = require("thread")
 local rcu     = require("rcu")
+local cpu     = require("cpu")
 
 local env = lunatik._ENV
 
@@ -74,13 +75,76 @@ local function stop(registry, script)
 	end
 end
 
+--- Spawns one instance of a Lunatik script per online CPU, each in its own kernel thread bound to that CPU.
+-- Each instance runs in its own runtime and is registered as "script@cpu" (e.g., "worker@0");
+-- thus, `runner.stop(script)` stops all of them.
+-- @tparam string script The path or name of the Lua script to spawn.
+-- @tparam[opt] table options Scheduling options passed to `thread.run` (e.g., `{policy = "fifo"}`); `cpu` is set per instance.
+-- @param ... Additional arguments to pass to the script's main function.
+-- @treturn table An array of the kernel thread objects, indexed by CPU number plus one.
+-- @raise error if the script is already running, or if any instance fails to spawn
+--   (the instances spawned by this call are stopped beforehand).
+-- @see thread.run
+function runner.spawnall(script, options, ...)
+	local script = trim(script)
+	local name = string.match(script, "(%w*/*%w*)$")
+	local args = table.pack(...)
+	local threads, keys = {}, {}
+
+	if env.runtimes[script] then
+		error(string.format("%s is already running", script))
+	end
+
+	local ok, err = pcall(cpu.foreach_online, function (n)
+		local key = string.format("%s@%d", script, n)
+		if env.runtimes[key] then
+			error(string.format("%s is already running", key))
+		end
+
+		local attr = {cpu = n}
+		for k, v in pairs(options or {}) do
+			if k ~= "cpu" and k ~= "cpumask" then
+				attr[k] = v
+			end
+		end
+
+		local runtime = lunatik.runtime(script, table.unpack(args, 1, args.n))
+		env.runtimes[key] = runtime
+		table.insert(keys, key)
+		local t = thread.run(runtime, string.format("%s/%d", name, n), attr)
+		env.threads[key] = t
+		threads[n + 1] = t
+	end)
+	if not ok then
+		-- stops the instances spawned so far, but not the ones already running
+		for _, key in ipairs(keys) do
+			stop(env.threads, key)
+			stop(env.runtimes, key)
+		end
+		error(err, 0)
+	end
+	return threads
+end
+
 --- Stops a running script and its associated thread, if any.
 -- It attempts to stop the thread first, then the runtime.
 -- @tparam string script The name of the script to stop. The ".lua" extension will be trimmed.
 function runner.stop(script)
 	local script = trim(script)
+	local instances = {}
 	stop(env.threads, script)
 	stop(env.runtimes, script)
+
+	local prefix = script .. "@"
+	rcu.map(env.runtimes, function (key)
+		if key:sub(1, #prefix) == prefix then
+			table.insert(instances, key)
+		end
+	end)
+	for _, key in ipairs(instances) do
+		stop(env.threads, key)
+		stop(env.runtimes, key)
+	end
 end
 
 --- Lists the names of all currently running scripts.
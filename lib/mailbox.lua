@@ -12,6 +12,12 @@
 -- Mailboxes are unidirectional (`inbox` for receiving only, `outbox` for sending only).
 -- Messages are serialized as strings.
 --
+-- Many inboxes (e.g., on worker runtimes) might share a FIFO and completion,
+-- each message being received by one of them. Otherwise, an inbox created as
+-- exclusive drains all bytes available on the FIFO at once and keeps them,
+-- so a burst of messages costs a single FIFO access and wake-up
+-- (see `MailBox:receive_many` and `MailBox:send_many`).
+--
 -- @module mailbox
 -- @see fifo
 -- @see completion
@@ -19,6 +25,7 @@
 
 local fifo       = require("fifo")
 local completion = require("completion")
+local linux      = require("linux")
 
 ---
 -- The main mailbox table.
@@ -31,6 +38,9 @@ local mailbox = {}
 -- @type MailBox
 -- @field queue (fifo) The underlying FIFO queue used for message storage.
 -- @field event (completion) The completion object used for synchronization.
+-- @field exclusive (boolean) Whether `queue` is consumed by a single, exclusive, inbox.
+-- @field buffer (string) Bytes drained from the queue but not yet received (exclusive inboxes only).
+-- @field offset (number) The position of the next message on `buffer`.
 local MailBox = {}
 MailBox.__index = MailBox
 
@@ -40,16 +50,20 @@ MailBox.__index = MailBox
 -- @param e (completion) [optional] An existing completion object. If nil and `q` is a number, a new completion is created.
 -- @param allowed (string) The allowed operation ("send" or "receive").
 -- @param forbidden (string) The forbidden operation ("send" or "receive").
+-- @param exclusive (boolean) [optional] Whether the FIFO is consumed by a single inbox.
 -- @return (MailBox) The new mailbox object.
 -- @local
-local function new(q, e, allowed, forbidden)
+local function new(q, e, allowed, forbidden, exclusive)
 	local mbox = {}
 	if type(q) == 'userdata' then
 		mbox.queue, mbox.event = q, e
 	else
 		mbox.queue, mbox.event = fifo.new(q), completion.new()
 	end
+	mbox.exclusive = exclusive == true
+	mbox.buffer, mbox.offset = "", 1
 	mbox[forbidden] = function () error(allowed .. "-only mailbox") end
+	mbox[forbidden .. "_many"] = mbox[forbidden]
 	return setmetatable(mbox, MailBox)
 end
 
@@ -59,12 +73,15 @@ end
 --   If a number, a new FIFO with this capacity will be created.
 -- @param e (completion) [optional] An existing completion object. If nil and `q` is a number,
 --   a new completion object will be created.
+-- @param exclusive (boolean) [optional] If `true`, this inbox must be the single consumer of
+--   the FIFO; then, it drains all pending messages at once. Defaults to `false`.
 -- @return (MailBox) A new inbox object.
 -- @usage
 --   local my_inbox = mailbox.inbox(10) -- Inbox with capacity for 10 messages
 --   local msg = my_inbox:receive()
-function mailbox.inbox(q, e)
-	return new(q, e, 'receive', 'send')
+--   local events = mailbox.inbox(queue, event, true) -- the single consumer of queue
+function mailbox.inbox(q, e, exclusive)
+	return new(q, e, 'receive', 'send', exclusive)
 end
 
 ---
@@ -73,42 +90,155 @@ end
 --   If a number, a new FIFO with this capacity will be created.
 -- @param e (completion) [optional] An existing completion object. If nil and `q` is a number,
 --   a new completion object will be created.
+-- @param exclusive (boolean) [optional] If `true`, the FIFO must be consumed by a single, exclusive,
+--   inbox; then, `send_many` wakes it up only once. Defaults to `false`.
 -- @return (MailBox) A new outbox object.
 -- @usage
 --   local my_outbox = mailbox.outbox(10) -- Outbox with capacity for 10 messages
 --   my_outbox:send("hello")
-function mailbox.outbox(q, e)
-	return new(q, e, 'send', 'receive')
+function mailbox.outbox(q, e, exclusive)
+	return new(q, e, 'send', 'receive', exclusive)
 end
 
 local sizeoft = string.packsize("T")
 
+---
+-- Pops a single message from the queue, as inboxes sharing it do.
+-- @local
+local function pop(self)
+	local queue = self.queue
+	local header, header_size = queue:pop(sizeoft)
+
+	if header_size == 0 then
+		return nil
+	elseif header_size < sizeoft then
+		error("malformed message")
+	end
+
+	return queue:pop(string.unpack("T", header))
+end
+
+---
+-- Drains all bytes available on the queue into the mailbox buffer.
+-- The wake-ups of the messages being drained are consumed beforehand; thus,
+-- the completion only holds wake-ups of messages pushed afterwards.
+-- @local
+local function fetch(self)
+	local event = self.event
+	while event:trywait() do end
+
+	local data, size = self.queue:pop()
+	if size > 0 then
+		self.buffer = self.offset > #self.buffer and data or self.buffer:sub(self.offset) .. data
+		self.offset = 1
+	end
+end
+
+---
+-- Takes the next message from the mailbox buffer.
+-- @local
+local function take(self)
+	local buffer, offset = self.buffer, self.offset
+	if offset > #buffer then
+		return nil
+	end
+
+	local ok, message, nextoffset = pcall(string.unpack, "s", buffer, offset)
+	if not ok then error("malformed message") end
+	self.offset = nextoffset
+	return message
+end
+
+---
+-- Takes up to `max` messages, draining the queue only if the buffer is empty.
+-- @local
+local function takemany(self, messages, max)
+	if self.offset > #self.buffer then
+		fetch(self)
+	end
+	while #messages < max do
+		local message = take(self)
+		if not message then break end
+		table.insert(messages, message)
+	end
+	return messages
+end
+
+---
+-- Waits for a wake-up, raising an error on timeout or interruption.
+-- @local
+local function wait(self, timeout)
+	local ok, err = self.event:wait(timeout)
+	if not ok then error(err) end
+end
+
+---
+-- Takes up to `max` messages on an exclusive inbox, blocking until there is one.
+-- A wake-up might belong to a message already drained; thus, it waits again
+-- (for the remaining time) until a message arrives.
+-- @local
+local function takewait(self, max, timeout)
+	local messages = takemany(self, {}, max)
+	local deadline = timeout and timeout >= 0 and linux.time() + timeout * 1000000
+	local remaining = timeout
+	while #messages == 0 do
+		if deadline then
+			remaining = math.min(math.max((deadline - linux.time()) // 1000000, 0), timeout)
+		end
+		wait(self, remaining)
+		takemany(self, messages, max)
+	end
+	return messages
+end
+
 ---
 -- Receives a message from the mailbox.
--- This function will block until a message is available or the timeout expires.
+-- This function blocks until a message is available or the timeout expires.
 -- Not available on outboxes.
 -- @function MailBox:receive
--- @tparam[opt] number timeout The maximum time to wait in jiffies.
---   If omitted or negative, waits indefinitely. If 0, returns immediately.
+-- @tparam[opt] number timeout The maximum time to wait in milliseconds.
+--   If omitted or negative, waits indefinitely.
 -- @treturn[1] string The received message.
--- @treturn[1] nil If no message is received (e.g., FIFO is empty after event or on timeout).
+-- @treturn[1] nil If no message is received (e.g., FIFO is empty after event on a shared inbox).
 -- @treturn[2] string Error message if the wait times out or another error occurs.
 -- @raise Error if called on an outbox, or if the underlying event wait fails,
 --   or if a malformed message is encountered.
 function MailBox:receive(timeout)
-	local ok, err = self.event:wait(timeout)
-	if not ok then error(err) end
+	if self.exclusive then
+		return takewait(self, 1, timeout)[1]
+	end
 
-	local queue = self.queue
-	local header, header_size = queue:pop(sizeoft)
+	wait(self, timeout)
+	return pop(self)
+end
 
-	if header_size == 0 then
-		return nil
-	elseif header_size < sizeoft then
-		error("malformed message")
+---
+-- Receives up to `max` messages from the mailbox.
+-- It only blocks if there is no message pending. Exclusive inboxes drain all
+-- messages pending on the FIFO at once; shared ones take a message per
+-- pending wake-up. Not available on outboxes.
+-- @function MailBox:receive_many
+-- @tparam number max The maximum number of messages to receive.
+-- @tparam[opt] number timeout The maximum time to wait in milliseconds.
+--   If omitted or negative, waits indefinitely.
+-- @treturn table An array with the received messages.
+-- @raise Error if called on an outbox, or if the underlying event wait fails,
+--   or if a malformed message is encountered.
+-- @usage
+--   for _, event in ipairs(inbox:receive_many(64, 100)) do export(event) end
+function MailBox:receive_many(max, timeout)
+	if self.exclusive then
+		return takewait(self, max, timeout)
 	end
 
-	return queue:pop(string.unpack("T", header))
+	wait(self, timeout)
+	local messages = {pop(self)}
+	while #messages < max and self.event:trywait() do
+		local message = pop(self)
+		if not message then break end
+		table.insert(messages, message)
+	end
+	return messages
 end
 
 ---
@@ -122,5 +252,28 @@ function MailBox:send(message)
 	self.event:complete()
 end
 
+---
+-- Sends many messages to the mailbox at once.
+-- Messages are pushed into the FIFO by a single operation. Exclusive outboxes
+-- wake the inbox up once; otherwise, there is a wake-up per message, as each
+-- one might be received by a different inbox. Not available on inboxes.
+-- @function MailBox:send_many
+-- @tparam table messages An array of strings.
+-- @raise Error if called on an inbox, or if the messages don't fit in the FIFO
+--   (in which case none of them is sent).
+function MailBox:send_many(messages)
+	local packed = {}
+	for i, message in ipairs(messages) do
+		packed[i] = string.pack("s", message)
+	end
+	if #packed > 0 then
+		local event = self.event
+		self.queue:push(table.concat(packed))
+		for _ = 1, self.exclusive and 1 or #packed do
+			event:complete()
+		end
+	end
+end
+
 return mailbox
 
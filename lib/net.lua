@@ -7,47 +7,35 @@
 -- Network utility functions.
 -- This module provides helper functions for network-related operations,
 -- primarily for converting between string and integer representations of IPv4 addresses.
+-- They are implemented in C by the `inet` library, which also handles IPv6
+-- addresses and prefixes.
 -- @module net
+-- @see inet
 --
 
+local inet = require("inet")
+
 local net = {}
 
 ---
 -- Converts an IPv4 address string to its integer representation.
 -- "Address to Number"
+-- @function aton
 -- @param addr (string) The IPv4 address string (e.g., "127.0.0.1").
--- @return (number) The IPv4 address as an integer.
+-- @return (number) The IPv4 address as an integer, or nil if `addr` isn't a valid IPv4 address.
 -- @usage
 --   local ip_int = net.aton("192.168.1.1")
-function net.aton(addr)
-	local i = 1
-	local bits = { 24, 16, 8, 0 }
-	local ip = 0
-	for n in string.gmatch(addr, "(%d+)") do
-		n = tonumber(n) & 0xFF
-		ip = ip | (n << bits[i])
-		i = i + 1
-	end
-	return ip
-end
+net.aton = inet.aton
 
 ---
 -- Converts an integer representation of an IPv4 address to its string form.
 -- "Number to Address"
+-- @function ntoa
 -- @param ip (number) The IPv4 address as an integer.
 -- @return (string) The IPv4 address string (e.g., "127.0.0.1").
 -- @usage
 --   local ip_str = net.ntoa(3232235777)  -- "192.168.1.1"
-function net.ntoa(ip)
-	local n = 4
-	local bytes = {}
-	for i = 1, n do
-		local shift = (n - i) * 8
-		local mask = 0xFF << shift
-		bytes[i] = (ip & mask) >> shift
-	end
-	return table.concat(bytes, ".")
-end
+net.ntoa = inet.ntoa
 
 return net
 
@@ -77,11 +77,16 @@ end
 -- @param msg (string) The message to send.
 -- @param addr (string) [optional] The destination IP address (e.g., for UDP).
 -- @param port (number) [optional] The destination port (e.g., for UDP).
+-- @param options (table) [optional] Send options (e.g., `{segment = 1200}`); it can also
+-- be passed in place of `addr` for connected sockets.
 -- @return (boolean or nil) True on success, or nil and an error message on failure.
 -- @see socket.send
-function inet:send(msg, addr, port)
+function inet:send(msg, addr, port, options)
 	local sock = self.socket
-	return not addr and sock:send(msg) or sock:send(msg, net.aton(addr), port)
+	if type(addr) == "table" then
+		return sock:send(msg, addr)
+	end
+	return not addr and sock:send(msg) or sock:send(msg, net.aton(addr), port, options)
 end
 
 ---
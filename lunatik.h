@@ -11,6 +11,8 @@
 #include <linux/slab.h>
 #include <linux/kref.h>
 #include <linux/errname.h>
+#include <linux/poll.h>
+#include <linux/ktime.h>
 
 #include <lua.h>
 #include <lauxlib.h>
@@ -72,10 +74,20 @@ typedef struct lunatik_namespace_s {
 	const lunatik_reg_t *reg;
 } lunatik_namespace_t;
 
+typedef struct lunatik_poll_s {
+	poll_table table;
+	ktime_t deadline;	/* earliest time a source becomes ready by itself (e.g., timers) */
+} lunatik_poll_t;
+
 typedef struct lunatik_class_s {
 	const char *name;
 	const luaL_Reg *methods;
 	void (*release)(void *);
+	/* returns the ready events and registers on the object wait queues through poll_wait();
+	 * it's called with the object locked and, if the object might be closed meanwhile,
+	 * it must pin the wait queues on registering until unpoll() is called */
+	__poll_t (*poll)(void *, lunatik_poll_t *);
+	void (*unpoll)(void *);
 	bool sleep;
 	bool pointer;
 } lunatik_class_t;
@@ -197,6 +209,7 @@ int lunatik_monitorobject(lua_State *L);
 #define lunatik_newpobject(L, n)	(lunatik_object_t **)lua_newuserdatauv((L), sizeof(lunatik_object_t *), (n))
 #define lunatik_argchecknull(L, o, i)	luaL_argcheck((L), (o) != NULL, (i), LUNATIK_ERR_NULLPTR)
 #define lunatik_checkobject(L, i)	(*lunatik_checkpobject((L), (i)))
+#define lunatik_checkruntime(L, i)	(*(lunatik_object_t **)luaL_checkudata((L), (i), "lunatik"))
 #define lunatik_toobject(L, i)		(*(lunatik_object_t **)lua_touserdata((L), (i)))
 #define lunatik_getobject(o)		kref_get(&(o)->kref)
 #define lunatik_putobject(o)		kref_put(&(o)->kref, lunatik_releaseobject)
@@ -0,0 +1,71 @@
+--
+-- SPDX-FileCopyrightText: (c) 2025 Ring Zero Desenvolvimento de Software LTDA
+-- SPDX-License-Identifier: MIT OR GPL-2.0-only
+--
+
+local acomp = require"crypto.acomp"
+local data = require("data")
+local test = require("util").test
+
+local original = string.rep("abcdefghijklmnopqrstuvwxyz", 100) .. string.rep("A", 500) .. string.rep("B", 500)
+
+test("ACOMP compress empty string (error)", function()
+	local c = acomp.new"lz4"
+	local status, err = pcall(c.compress, c, "")
+	assert(not status, "Compressing empty string should return an error")
+	assert(err:find"out of bounds", "Error should indicate out of bounds, got: " .. tostring(err))
+end)
+
+test("ACOMP compress and decompress with automatic sizing", function()
+	local c = acomp.new"lz4"
+	local compressed = c:compress(original)
+	assert(#compressed < #original, "Compressed data should be smaller than original")
+	assert(c:decompress(compressed) == original, "Decompressed data should match original")
+end)
+
+test("ACOMP compress data range", function()
+	local c = acomp.new"lz4"
+	local d = data.new(#original + 16)
+	d:setstring(8, original)
+	local compressed = c:compress(d, 8, #original)
+	assert(c:decompress(compressed) == original, "Decompressed range should match original")
+end)
+
+test("ACOMP compress_into and decompress_into", function()
+	local c = acomp.new"lz4"
+	local out = data.new(#original)
+	local n = c:compress_into(out, 0, #out, original)
+	assert(n > 0 and n < #original, "compress_into should return the compressed length")
+
+	local plain = data.new(#original)
+	local m = c:decompress_into(plain, 0, #plain, out, 0, n)
+	assert(m == #original, "decompress_into should return the original length")
+	assert(plain:getstring(0) == original, "Decompressed data should match original")
+
+	local status = pcall(c.decompress_into, c, plain, 0, 16, out, 0, n)
+	assert(not status, "decompress_into a short range should return an error")
+end)
+
+test("ACOMP update and finish", function()
+	local c = acomp.new("lz4", 1024)
+	local frames = {}
+	for i = 1, #original, 700 do
+		table.insert(frames, c:update(original:sub(i, i + 699)))
+	end
+	table.insert(frames, c:finish())
+	assert(c:finish() == "", "finish should reset the stream")
+
+	frames = table.concat(frames)
+	local chunks, pos = {}, 1
+	while pos <= #frames do
+		local clen, rlen
+		clen, rlen, pos = string.unpack(">I4I4", frames, pos)
+		local chunk = c:decompress(frames:sub(pos, pos + clen - 1))
+		assert(#chunk == rlen, "frame header should hold the original length")
+		table.insert(chunks, chunk)
+		pos = pos + clen
+	end
+	assert(#chunks == math.ceil(#original / 1024), "each full chunk should be a frame")
+	assert(table.concat(chunks) == original, "Decompressed stream should match original")
+end)
+
@@ -98,3 +98,60 @@ test("AEAD AES-128-GCM decrypt with authentication failure", function()
 	assert(err == err_msg, "Error message should be '" .. err_msg .. "', got: " .. err)
 end)
 
+
+test("AEAD AES-128-GCM per-CPU encrypt and decrypt", function()
+	local c = aead.new("gcm(aes)", true)
+	c:setkey"0123456789abcdef"
+	c:setauthsize(16)
+	assert(c:authsize() == 16, "per-CPU authsize should be 16 bytes")
+
+	local expected = hex2bin"95be1ddc3dd13cdd2d8ffcc391561ade661d5b696ede5a918e"
+	local result = c:encrypt("abcdefghijkl", "plaintext", "0123456789abcdef")
+	assert(result == expected, "Expected: " .. bin2hex(expected) .. ", got: " .. bin2hex(result))
+	assert(c:decrypt("abcdefghijkl", expected, "0123456789abcdef") == "plaintext", "per-CPU decrypt mismatch")
+end)
+
+test("AEAD AES-128-GCM encrypt_into and decrypt_into", function()
+	local data = require("data")
+	local c = aead.new"gcm(aes)"
+	c:setkey"0123456789abcdef"
+	c:setauthsize(16)
+
+	local aad = "0123456789abcdef"
+	local expected = hex2bin"95be1ddc3dd13cdd2d8ffcc391561ade661d5b696ede5a918e"
+	local d = data.new(#aad + #expected)
+	d:setstring(0, aad .. "plaintext")
+	c:encrypt_into(d, 0, #d, "abcdefghijkl", #aad)
+	local result = d:getstring(#aad)
+	assert(result == expected, "Expected: " .. bin2hex(expected) .. ", got: " .. bin2hex(result))
+
+	c:decrypt_into(d, 0, #d, "abcdefghijkl", #aad)
+	assert(d:getstring(#aad, #"plaintext") == "plaintext", "in-place decrypt mismatch")
+end)
+
+test("AEAD AES-128-GCM round trip without AAD", function()
+	local c = aead.new"gcm(aes)"
+	c:setkey"0123456789abcdef"
+	c:setauthsize(16)
+
+	local sealed, taglen = c:encrypt("abcdefghijkl", "plaintext")
+	assert(#sealed == #"plaintext" + taglen, "sealed data should hold the ciphertext and the tag")
+	assert(c:decrypt("abcdefghijkl", sealed) == "plaintext", "round trip mismatch")
+end)
+
+test("AEAD AES-128-GCM seal_batch and open_batch", function()
+	local c = aead.new"gcm(aes)"
+	c:setkey"0123456789abcdef"
+	c:setauthsize(16)
+
+	local iv, aad = "abcdefghijkl", "0123456789abcdef"
+	local expected = hex2bin"95be1ddc3dd13cdd2d8ffcc391561ade661d5b696ede5a918e"
+	local tampered = hex2bin"95be1ddc3dd13cdd2d8ffcc391561ade661d5b696ede5a918f"
+
+	local sealed = c:seal_batch({iv, iv}, {"plaintext", "plaintext"}, {aad, aad})
+	assert(sealed[1] == expected and sealed[2] == expected, "batched seal mismatch")
+
+	local opened = c:open_batch({iv, iv}, {expected, tampered}, {aad, aad})
+	assert(opened[1] == "plaintext", "batched open mismatch")
+	assert(opened[2] == EBADMSG, "batched open of tampered data should fail with EBADMSG")
+end)
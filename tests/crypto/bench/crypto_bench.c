@@ -0,0 +1,316 @@
+/*
+* SPDX-FileCopyrightText: (c) 2025 Ring Zero Desenvolvimento de Software LTDA
+* SPDX-License-Identifier: MIT OR GPL-2.0-only
+*/
+
+/*
+* Baseline for the crypto binding benchmarks (see tests/crypto/bench/suite.lua).
+* It runs the same cases by calling the Linux Kernel Crypto API directly and
+* logs them in the same format, tagged as "native". The benchmarks run on
+* module load; the module can be unloaded right after.
+*
+* Usage:
+* $ make CONFIG_LUNATIK_CRYPTO_BENCH=m
+* $ sudo insmod tests/crypto/bench/crypto_bench.ko [duration=200] && sudo rmmod crypto_bench
+* $ sudo dmesg | grep BENCH
+*/
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/scatterlist.h>
+#include <linux/crypto.h>
+#include <linux/version.h>
+#include <crypto/hash.h>
+#include <crypto/skcipher.h>
+#include <crypto/aead.h>
+#include <crypto/rng.h>
+
+#define CRYPTO_BENCH_BATCH	(16)
+#define CRYPTO_BENCH_MAXSIZE	(65536)
+#define CRYPTO_BENCH_TAGSIZE	(16)
+
+static unsigned int duration = 200;
+module_param(duration, uint, 0444);
+MODULE_PARM_DESC(duration, "duration of each case, in milliseconds");
+
+static const size_t crypto_bench_sizes[] = {64, 256, 1024, 4096, 16384, 65536};
+
+typedef struct crypto_bench_s {
+	const char *binding;
+	const char *algs[3];
+	void *(*setup)(const char *alg, unsigned int keylen);
+	int (*run)(void *ctx, u8 *src, u8 *dst, size_t size);
+	void (*teardown)(void *ctx);
+} crypto_bench_t;
+
+static u8 crypto_bench_key[32];
+static u8 crypto_bench_iv[32];
+
+static unsigned int crypto_bench_keylen(const char *alg)
+{
+	return strcmp(alg, "hmac(sha256)") == 0 || strcmp(alg, "rfc7539(chacha20,poly1305)") == 0 ? 32 : 16;
+}
+
+static void *crypto_bench_shash_setup(const char *alg, unsigned int keylen)
+{
+	struct crypto_shash *tfm = crypto_alloc_shash(alg, 0, 0);
+	struct shash_desc *desc;
+
+	if (IS_ERR(tfm))
+		return tfm;
+
+	if (strncmp(alg, "hmac", 4) == 0 && crypto_shash_setkey(tfm, crypto_bench_key, keylen) != 0)
+		goto free;
+
+	if ((desc = kmalloc(sizeof(*desc) + crypto_shash_descsize(tfm), GFP_KERNEL)) == NULL)
+		goto free;
+	desc->tfm = tfm;
+	return desc;
+free:
+	crypto_free_shash(tfm);
+	return ERR_PTR(-EINVAL);
+}
+
+static int crypto_bench_shash_run(void *ctx, u8 *src, u8 *dst, size_t size)
+{
+	return crypto_shash_digest((struct shash_desc *)ctx, src, size, dst);
+}
+
+static void crypto_bench_shash_teardown(void *ctx)
+{
+	struct shash_desc *desc = (struct shash_desc *)ctx;
+
+	crypto_free_shash(desc->tfm);
+	kfree(desc);
+}
+
+typedef struct crypto_bench_req_s {
+	void *request;
+	struct crypto_wait wait;
+	struct scatterlist sgsrc, sgdst;
+} crypto_bench_req_t;
+
+static void *crypto_bench_skcipher_setup(const char *alg, unsigned int keylen)
+{
+	struct crypto_skcipher *tfm = crypto_alloc_skcipher(alg, 0, 0);
+	crypto_bench_req_t *req;
+
+	if (IS_ERR(tfm))
+		return tfm;
+
+	if (crypto_skcipher_setkey(tfm, crypto_bench_key, keylen) != 0 ||
+	    (req = kzalloc(sizeof(*req), GFP_KERNEL)) == NULL)
+		goto free;
+
+	if ((req->request = skcipher_request_alloc(tfm, GFP_KERNEL)) == NULL) {
+		kfree(req);
+		goto free;
+	}
+	crypto_init_wait(&req->wait);
+	skcipher_request_set_callback(req->request, CRYPTO_TFM_REQ_MAY_BACKLOG, crypto_req_done, &req->wait);
+	return req;
+free:
+	crypto_free_skcipher(tfm);
+	return ERR_PTR(-EINVAL);
+}
+
+static int crypto_bench_skcipher_run(void *ctx, u8 *src, u8 *dst, size_t size)
+{
+	crypto_bench_req_t *req = (crypto_bench_req_t *)ctx;
+	struct skcipher_request *request = req->request;
+
+	sg_init_one(&req->sgsrc, src, size);
+	sg_init_one(&req->sgdst, dst, size);
+	skcipher_request_set_crypt(request, &req->sgsrc, &req->sgdst, size, crypto_bench_iv);
+	return crypto_wait_req(crypto_skcipher_encrypt(request), &req->wait);
+}
+
+static void crypto_bench_skcipher_teardown(void *ctx)
+{
+	crypto_bench_req_t *req = (crypto_bench_req_t *)ctx;
+	struct skcipher_request *request = req->request;
+	struct crypto_skcipher *tfm = crypto_skcipher_reqtfm(request);
+
+	skcipher_request_free(request);
+	crypto_free_skcipher(tfm);
+	kfree(req);
+}
+
+static void *crypto_bench_aead_setup(const char *alg, unsigned int keylen)
+{
+	struct crypto_aead *tfm = crypto_alloc_aead(alg, 0, 0);
+	crypto_bench_req_t *req;
+
+	if (IS_ERR(tfm))
+		return tfm;
+
+	if (crypto_aead_setkey(tfm, crypto_bench_key, keylen) != 0 ||
+	    crypto_aead_setauthsize(tfm, CRYPTO_BENCH_TAGSIZE) != 0 ||
+	    (req = kzalloc(sizeof(*req), GFP_KERNEL)) == NULL)
+		goto free;
+
+	if ((req->request = aead_request_alloc(tfm, GFP_KERNEL)) == NULL) {
+		kfree(req);
+		goto free;
+	}
+	crypto_init_wait(&req->wait);
+	aead_request_set_callback(req->request, CRYPTO_TFM_REQ_MAY_BACKLOG, crypto_req_done, &req->wait);
+	aead_request_set_ad(req->request, 0);
+	return req;
+free:
+	crypto_free_aead(tfm);
+	return ERR_PTR(-EINVAL);
+}
+
+static int crypto_bench_aead_run(void *ctx, u8 *src, u8 *dst, size_t size)
+{
+	crypto_bench_req_t *req = (crypto_bench_req_t *)ctx;
+	struct aead_request *request = req->request;
+
+	sg_init_one(&req->sgsrc, src, size);
+	sg_init_one(&req->sgdst, dst, size + CRYPTO_BENCH_TAGSIZE);
+	aead_request_set_crypt(request, &req->sgsrc, &req->sgdst, size, crypto_bench_iv);
+	return crypto_wait_req(crypto_aead_encrypt(request), &req->wait);
+}
+
+static void crypto_bench_aead_teardown(void *ctx)
+{
+	crypto_bench_req_t *req = (crypto_bench_req_t *)ctx;
+	struct aead_request *request = req->request;
+	struct crypto_aead *tfm = crypto_aead_reqtfm(request);
+
+	aead_request_free(request);
+	crypto_free_aead(tfm);
+	kfree(req);
+}
+
+#if (LINUX_VERSION_CODE < KERNEL_VERSION(6, 15, 0))
+static void *crypto_bench_comp_setup(const char *alg, unsigned int keylen)
+{
+	return crypto_alloc_comp(alg, 0, 0);
+}
+
+static int crypto_bench_comp_run(void *ctx, u8 *src, u8 *dst, size_t size)
+{
+	unsigned int dlen = size * 2;
+	return crypto_comp_compress((struct crypto_comp *)ctx, src, size, dst, &dlen);
+}
+
+static void crypto_bench_comp_teardown(void *ctx)
+{
+	crypto_free_comp((struct crypto_comp *)ctx);
+}
+#endif
+
+static void *crypto_bench_rng_setup(const char *alg, unsigned int keylen)
+{
+	struct crypto_rng *tfm = crypto_alloc_rng(alg, 0, 0);
+
+	if (!IS_ERR(tfm) && crypto_rng_reset(tfm, NULL, 0) != 0) {
+		crypto_free_rng(tfm);
+		return ERR_PTR(-EINVAL);
+	}
+	return tfm;
+}
+
+static int crypto_bench_rng_run(void *ctx, u8 *src, u8 *dst, size_t size)
+{
+	return crypto_rng_get_bytes((struct crypto_rng *)ctx, dst, size);
+}
+
+static void crypto_bench_rng_teardown(void *ctx)
+{
+	crypto_free_rng((struct crypto_rng *)ctx);
+}
+
+static const crypto_bench_t crypto_bench_cases[] = {
+	{"shash", {"sha256", "hmac(sha256)", "crc32c"},
+		crypto_bench_shash_setup, crypto_bench_shash_run, crypto_bench_shash_teardown},
+	{"skcipher", {"cbc(aes)", "ctr(aes)"},
+		crypto_bench_skcipher_setup, crypto_bench_skcipher_run, crypto_bench_skcipher_teardown},
+	{"aead", {"gcm(aes)", "rfc7539(chacha20,poly1305)"},
+		crypto_bench_aead_setup, crypto_bench_aead_run, crypto_bench_aead_teardown},
+#if (LINUX_VERSION_CODE < KERNEL_VERSION(6, 15, 0))
+	{"comp", {"lz4", "deflate"},
+		crypto_bench_comp_setup, crypto_bench_comp_run, crypto_bench_comp_teardown},
+#endif
+	{"rng", {"stdrng"},
+		crypto_bench_rng_setup, crypto_bench_rng_run, crypto_bench_rng_teardown},
+};
+
+static void crypto_bench_measure(const crypto_bench_t *bench, const char *alg, u8 *src, u8 *dst, size_t size)
+{
+	void *ctx = bench->setup(alg, crypto_bench_keylen(alg));
+	u64 start, elapsed, ops = 0;
+	int i, ret = 0;
+
+	if (IS_ERR(ctx)) {
+		pr_info("SKIP\tnative\t%s\t%s\t%zu\t%ld\n", bench->binding, alg, size, PTR_ERR(ctx));
+		return;
+	}
+
+	start = ktime_get_ns();
+	do {
+		for (i = 0; i < CRYPTO_BENCH_BATCH && ret == 0; i++)
+			ret = bench->run(ctx, src, dst, size);
+		ops += CRYPTO_BENCH_BATCH;
+		elapsed = ktime_get_ns() - start;
+		cond_resched();
+	} while (ret == 0 && elapsed < (u64)duration * NSEC_PER_MSEC);
+	bench->teardown(ctx);
+
+	if (ret != 0)
+		pr_info("SKIP\tnative\t%s\t%s\t%zu\t%d\n", bench->binding, alg, size, ret);
+	else
+		pr_info("BENCH\tnative\t%s\t%s\t%zu\t%llu\t%llu\n", bench->binding, alg, size,
+			div64_u64(ops * NSEC_PER_SEC, elapsed), div64_u64(ops * size * 1000, elapsed));
+}
+
+static int __init crypto_bench_init(void)
+{
+	u8 *src, *dst;
+	int i, j, k;
+
+	/* contiguous for sg_init_one(), with room for expansion (e.g., tags, incompressible data) */
+	src = kmalloc(CRYPTO_BENCH_MAXSIZE, GFP_KERNEL);
+	dst = kmalloc(CRYPTO_BENCH_MAXSIZE * 2, GFP_KERNEL);
+	if (src == NULL || dst == NULL) {
+		kfree(src);
+		kfree(dst);
+		return -ENOMEM;
+	}
+
+	memset(crypto_bench_key, 'k', sizeof(crypto_bench_key));
+	for (i = 0; i < CRYPTO_BENCH_MAXSIZE; i++)
+		src[i] = "lunatik!"[i % 8];
+
+	for (i = 0; i < ARRAY_SIZE(crypto_bench_cases); i++) {
+		const crypto_bench_t *bench = &crypto_bench_cases[i];
+
+		for (j = 0; j < ARRAY_SIZE(bench->algs) && bench->algs[j] != NULL; j++)
+			for (k = 0; k < ARRAY_SIZE(crypto_bench_sizes); k++)
+				crypto_bench_measure(bench, bench->algs[j], src, dst, crypto_bench_sizes[k]);
+	}
+
+	kfree(src);
+	kfree(dst);
+	return 0;
+}
+
+static void __exit crypto_bench_exit(void)
+{
+}
+
+module_init(crypto_bench_init);
+module_exit(crypto_bench_exit);
+MODULE_LICENSE("Dual MIT/GPL");
+MODULE_AUTHOR("Lourival Vieira Neto <lourival.neto@ring-0.io>");
+MODULE_DESCRIPTION("Lunatik crypto binding benchmark baseline");
+
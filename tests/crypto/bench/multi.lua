@@ -0,0 +1,23 @@
+--
+-- SPDX-FileCopyrightText: (c) 2025 Ring Zero Desenvolvimento de Software LTDA
+-- SPDX-License-Identifier: MIT OR GPL-2.0-only
+--
+
+-- Runs the crypto benchmarks on one runtime per online CPU, concurrently.
+-- Each line is tagged with its thread name; the aggregate throughput is the
+-- sum over the threads.
+--
+-- Usage:
+-- > lunatik spawnall tests/crypto/bench/multi
+-- > sudo dmesg | grep BENCH
+--
+-- To stop it before completion:
+-- > lunatik stop tests/crypto/bench/multi
+
+local thread = require("thread")
+local suite = require("tests.crypto.bench.suite")
+
+return function()
+	suite.run(thread.current():task().command, nil, thread.shouldstop)
+end
+
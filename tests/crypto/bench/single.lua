@@ -0,0 +1,16 @@
+--
+-- SPDX-FileCopyrightText: (c) 2025 Ring Zero Desenvolvimento de Software LTDA
+-- SPDX-License-Identifier: MIT OR GPL-2.0-only
+--
+
+-- Runs the crypto benchmarks on a single runtime.
+--
+-- Usage:
+-- > lunatik run tests/crypto/bench/single
+--
+-- Compare with the raw Crypto API:
+-- > make CONFIG_LUNATIK_CRYPTO_BENCH=m && sudo insmod tests/crypto/bench/crypto_bench.ko
+-- > sudo dmesg | grep BENCH
+
+require("tests.crypto.bench.suite").run("lua")
+
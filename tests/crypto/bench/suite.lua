@@ -0,0 +1,135 @@
+--
+-- SPDX-FileCopyrightText: (c) 2025 Ring Zero Desenvolvimento de Software LTDA
+-- SPDX-License-Identifier: MIT OR GPL-2.0-only
+--
+
+--- Throughput benchmarks of the crypto bindings.
+-- Each case runs a single operation on a message of each size, repeatedly,
+-- for a fixed duration, and logs one line as
+-- `BENCH <tag> <binding> <algorithm> <size> <ops/s> <MB/s>` (tab separated).
+-- The shash, skcipher, aead, comp and rng cases are mirrored by `crypto_bench.ko`,
+-- which calls the Crypto API directly and logs them tagged as `native`; thus,
+-- the binding overhead is the ratio between both.
+-- @module tests.crypto.bench.suite
+
+local linux = require("linux")
+local data = require("data")
+local util = require("util")
+
+local suite = {}
+
+--- Message sizes, in bytes.
+suite.sizes = {64, 256, 1024, 4096, 16384, 65536}
+
+--- Duration of each case, in milliseconds.
+suite.duration = 200
+
+local BATCH = 16 -- operations between clock reads
+
+local keys = {
+	["hmac(sha256)"] = 32,
+	["cbc(aes)"] = 16,
+	["ctr(aes)"] = 16,
+	["gcm(aes)"] = 16,
+	["rfc7539(chacha20,poly1305)"] = 32,
+}
+
+local function key(alg)
+	return string.rep("k", keys[alg])
+end
+
+local function message(size)
+	return string.rep("lunatik!", size // 8)
+end
+
+local function optional(name)
+	local ok, module = pcall(require, name)
+	return ok and module or nil
+end
+
+local cases = {
+	{binding = "shash", algs = {"sha256", "hmac(sha256)", "crc32c"}, setup = function (alg, size)
+		local h = require("crypto.shash").new(alg)
+		if keys[alg] then h:setkey(key(alg)) end
+		local msg = message(size)
+		return function () h:digest(msg) end
+	end},
+	{binding = "skcipher", algs = {"cbc(aes)", "ctr(aes)"}, setup = function (alg, size)
+		local c = require("crypto.skcipher").new(alg)
+		c:setkey(key(alg))
+		local iv, msg = string.rep("\0", c:ivsize()), message(size)
+		return function () c:encrypt(iv, msg) end
+	end},
+	{binding = "skcipher_into", algs = {"cbc(aes)", "ctr(aes)"}, setup = function (alg, size)
+		local c = require("crypto.skcipher").new(alg)
+		c:setkey(key(alg))
+		local iv, d = string.rep("\0", c:ivsize()), data.new(size)
+		d:setstring(0, message(size))
+		return function () c:encrypt_into(d, 0, size, iv) end
+	end},
+	{binding = "aead", algs = {"gcm(aes)", "rfc7539(chacha20,poly1305)"}, setup = function (alg, size)
+		local c = require("crypto_aead").new(alg)
+		c:setkey(key(alg))
+		c:setauthsize(16)
+		local iv, msg = string.rep("\0", c:ivsize()), message(size)
+		return function () c:seal(iv, msg) end
+	end},
+	{binding = "comp", algs = {"lz4", "deflate"}, module = "crypto.comp", setup = function (alg, size)
+		local c = require("crypto.comp").new(alg)
+		local msg = message(size)
+		return function () c:compress(msg, size * 2) end
+	end},
+	{binding = "acomp", algs = {"lz4", "deflate"}, setup = function (alg, size)
+		local c = require("crypto.acomp").new(alg)
+		local msg = message(size)
+		return function () c:compress(msg) end
+	end},
+	{binding = "rng", algs = {"stdrng"}, setup = function (alg, size)
+		local r = require("crypto.rng").new(alg)
+		return function () r:getbytes(size) end
+	end},
+}
+
+local function measure(op, stop)
+	local duration = suite.duration * 1000000
+	local ops, start, now = 0, linux.time()
+	repeat
+		for _ = 1, BATCH do op() end
+		ops = ops + BATCH
+		now = linux.time()
+	until now - start >= duration or stop()
+	return ops, now - start
+end
+
+local function never() return false end
+
+--- Runs the benchmarks.
+-- @tparam string tag The tag of the logged lines (e.g., "lua" or the thread name).
+-- @tparam[opt] string binding If given, runs only the cases of this binding (e.g., "shash").
+-- @tparam[opt] function stop If given, the run ends early once it returns `true` (e.g., `thread.shouldstop`).
+-- @usage require("tests.crypto.bench.suite").run("lua", "aead")
+function suite.run(tag, binding, stop)
+	stop = stop or never
+	for _, case in ipairs(cases) do
+		if (not binding or binding == case.binding) and (not case.module or optional(case.module)) then
+			for _, alg in ipairs(case.algs) do
+				for _, size in ipairs(suite.sizes) do
+					if stop() then return end
+					local ok, op = pcall(case.setup, alg, size)
+					if ok then
+						local ops, elapsed = measure(op, stop)
+						if stop() then return end -- discards the partial case
+						util.log("bench", tag, case.binding, alg, size,
+							ops * 1000000000 // elapsed, ops * size * 1000 // elapsed)
+					else
+						util.log("skip", tag, case.binding, alg, size, op)
+					end
+					linux.schedule(1) -- yields the CPU between cases
+				end
+			end
+		end
+	end
+end
+
+return suite
+
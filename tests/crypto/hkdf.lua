@@ -68,3 +68,26 @@ test("HKDF-Expand-Label examples from https://quic.xargs.org/#client-initial-key
 	assert(result == expected, "HKDF-Expand-Label client_init_iv mismatch")
 end)
 
+
+test("HKDF over data objects and cached keys", function()
+	local data = require("data")
+	local h = new"sha256"
+	local salt = hex2bin"000102030405060708090a0b0c"
+	local ikm = hex2bin"0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b"
+	local info = hex2bin"f0f1f2f3f4f5f6f7f8f9"
+	local expected = hex2bin"3cb25f25faacd57a90434f64d0362f2a2d2d0a90cf1a5a4c5db02d56ecc4c5bf34007208d5b887185865"
+
+	local d = data.new(#ikm)
+	d:setstring(0, ikm)
+	local prk = h:extract(salt, d)
+	assert(prk == h:extract(salt, ikm), "extract over data mismatch")
+	assert(h:expand(prk, info, 42) == expected, "expand mismatch")
+	assert(h:expand(prk, info, 42) == expected, "expand with cached key mismatch")
+	assert(h:hkdf(salt, d, info, 42) == expected, "hkdf over data mismatch")
+
+	local r = data.new(#ikm + #info + 8)
+	r:setstring(4, ikm)
+	r:setstring(4 + #ikm, info)
+	assert(h:extract(salt, {r, 4, #ikm}) == prk, "extract over data range mismatch")
+	assert(h:hkdf(salt, {r, 4, #ikm}, {r, 4 + #ikm, #info}, 42) == expected, "hkdf over data ranges mismatch")
+end)
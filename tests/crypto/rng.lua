@@ -73,3 +73,17 @@ test("RNG getbytes (different from previous)", function()
 	assert(bytes16 ~= bytes32, "Consecutive getbytes calls should produce different results (highly probable)")
 end)
 
+test("RNG fill data range", function()
+	local data = require"data"
+	local rng = new"stdrng"
+	local d = data.new(64)
+	d:setstring(0, string.rep("\0", 64))
+	rng:fill(d, 16, 32)
+	assert(d:getstring(0, 16) == string.rep("\0", 16), "rng:fill must not write before the range")
+	assert(d:getstring(48, 16) == string.rep("\0", 16), "rng:fill must not write after the range")
+	assert(d:getstring(16, 32) ~= string.rep("\0", 32), "rng:fill should write random bytes into the range")
+
+	local status = pcall(rng.fill, rng, d, 60, 8)
+	assert(not status, "rng:fill out of bounds must return an error")
+end)
+
@@ -108,3 +108,38 @@ test("crypto_shash:export and import functionality", function()
 	assert(digest4 == digest_data1, "Imported state final digest does not match digest of data1")
 end)
 
+
+test("crypto_shash per-CPU digest", function()
+	local hmac_hasher = shash.new("hmac(sha256)", true)
+	local expected_hmac_digest = hex2bin("f7bc83f430538424b13298e6aa6fb143ef4d59a14946175997479dbc2d1a3cd8")
+	hmac_hasher:setkey("key")
+	assert(hmac_hasher:digestsize() == 32, "HMAC(SHA256) digest size should be 32 bytes")
+	assert(hmac_hasher:digest("The quick brown fox jumps over the lazy dog") == expected_hmac_digest,
+		"per-CPU HMAC(SHA256) digest mismatch")
+
+	local status, err = pcall(hmac_hasher.init, hmac_hasher)
+	assert(not status, "init on per-CPU objects should fail")
+	assert(err:find("not supported on per-CPU objects"), "unexpected error: " .. err)
+end)
+
+test("crypto_shash over data objects and digest_many", function()
+	local data = require("data")
+	local hasher = shash.new("sha256")
+	local text = "The quick brown fox jumps over the lazy dog"
+	local expected_digest = hex2bin("d7a8fbb307d7809469ca9abcb0082e4f8d5651e46d3cdb762d02d0bf37c9e592")
+
+	local d = data.new(#text + 8)
+	d:setstring(4, text)
+	assert(hasher:digest(d, 4, #text) == expected_digest, "SHA256 digest over data range mismatch")
+
+	hasher:init()
+	hasher:update(d, 4, 16)
+	assert(hasher:finup(d, 20, #text - 16) == expected_digest, "multi-part SHA256 over data ranges mismatch")
+
+	local record = data.new(#text)
+	record:setstring(0, text)
+	local digests = hasher:digest_many({text, record, ""})
+	assert(#digests == 3, "digest_many should return a digest per buffer")
+	assert(digests[1] == expected_digest and digests[2] == expected_digest, "digest_many mismatch")
+	assert(digests[3] == hasher:digest(""), "digest_many of an empty string mismatch")
+end)
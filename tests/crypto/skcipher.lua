@@ -80,3 +80,43 @@ test("SKCIPHER AES-128-CBC decrypt with data not multiple of blocksize", functio
 	assert(string.find(err, "Crypto operation failed with error code " .. EINVAL), "Error message should indicate EINVAL: " .. err)
 end)
 
+
+test("SKCIPHER AES-128-CBC per-CPU encrypt and decrypt", function()
+	local c = skcipher.new("cbc(aes)", true)
+	local plaintext = "This is a test!!"
+	local ciphertext = hex2bin"d05e07d91a4b4cd10951f8cf195f27b5"
+	c:setkey"0123456789abcdef"
+
+	assert(c:encrypt("fedcba9876543210", plaintext) == ciphertext, "per-CPU cipher text mismatch")
+	assert(c:decrypt("fedcba9876543210", ciphertext) == plaintext, "per-CPU plain text mismatch")
+end)
+
+test("SKCIPHER AES-128-CBC encrypt_into and decrypt_into", function()
+	local data = require("data")
+	local c = skcipher.new"cbc(aes)"
+	local plaintext = "This is a test!!"
+	local ciphertext = hex2bin"d05e07d91a4b4cd10951f8cf195f27b5"
+	c:setkey"0123456789abcdef"
+
+	local d = data.new(4 + #plaintext)
+	d:setstring(4, plaintext)
+	c:encrypt_into(d, 4, #plaintext, "fedcba9876543210")
+	assert(d:getstring(4) == ciphertext, "in-place cipher text mismatch")
+	c:decrypt_into(d, 4, #plaintext, "fedcba9876543210")
+	assert(d:getstring(4) == plaintext, "in-place plain text mismatch")
+end)
+
+test("SKCIPHER AES-128-CBC encrypt_batch and decrypt_batch", function()
+	local c = skcipher.new"cbc(aes)"
+	local plaintext = "This is a test!!"
+	local ciphertext = hex2bin"d05e07d91a4b4cd10951f8cf195f27b5"
+	local iv = "fedcba9876543210"
+	c:setkey"0123456789abcdef"
+
+	local results = c:encrypt_batch({iv, iv, iv}, {plaintext, plaintext, "This is a test!!!"})
+	assert(results[1] == ciphertext and results[2] == ciphertext, "batched cipher text mismatch")
+	assert(results[3] == EINVAL, "batched encryption of unaligned data should fail with EINVAL")
+
+	results = c:decrypt_batch({iv}, {ciphertext})
+	assert(results[1] == plaintext, "batched plain text mismatch")
+end)